@@ -234,6 +234,15 @@ static inline void memory_barrier() {
     __asm__ __volatile__ ("" ::: "memory");
 }
 
+/// Hint to the CPU that the caller is in a spin-wait loop
+static inline void cpu_relax() {
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__ ("pause" ::: "memory");
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
 /// Atomically set a given bit in a location pointed to by \a addr
 static inline void set_bit(int n, volatile unsigned long* addr) {
     if (bits::detail::is_immediate(n)) {
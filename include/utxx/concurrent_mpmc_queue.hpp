@@ -0,0 +1,343 @@
+// vim:ts=4:et:sw=4
+//----------------------------------------------------------------------------
+/// \file   concurrent_mpmc_queue.hpp
+/// \author agent
+//----------------------------------------------------------------------------
+/// \brief Bounded multiple producer / multiple consumer queue.
+///
+/// Array-based queue with a sequence number in every slot, based on the
+/// algorithm by Dmitry Vyukov:
+/// http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+//----------------------------------------------------------------------------
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+ ***** BEGIN LICENSE BLOCK *****
+
+ This file is part of the utxx open-source project.
+
+ Copyright (C) 2026 agent <agent@local>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ ***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <utxx/config.h>
+#include <utxx/math.hpp>
+#include <utxx/error.hpp>
+#include <utxx/futex.hpp>
+#include <boost/noncopyable.hpp>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <sched.h>
+#include <type_traits>
+#include <utility>
+
+namespace utxx {
+
+//===========================================================================//
+// concurrent_mpmc_queue                                                     //
+//===========================================================================//
+/// Bounded lock-free queue for any number of producers and consumers.
+///
+/// Unlike container::bound_lock_free_queue, items are stored in a pre-allocated
+/// array, so there is no node allocation, and every operation takes a single
+/// CAS on the producer or consumer position. Each slot carries a sequence
+/// number telling whether it is ready to be written or read in the current
+/// lap, which also rules out the ABA problem. Slots are padded to a cache line
+/// so that neighbouring producers and consumers don't share one.
+template <class T>
+class concurrent_mpmc_queue : private boost::noncopyable
+{
+    struct cell {
+        std::atomic<size_t> seq;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+
+        T& value() { return *reinterpret_cast<T*>(&data); }
+    } __attribute__((aligned(UTXX_CL_SIZE)));
+
+public:
+    typedef T value_type;
+
+    /// Create a queue of \a a_capacity slots (rounded up to a power of 2)
+    explicit concurrent_mpmc_queue(size_t a_capacity)
+        : m_capacity(math::upper_power(a_capacity, 2))
+        , m_mask    (m_capacity - 1)
+        , m_cells   (nullptr)
+        , m_push_pos(0)
+        , m_pop_pos (0)
+    {
+        if (a_capacity < 2)
+            UTXX_THROW_BADARG_ERROR("Invalid capacity=", a_capacity);
+
+        if (::posix_memalign((void**)&m_cells, UTXX_CL_SIZE,
+                             sizeof(cell) * m_capacity))
+            throw std::bad_alloc();
+
+        for (size_t i = 0; i < m_capacity; ++i)
+            new (&m_cells[i].seq) std::atomic<size_t>(i);
+    }
+
+    ~concurrent_mpmc_queue()
+    {
+        if (!std::is_trivially_destructible<T>::value)
+            for (size_t i = m_pop_pos; i != m_push_pos; ++i)
+                m_cells[i & m_mask].value().~T();
+        ::free(m_cells);
+    }
+
+    /// Insert a T object constructed from \a a_args.
+    /// @return false if the queue is full
+    template <class... Args>
+    bool try_push(Args&&... a_args)
+    {
+        size_t pos = m_push_pos.load(std::memory_order_relaxed);
+        cell*  c;
+
+        while (true) {
+            c = &m_cells[pos & m_mask];
+            size_t   seq = c->seq.load(std::memory_order_acquire);
+            intptr_t dif = intptr_t(seq) - intptr_t(pos);
+            if (dif == 0) {
+                if (m_push_pos.compare_exchange_weak
+                        (pos, pos+1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0)
+                return false;   // The slot wasn't consumed in previous lap
+            else
+                pos = m_push_pos.load(std::memory_order_relaxed);
+        }
+
+        new (&c->data) T(std::forward<Args>(a_args)...);
+        c->seq.store(pos+1, std::memory_order_release);
+        return true;
+    }
+
+    /// Move the item at the front of the queue to \a a_item.
+    /// @return false if the queue is empty
+    bool try_pop(T& a_item)
+    {
+        size_t pos = m_pop_pos.load(std::memory_order_relaxed);
+        cell*  c;
+
+        while (true) {
+            c = &m_cells[pos & m_mask];
+            size_t   seq = c->seq.load(std::memory_order_acquire);
+            intptr_t dif = intptr_t(seq) - intptr_t(pos+1);
+            if (dif == 0) {
+                if (m_pop_pos.compare_exchange_weak
+                        (pos, pos+1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0)
+                return false;   // The slot wasn't written in this lap
+            else
+                pos = m_pop_pos.load(std::memory_order_relaxed);
+        }
+
+        a_item = std::move(c->value());
+        c->value().~T();
+        c->seq.store(pos + m_capacity, std::memory_order_release);
+        return true;
+    }
+
+    /// Number of slots in the queue
+    size_t capacity() const { return m_capacity; }
+
+    /// Approximate number of items in the queue (exact if there are no
+    /// concurrent updates)
+    size_t size() const
+    {
+        size_t pop  = m_pop_pos.load(std::memory_order_acquire);
+        size_t push = m_push_pos.load(std::memory_order_acquire);
+        return push > pop ? push - pop : 0;
+    }
+
+    /// Returns true if the queue is empty (not reliable in the presence of
+    /// concurrent updates)
+    bool empty() const { return !size(); }
+
+private:
+    size_t const        m_capacity;
+    size_t const        m_mask;
+    cell*               m_cells;
+
+    std::atomic<size_t> m_push_pos  __attribute__((aligned(UTXX_CL_SIZE)));
+    std::atomic<size_t> m_pop_pos   __attribute__((aligned(UTXX_CL_SIZE)));
+};
+
+//===========================================================================//
+// blocking_mpmc_queue                                                       //
+//===========================================================================//
+/// concurrent_mpmc_queue with push/pop calls that wait on a futex when the
+/// queue is full/empty.
+///
+/// The futex is only touched when there are waiting threads, so
+/// uncontended push/pop calls cost the same as try_push/try_pop plus a
+/// memory fence. Before going to sleep, a blocked call retries up to
+/// \a spin times yielding the CPU in between.
+template <class T>
+class blocking_mpmc_queue : private boost::noncopyable
+{
+    /// Futex word with a count of threads waiting on it
+    struct event {
+        std::atomic<int> gen;
+        std::atomic<int> waiters;
+        char             pad[UTXX_CL_SIZE - 2*sizeof(int)];
+
+        event() : gen(0), waiters(0) {}
+
+        void notify(int a_count) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiters.load(std::memory_order_relaxed)) {
+                gen.fetch_add(1, std::memory_order_release);
+                futex_wake_slow(reinterpret_cast<int*>(&gen), a_count);
+            }
+        }
+    };
+
+public:
+    typedef T value_type;
+
+    explicit blocking_mpmc_queue(size_t a_capacity, int a_spin = 64)
+        : m_queue(a_capacity), m_spin(a_spin), m_terminated(false)
+    {}
+
+    /// Insert an item without blocking.
+    /// @return false if the queue is full
+    template <class... Args>
+    bool try_push(Args&&... a_args)
+    {
+        if (!m_queue.try_push(std::forward<Args>(a_args)...))
+            return false;
+        m_not_empty.notify(1);
+        return true;
+    }
+
+    /// Remove an item without blocking.
+    /// @return false if the queue is empty
+    bool try_pop(T& a_item)
+    {
+        if (!m_queue.try_pop(a_item))
+            return false;
+        m_not_full.notify(1);
+        return true;
+    }
+
+    /// Insert an item waiting up to \a a_timeout (NULL means infinity) for
+    /// a free slot.
+    /// @return 0 on success, -1 on timeout, -2 if the queue was terminated
+    int push(const T& a_item, const struct timespec* a_timeout = NULL)
+    {
+        return wait(m_not_full, a_timeout,
+                    [&]() { return try_push(a_item); });
+    }
+
+    /// Remove an item waiting up to \a a_timeout (NULL means infinity) for
+    /// the queue to become non-empty.
+    /// @return 0 on success, -1 on timeout, -2 if the queue was terminated
+    int pop(T& a_item, const struct timespec* a_timeout = NULL)
+    {
+        return wait(m_not_empty, a_timeout,
+                    [&]() { return try_pop(a_item); });
+    }
+
+    /// Wake up all waiting threads and make subsequent push/pop calls fail
+    void terminate()
+    {
+        m_terminated.store(true, std::memory_order_release);
+        for (auto e : {&m_not_empty, &m_not_full}) {
+            e->gen.fetch_add(1, std::memory_order_release);
+            futex_wake_slow(reinterpret_cast<int*>(&e->gen), INT_MAX);
+        }
+    }
+
+    bool   terminated() const
+        { return m_terminated.load(std::memory_order_acquire); }
+
+    size_t capacity()   const { return m_queue.capacity(); }
+    size_t size()       const { return m_queue.size();     }
+    bool   empty()      const { return m_queue.empty();    }
+
+private:
+    concurrent_mpmc_queue<T> m_queue;
+    int const                m_spin;
+    event                    m_not_empty;
+    event                    m_not_full;
+    std::atomic<bool>        m_terminated;
+
+    template <class Fun>
+    int wait(event& a_event, const struct timespec* a_timeout, Fun a_try)
+    {
+        typedef std::chrono::steady_clock clock;
+
+        // Wake-ups that don't get an item mustn't extend the timeout
+        clock::time_point deadline;
+        if (a_timeout)
+            deadline = clock::now()
+                     + std::chrono::seconds(a_timeout->tv_sec)
+                     + std::chrono::nanoseconds(a_timeout->tv_nsec);
+
+        for (int i = 0; i < m_spin; ++i) {
+            if (terminated())
+                return -2;
+            if (a_try())
+                return 0;
+            sched_yield();
+        }
+
+        while (true) {
+            if (terminated())
+                return -2;
+            if (a_try())
+                return 0;
+
+            struct timespec  left;
+            struct timespec* tout = nullptr;
+            if (a_timeout) {
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>
+                          (deadline - clock::now()).count();
+                if (ns <= 0)
+                    return -1;
+                left.tv_sec  = ns / 1000000000;
+                left.tv_nsec = ns % 1000000000;
+                tout         = &left;
+            }
+
+            // Register as a waiter before re-checking the queue, so that
+            // a notify() issued after that check is guaranteed to see us
+            a_event.waiters.fetch_add(1, std::memory_order_seq_cst);
+            int  gen = a_event.gen.load(std::memory_order_acquire);
+            bool ok  = !terminated() && a_try();
+            wakeup_result res = ok || terminated()
+                ? wakeup_result::SIGNALED
+                : futex_wait_slow(reinterpret_cast<int*>(&a_event.gen),
+                                  gen, tout);
+            a_event.waiters.fetch_sub(1, std::memory_order_relaxed);
+
+            if (ok)
+                return 0;
+            if (res == wakeup_result::TIMEDOUT)
+                return -1;
+        }
+    }
+};
+
+} // namespace utxx
@@ -38,13 +38,18 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <cstdlib>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <type_traits>
 #include <utility>
+#include <vector>
 #include <boost/noncopyable.hpp>
 #include <boost/type_traits.hpp>
 #include <utxx/math.hpp>
+#include <utxx/detail/thread_owned.hpp>
 
 namespace utxx {
 
@@ -53,6 +58,15 @@ namespace utxx {
 /**
  * A lock-free implementation of the multi-producer-single-consumer queue.
  * All elements are equally sized of type T.
+ *
+ * Nodes released by free() and free_all() are not returned to the allocator
+ * but put on a lock-free free list. Each producer thread keeps a private
+ * magazine of free nodes, refilled by taking the free list with a single
+ * exchange, so in the steady state neither side calls the allocator. When
+ * \a a_max_refill is non-zero, a producer keeps at most that many of the
+ * taken nodes and puts the rest back. The magazine of an exited producer is
+ * adopted by the next new producer thread. Cached nodes are deallocated when
+ * the queue is destroyed.
  */
 template <class T, class Allocator = std::allocator<char>>
 struct concurrent_mpsc_queue {
@@ -75,37 +89,48 @@ struct concurrent_mpsc_queue {
 
     typedef typename Allocator::template rebind<node>::other Alloc;
 
-    explicit concurrent_mpsc_queue(const Alloc& a_alloc = Alloc())
-        : m_head     (nullptr)
-        , m_allocator(a_alloc)
+    explicit concurrent_mpsc_queue(const Alloc& a_alloc = Alloc(),
+                                   size_t a_max_refill = 0)
+        : m_head      (nullptr)
+        , m_free      (nullptr)
+        , m_allocator (a_alloc)
+        , m_id        (detail::next_thread_owned_id())
+        , m_max_refill(a_max_refill)
     {}
 
+    /// Deallocates cached free nodes. Nodes still in the queue are not freed.
+    ~concurrent_mpsc_queue() { release_cache(); }
+
     bool empty() const {
         return m_head.load(std::memory_order_relaxed) == nullptr;
     }
 
+    /// Allocate a node (reusing a freed one if possible) and construct its
+    /// data with given arguments.
+    /// @return nullptr if out of memory
     template <typename... Args>
     node* allocate(Args&&... args) {
+        magazine* m = local_magazine();
+        node*     n = m ? m->free : nullptr;
+        if (!n && m)
+            n = refill();
+        if (n)
+            m->free = n->next();
+        else {
+            try   { n = m_allocator.allocate(1); }
+            catch (std::bad_alloc const&) { return nullptr; }
+        }
         try {
-            node*  n = m_allocator.allocate(1);
-            new   (n)  node(std::forward<Args>(args)...);
-            return n;
-        } catch (std::bad_alloc const&) {
-            return nullptr;
+            new (n) node(std::forward<Args>(args)...);
+        } catch (...) {
+            recycle(n, n);
+            throw;
         }
+        return n;
     }
 
     /// Insert an element's copy into the queue. 
-    bool push(const T& data) {
-        try {
-            node* n = m_allocator.allocate(1);
-            new  (n)  node(data);
-            push (n);
-            return true;
-        } catch (std::bad_alloc const&) {
-            return false;
-        }
-    }
+    bool push(const T& data) { return emplace(data); }
 
     /// Insert an element into the queue. 
     /// The element must have been previously allocated using allocate() function.
@@ -118,18 +143,16 @@ struct concurrent_mpsc_queue {
     /// Emplace an element into the queue by constructing the data with given arguments. 
     template <typename... Args>
     bool emplace(Args&&... args) {
-        try {
-            node* n = allocate(std::forward<Args>(args)...);
-            push(n);
-            return true;
-        } catch (std::bad_alloc const&) {
+        node* n = allocate(std::forward<Args>(args)...);
+        if (!n)
             return false;
-        }
+        push(n);
+        return true;
     }
 
     /// Pop all queued elements in the order of insertion
     ///
-    /// Use concurrent_mpsc_queue::free() to deallocate each node
+    /// Use concurrent_mpsc_queue::free() or free_all() to deallocate nodes
     node* pop_all() {
         node* first = nullptr;
         for (node* tmp, *last = pop_all_reverse(); last; first = tmp) {
@@ -142,27 +165,133 @@ struct concurrent_mpsc_queue {
 
     /// Pop all queued elements in the reverse order
     ///
-    /// Use concurrent_mpsc_queue::free() to deallocate each node
+    /// Use concurrent_mpsc_queue::free() or free_all() to deallocate nodes
     node* pop_all_reverse() {
         return m_head.exchange(nullptr, std::memory_order_acquire);
     }
 
     /// Deallocate a node created by a call to pop_all() or pop_all_reverse()
     void free(node* a_node) {
-        a_node->~node();
-        m_allocator.deallocate(a_node, a_node->size());
+        a_node->data().~T();
+        recycle(a_node, a_node);
     }
 
-    /// Clear the queue
-    void clear() {
-        for (node* tmp, *last = pop_all_reverse(); last; last = tmp) {
-            tmp  = last->next();
-            free(last);
+    /// Deallocate a chain of nodes linked by next() (such as the one returned
+    /// by pop_all() or pop_all_reverse()) with a single update of the free list
+    void free_all(node* a_first) {
+        if (!a_first)
+            return;
+        node* last = a_first;
+        for (node* n = a_first; n; n = n->next()) {
+            n->data().~T();
+            last = n;
         }
+        recycle(a_first, last);
     }
+
+    /// Clear the queue
+    void clear() { free_all(pop_all_reverse()); }
+
 private:
+    /// Cache of free nodes owned by a producer thread
+    struct magazine : public detail::thread_owned {
+        node* free = nullptr;   // Accessed by the owner only
+    };
+
+    using magazine_vec = std::vector<std::shared_ptr<magazine>>;
+
     std::atomic<node*> m_head;
+    std::atomic<node*> m_free;      // Nodes released by the consumer
     Alloc              m_allocator;
+    const uint64_t     m_id;        // Unique id of this instance
+    const size_t       m_max_refill;
+    magazine_vec       m_magazines;
+    std::mutex         m_mag_mtx;   // Guards m_magazines
+
+    /// Push a chain of destroyed nodes [a_first, a_last] to the free list
+    void recycle(node* a_first, node* a_last) {
+        node* h = m_free.load(std::memory_order_relaxed);
+        do    { a_last->next(h); }
+        while (!m_free.compare_exchange_weak(h, a_first,
+                    std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    /// Take the free list, keeping up to m_max_refill nodes (if non-zero)
+    /// and putting the rest back
+    node* refill() {
+        node* n = m_free.exchange(nullptr, std::memory_order_acquire);
+        if (!n || !m_max_refill)
+            return n;
+
+        node* last = n;
+        for (size_t i = 1; i < m_max_refill && last->next(); ++i)
+            last = last->next();
+
+        node* rest = last->next();
+        if (rest) {
+            last->next(nullptr);
+            node* h = nullptr;
+            // Unless new nodes were freed meanwhile, the rest is put back
+            // without walking it
+            if (!m_free.compare_exchange_strong(h, rest,
+                    std::memory_order_release, std::memory_order_relaxed)) {
+                node* end = rest;
+                while (end->next())
+                    end = end->next();
+                recycle(rest, end);
+            }
+        }
+        return n;
+    }
+
+    /// Magazine of the calling thread (created or adopted on first use) or
+    /// NULL if the thread is exiting
+    magazine* local_magazine() {
+        auto cache = detail::thread_owned_cache::instance();
+        if (!cache)
+            return nullptr;
+
+        if (auto m = cache->find(m_id))
+            return static_cast<magazine*>(m);
+
+        std::lock_guard<std::mutex> guard(m_mag_mtx);
+
+        // Reuse the magazine of a thread that has exited
+        std::shared_ptr<magazine> m;
+        for (auto& mag : m_magazines)
+            if (mag->adopt()) {
+                m = mag;
+                break;
+            }
+
+        if (!m) {
+            m = std::make_shared<magazine>();
+            m_magazines.push_back(m);
+        }
+
+        cache->add(m_id, m);
+        return m.get();
+    }
+
+    void deallocate_chain(node* a_node) {
+        for (node* next; a_node; a_node = next) {
+            next = a_node->next();
+            m_allocator.deallocate(a_node, 1);
+        }
+    }
+
+    void release_cache() {
+        deallocate_chain(m_free.exchange(nullptr, std::memory_order_acquire));
+        // Thread caches may still reference the magazines, so only their
+        // nodes are freed here
+        std::lock_guard<std::mutex> guard(m_mag_mtx);
+        for (auto& m : m_magazines) {
+            m->alive.store(false, std::memory_order_relaxed);
+            deallocate_chain(m->free);
+            m->free = nullptr;
+        }
+        m_magazines.clear();
+    }
 };
 
 template <class Allocator>
@@ -302,13 +431,17 @@ struct concurrent_mpsc_queue<char, Allocator> {
         m_allocator.deallocate(reinterpret_cast<char*>(a_node), sizeof(node) + a_node->size());
     }
 
-    /// Clear the queue
-    void clear() {
-        for (node* tmp, *last = pop_all_reverse(); last; last = tmp) {
-            tmp  = last->next();
-            free(last);
+    /// Deallocate a chain of nodes linked by next() (such as the one returned
+    /// by pop_all() or pop_all_reverse())
+    void free_all(node* a_first) {
+        for (node* next; a_first; a_first = next) {
+            next = a_first->next();
+            free(a_first);
         }
     }
+
+    /// Clear the queue
+    void clear() { free_all(pop_all_reverse()); }
 public:
     std::atomic<node*> m_head;
     Allocator          m_allocator;
@@ -0,0 +1,392 @@
+// vim:ts=4:et:sw=4
+//----------------------------------------------------------------------------
+/// \file   concurrent_spmc_queue.hpp
+/// \author agent
+//----------------------------------------------------------------------------
+/// \brief Single producer / multiple consumer broadcast ring.
+///
+/// Every message published by the producer is seen by every subscribed
+/// consumer (disruptor-style), as opposed to being handed to one of them.
+//----------------------------------------------------------------------------
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+ ***** BEGIN LICENSE BLOCK *****
+
+ This file is part of the utxx open-source project.
+
+ Copyright (C) 2026 agent <agent@local>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ ***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <utxx/config.h>
+#include <utxx/math.hpp>
+#include <utxx/error.hpp>
+#include <utxx/compiler_hints.hpp>
+#include <boost/noncopyable.hpp>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace utxx {
+
+//===========================================================================//
+// concurrent_spmc_queue                                                     //
+//===========================================================================//
+/// Broadcast ring with one producer and up to \a MaxConsumers independent
+/// consumers.
+///
+/// The producer stamps every message with a monotonically increasing
+/// sequence number. Each consumer subscribes to the ring and tracks its own
+/// cursor, so a message is copied into the ring once regardless of the
+/// number of consumers.
+///
+/// When \a Overwrite is false, the producer applies backpressure: push()
+/// fails if the slowest subscribed consumer is a full ring behind. Note that
+/// a consumer that stops reading without unsubscribing stalls the producer.
+///
+/// When \a Overwrite is true, the producer never waits, and consumers that
+/// fall behind detect the overwritten messages (see consumer::lost()). In
+/// this mode reading a slot is protected by a per-slot sequence lock, so T
+/// must be trivially copyable.
+///
+/// The header and the slots are allocated in one block of memory_size()
+/// bytes, which can reside in shared memory (see create()).
+template <class T, uint32_t MaxConsumers = 8, bool Overwrite = false>
+class concurrent_spmc_queue : private boost::noncopyable
+{
+    static_assert(!Overwrite || std::is_trivially_copyable<T>::value,
+                  "Overwrite mode requires a trivially copyable type");
+    static_assert(MaxConsumers > 0, "At least one consumer is required");
+
+    struct slot {
+        // In Overwrite mode: 2*seq+1 while the slot is being written,
+        // 2*seq+2 when it holds the message with sequence number "seq"
+        std::atomic<uint64_t> seq;
+        T                     data;
+    };
+
+    struct cursor {
+        std::atomic<uint64_t> seq;      // Next sequence number to read
+        std::atomic<uint32_t> active;   // Subscribed
+    } __attribute__((aligned(UTXX_CL_SIZE)));
+
+public:
+    typedef T value_type;
+
+    /// Total memory footprint needed to allocate a ring of a_capacity
+    /// (rounded up to a power of 2) slots
+    static size_t memory_size(uint32_t a_capacity) {
+        return sizeof(concurrent_spmc_queue)
+             + sizeof(slot) * math::upper_power(a_capacity, 2);
+    }
+
+    /// A factory function which allocates a new ring of a given \a capacity
+    /// in a given memory, and optionally constructs it.
+    /// If \a a_memory is given and \a a_construct is false, the ring that
+    /// already exists in that memory (eg created by another process in
+    /// shared memory) is attached to after validating its version.
+    static concurrent_spmc_queue* create
+    (
+        uint32_t a_capacity,
+        void*    a_memory    = nullptr,
+        size_t   a_mem_sz    = 0,
+        bool     a_construct = false
+    ) {
+        assert((a_memory && a_mem_sz >  0) ||
+              (!a_memory && a_mem_sz == 0));
+
+        if (a_capacity < 2)
+            throw badarg_error
+                ("concurrent_spmc_queue::create: invalid capacity: ",
+                 a_capacity);
+
+        size_t expect_sz = memory_size(a_capacity);
+
+        if (a_mem_sz && a_mem_sz != expect_sz)
+            throw badarg_error
+                ("concurrent_spmc_queue::create: invalid memory size "
+                 "(expected=", expect_sz, ", got=", a_mem_sz, ')');
+
+        bool external = !!a_memory;
+
+        if (!external) {
+            if (::posix_memalign(&a_memory, UTXX_CL_SIZE, expect_sz))
+                throw std::bad_alloc();
+            a_construct = true;
+        }
+
+        if (a_construct)
+            return new (a_memory) concurrent_spmc_queue(a_capacity, external);
+
+        auto p = static_cast<concurrent_spmc_queue*>(a_memory);
+        if ((p->m_version & ~0x1u) != s_version ||
+             p->m_capacity != math::upper_power(a_capacity, 2))
+            throw runtime_error
+                ("concurrent_spmc_queue::create: invalid version or capacity "
+                 "of existing ring at given memory address ", a_memory);
+        return p;
+    }
+
+    /// Destroy previously created ring
+    static void destroy(concurrent_spmc_queue*& a_ptr) {
+        if (!a_ptr)
+            return;
+
+        if (!a_ptr->is_externally_allocated()) {
+            a_ptr->~concurrent_spmc_queue();
+            ::free(a_ptr);
+        }
+        a_ptr = nullptr;
+    }
+
+    /// Returns true if the instance was constructed in externally allocated
+    /// memory
+    bool is_externally_allocated() const { return m_version & 0x1; }
+
+    /// Number of slots in the ring
+    uint32_t capacity()  const { return m_capacity; }
+
+    /// Total number of messages published so far (the sequence number of
+    /// the next message)
+    uint64_t published() const { return m_tail.load(std::memory_order_acquire); }
+
+    /// Number of currently subscribed consumers
+    uint32_t consumers() const {
+        uint32_t n = 0;
+        for (auto& c : m_cursors)
+            n += c.active.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    //-----------------------------------------------------------------------//
+    // Producer side                                                         //
+    //-----------------------------------------------------------------------//
+    /// Publish a T object constructed from \a a_args to all consumers.
+    /// @return false if the ring is full (only when Overwrite is false)
+    template <class... Args>
+    bool push(Args&&... a_args)
+    {
+        uint64_t t = m_tail.load(std::memory_order_relaxed);
+
+        if (!Overwrite && t - m_min_cache >= m_capacity) {
+            m_min_cache = min_cursor(t);
+            if (t - m_min_cache >= m_capacity)
+                return false;
+        }
+
+        slot& s = m_slots[t & m_mask];
+
+        if (Overwrite) {
+            s.seq.store(2*t + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        } else if (!std::is_trivially_destructible<T>::value && t >= m_capacity)
+            s.data.~T();
+
+        new (&s.data) T(std::forward<Args>(a_args)...);
+
+        if (Overwrite)
+            s.seq.store(2*t + 2, std::memory_order_release);
+
+        m_tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    //-----------------------------------------------------------------------//
+    // Consumer side                                                         //
+    //-----------------------------------------------------------------------//
+    /// Subscription to the ring. A consumer receives the messages published
+    /// after it was created. Each consumer must be used by one thread only.
+    class consumer : private boost::noncopyable
+    {
+    public:
+        /// Subscribe to the ring. Throws if \a MaxConsumers consumers are
+        /// already subscribed.
+        explicit consumer(concurrent_spmc_queue& a_ring)
+            : m_ring(a_ring)
+            , m_id  (a_ring.subscribe())
+            , m_lost(0)
+        {
+            if (m_id < 0)
+                UTXX_THROW_RUNTIME_ERROR("Too many consumers (max=",
+                                         MaxConsumers, ')');
+            m_seq  = m_ring.m_cursors[m_id].seq.load(std::memory_order_relaxed);
+            m_tail = m_seq;
+        }
+
+        ~consumer() { m_ring.unsubscribe(m_id); }
+
+        /// Copy the next message to \a a_item.
+        /// @return false if there are no new messages
+        bool pop(T& a_item)
+        {
+            while (true) {
+                if (m_seq == m_tail &&
+                    m_seq == (m_tail = m_ring.m_tail.load(std::memory_order_acquire)))
+                    return false;
+
+                if (!Overwrite) {
+                    slot& s = m_ring.m_slots[m_seq & m_ring.m_mask];
+                    a_item  = s.data;
+                    advance(m_seq + 1);
+                    return true;
+                }
+
+                // Skip the messages that were overwritten already
+                if (m_tail - m_seq > m_ring.m_capacity)
+                    skip(m_tail - m_ring.m_capacity);
+
+                slot&    s  = m_ring.m_slots[m_seq & m_ring.m_mask];
+                uint64_t s1 = s.seq.load(std::memory_order_acquire);
+                if (s1 == 2*m_seq + 2) {
+                    a_item = s.data;
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (s.seq.load(std::memory_order_relaxed) == s1) {
+                        advance(m_seq + 1);
+                        return true;
+                    }
+                }
+
+                // The slot is being (or has been) overwritten by the producer:
+                // move past the slot it is currently writing
+                m_tail = m_ring.m_tail.load(std::memory_order_acquire);
+                uint64_t from = m_tail + 1 - m_ring.m_capacity;
+                skip(from > m_seq ? from : m_seq + 1);
+            }
+        }
+
+        /// Number of messages published but not yet read by this consumer
+        uint64_t count() const
+        {
+            uint64_t n = m_ring.m_tail.load(std::memory_order_acquire) - m_seq;
+            return n < m_ring.m_capacity ? n : m_ring.m_capacity;
+        }
+
+        /// Sequence number of the next message to be read
+        uint64_t seq()  const { return m_seq;  }
+
+        /// Number of messages overwritten by the producer before this
+        /// consumer read them (always 0 unless Overwrite is true)
+        uint64_t lost() const { return m_lost; }
+
+    private:
+        concurrent_spmc_queue& m_ring;
+        int const              m_id;
+        uint64_t               m_seq;   // Next sequence to read
+        uint64_t               m_tail;  // Cached copy of the producer's tail
+        uint64_t               m_lost;
+
+        void advance(uint64_t a_seq)
+        {
+            m_seq = a_seq;
+            m_ring.m_cursors[m_id].seq.store(a_seq, std::memory_order_release);
+        }
+
+        void skip(uint64_t a_seq)
+        {
+            m_lost += a_seq - m_seq;
+            advance(a_seq);
+        }
+    };
+
+private:
+    // Version used to validate a ring attached to in external memory (last
+    // bit signifies external allocation)
+    static const uint32_t s_version = 0xFF1A3B50;
+
+    uint32_t const          m_version;
+    uint32_t const          m_capacity;
+    uint64_t const          m_mask;
+
+    // Producer's line: the next sequence to publish and the cached position
+    // of the slowest consumer
+    std::atomic<uint64_t>   m_tail      __attribute__((aligned(UTXX_CL_SIZE)));
+    uint64_t                m_min_cache;
+
+    cursor                  m_cursors[MaxConsumers];
+    slot                    m_slots[0];
+
+    concurrent_spmc_queue(uint32_t a_capacity, bool a_external_memory)
+        : m_version  (s_version | (a_external_memory ? 1 : 0))
+        , m_capacity (math::upper_power(a_capacity, 2))
+        , m_mask     (m_capacity - 1)
+        , m_tail     (0)
+        , m_min_cache(0)
+    {
+        for (auto& c : m_cursors) {
+            c.seq.store(0, std::memory_order_relaxed);
+            c.active.store(0, std::memory_order_relaxed);
+        }
+        for (uint32_t i = 0; i < m_capacity; ++i)
+            new (&m_slots[i].seq) std::atomic<uint64_t>(0);
+    }
+
+    ~concurrent_spmc_queue()
+    {
+        if (std::is_trivially_destructible<T>::value)
+            return;
+        uint64_t n = m_tail.load(std::memory_order_relaxed);
+        for (uint64_t i = 0, e = n < m_capacity ? n : m_capacity; i < e; ++i)
+            m_slots[i].data.~T();
+    }
+
+    /// Position of the slowest subscribed consumer (or \a a_tail if there
+    /// are none)
+    uint64_t min_cursor(uint64_t a_tail) const
+    {
+        uint64_t res = a_tail;
+        for (auto& c : m_cursors)
+            if (c.active.load(std::memory_order_acquire)) {
+                uint64_t n = c.seq.load(std::memory_order_acquire);
+                if (n < res)
+                    res = n;
+            }
+        return res;
+    }
+
+    /// Claim a free cursor positioned at the current tail.
+    /// @return consumer id, or -1 if all cursors are taken
+    int subscribe()
+    {
+        for (uint32_t i = 0; i < MaxConsumers; ++i) {
+            uint32_t inactive = 0;
+            cursor&  c        = m_cursors[i];
+            if (c.active.compare_exchange_strong(inactive, 1,
+                                                 std::memory_order_acq_rel)) {
+                // NB: a stale cursor seen by the producer before this store
+                // is behind the tail, so it only makes the producer wait
+                c.seq.store(m_tail.load(std::memory_order_acquire),
+                            std::memory_order_release);
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void unsubscribe(int a_id)
+    {
+        assert(a_id >= 0 && uint32_t(a_id) < MaxConsumers);
+        m_cursors[a_id].active.store(0, std::memory_order_release);
+    }
+};
+
+} // namespace utxx
@@ -38,9 +38,11 @@
 */
 #pragma once
 
+#include <utxx/config.h>
 #include <utxx/math.hpp>
 #include <utxx/error.hpp>
 #include <utxx/compiler_hints.hpp>
+#include <utxx/detail/span_pair.hpp>
 #include <boost/noncopyable.hpp>
 #include <atomic>
 #include <cassert>
@@ -59,10 +61,21 @@ namespace utxx {
 // concurrent_spsc_queue is a one producer and one consumer queue            //
 // without locks.                                                            //
 //===========================================================================//
-template<class T, uint32_t StaticCapacity=0>
+/// Each side keeps a cached copy of the other side's index and reloads it
+/// only when the queue looks full (producer) or empty (consumer), so most
+/// operations don't touch the cache line written by the other side.
+///
+/// When \a Padded is true, the head and tail indices (as well as the cached
+/// copies of them) are placed on separate cache lines in order to avoid
+/// false sharing between the producer and the consumer. Note that this
+/// changes the layout of the shared header (see memory_size()).
+template<class T, uint32_t StaticCapacity=0, bool Padded=false>
 class concurrent_spsc_queue : private boost::noncopyable
 {
 private:
+    /// Size of padding that moves the next member to another cache line
+    static constexpr size_t s_pad = Padded ? UTXX_CL_SIZE : 0;
+
     //=======================================================================//
     // Implementation:                                                       //
     //=======================================================================//
@@ -72,7 +85,9 @@ private:
     struct header
     {
         std::atomic<uint32_t>  m_head;
+        char                   m_head_pad[s_pad];
         std::atomic<uint32_t>  m_tail;
+        char                   m_tail_pad[s_pad];
         uint32_t    const      m_capacity;
         T                      __padding[0];
 
@@ -115,12 +130,50 @@ private:
     uint32_t decrement(uint32_t h, int val = 1) const
       { return (h - val) & m_mask; }
 
+    /// Consumer side: check if there's an item at head \a h, reloading the
+    /// tail only if the cached copy says the queue is empty
+    bool available(uint32_t h) const
+    {
+        return h != m_tail_cache ||
+               h != (m_tail_cache = tail().load(std::memory_order_acquire));
+    }
+
+    /// Producer side: number of free slots (up to \a n) at tail \a t,
+    /// reloading the head only if the cached copy doesn't have enough room
+    uint32_t writable(uint32_t t, uint32_t n)
+    {
+        uint32_t room = (m_head_cache - t - 1) & m_mask;
+        if (room < n)
+        {
+            m_head_cache = head().load(std::memory_order_acquire);
+            room = (m_head_cache - t - 1) & m_mask;
+        }
+        return room < n ? room : n;
+    }
+
+    /// Consumer side: number of stored items (up to \a n) at head \a h,
+    /// reloading the tail only if the cached copy doesn't have enough items
+    uint32_t readable(uint32_t h, uint32_t n) const
+    {
+        uint32_t cnt = (m_tail_cache - h) & m_mask;
+        if (cnt < n)
+        {
+            m_tail_cache = tail().load(std::memory_order_acquire);
+            cnt = (m_tail_cache - h) & m_mask;
+        }
+        return cnt < n ? cnt : n;
+    }
+
 public:
     //=======================================================================//
     // External API: Synchronous Operations:                                 //
     //=======================================================================//
     typedef T value_type;
 
+    /// Range of queue slots returned by claim() and peek(n). The second span
+    /// is non-empty only if the range wraps around the end of the storage
+    typedef detail::span_pair<T> span_pair;
+
     /// @return memory size needed for allocating internal queue data.
     /// Note that the actual capacity may be lower (a rounded-down power of 2).
     static uint32_t memory_size(uint32_t a_capacity)
@@ -156,6 +209,8 @@ public:
         , m_shared_data(true)
         , m_side       (a_side)
         , m_mask       (m_header.m_capacity-1)
+        , m_head_cache (head().load(std::memory_order_relaxed))
+        , m_tail_cache (tail().load(std::memory_order_relaxed))
     {
         // Verify that the sizes are correct (as would indeed be the case if
         // "a_size" was computed by "memory_size" above):
@@ -185,6 +240,8 @@ public:
         , m_shared_data(false)
         , m_side       (side_t::both)
         , m_mask       (m_header.m_capacity-1)
+        , m_head_cache (0)
+        , m_tail_cache (0)
     {
         if (unlikely(StaticCapacity != 0))
             UTXX_THROW_RUNTIME_ERROR("Cannot specify both static and dynamic "
@@ -203,6 +260,8 @@ public:
         , m_shared_data(false)
         , m_side       (side_t::both)
         , m_mask       (m_header.m_capacity-1)
+        , m_head_cache (0)
+        , m_tail_cache (0)
     {}
 
     /// Dtor:
@@ -252,7 +311,8 @@ public:
         uint32_t t    = tail().load(std::memory_order_relaxed);
         uint32_t next = increment(t);
 
-        if (next != head().load(std::memory_order_acquire))
+        if (next != m_head_cache ||
+            next != (m_head_cache = head().load(std::memory_order_acquire)))
         {
             T* at = m_rec_ptr + t;
             new (at) T(std::forward<Args>(a_item_args)...);
@@ -270,7 +330,7 @@ public:
         assert(m_side != side_t::producer);
 
         uint32_t h = head().load(std::memory_order_relaxed);
-        if (h == tail().load(std::memory_order_acquire))
+        if (!available(h))
             // queue is empty:
             return false;
 
@@ -290,7 +350,7 @@ public:
         assert(m_side != side_t::producer);
 
         uint32_t h = head().load(std::memory_order_relaxed);
-        assert(h  != tail().load(std::memory_order_acquire));
+        assert(available(h));
 
         uint32_t next = increment(h);
         if (!std::is_trivially_destructible<T>::value)
@@ -307,10 +367,9 @@ public:
         assert(m_side != side_t::producer);
 
         uint32_t h = head().load(std::memory_order_relaxed);
-        return
-            (h == tail().load(std::memory_order_acquire))
-            ? nullptr    // queue is empty
-            : (m_rec_ptr + h);
+        return available(h)
+            ? (m_rec_ptr + h)
+            : nullptr;   // queue is empty
     }
 
     /// Pointer to the value at the front of the queue (for use in-place) or
@@ -321,6 +380,90 @@ public:
               (const_cast<concurrent_spsc_queue const*>(this)->peek());
     }
 
+    //-----------------------------------------------------------------------//
+    // Batch operations:                                                     //
+    //-----------------------------------------------------------------------//
+    // Each of these updates the shared index once per batch rather than once
+    // per item.
+    //
+    /// Reserve up to \a n free slots at the tail of the queue for in-place
+    /// construction (Producer side). The returned slots are raw storage: the
+    /// caller must construct T objects in the first k of them and then call
+    /// publish(k). The result is empty if the queue is full.
+    span_pair claim(uint32_t n)
+    {
+        assert(m_side != side_t::consumer);
+        uint32_t t = tail().load(std::memory_order_relaxed);
+        return span_pair::make(m_rec_ptr, capacity(), t, writable(t, n));
+    }
+
+    /// Make \a n items previously constructed in the slots returned by
+    /// claim() visible to the Consumer with a single index update
+    void publish(uint32_t n)
+    {
+        assert(m_side != side_t::consumer);
+        uint32_t t = tail().load(std::memory_order_relaxed);
+        // Check against the current head, leaving the cached copy alone
+        assert(n <= ((head().load(std::memory_order_acquire) - t - 1) & m_mask));
+        tail().store(increment(t, n), std::memory_order_release);
+    }
+
+    /// Copy up to \a n items from \a a_first to the queue (Producer side).
+    /// @return the number of items inserted (less than \a n if the queue
+    /// becomes full)
+    template <class InputIt>
+    uint32_t push_n(InputIt a_first, uint32_t n)
+    {
+        span_pair r = claim(n);
+        for (T* p = r.first.begin();  p != r.first.end();  ++p, ++a_first)
+            new (p) T(*a_first);
+        for (T* p = r.second.begin(); p != r.second.end(); ++p, ++a_first)
+            new (p) T(*a_first);
+        if (!r.empty())
+            publish(r.size());
+        return r.size();
+    }
+
+    /// Up to \a n items at the front of the queue for use in-place
+    /// (Consumer side). The items stay in the queue until release() is
+    /// called. The result is empty if the queue is empty.
+    span_pair peek(uint32_t n)
+    {
+        assert(m_side != side_t::producer);
+        uint32_t h = head().load(std::memory_order_relaxed);
+        return span_pair::make(m_rec_ptr, capacity(), h, readable(h, n));
+    }
+
+    /// Remove \a n items from the front of the queue with a single index
+    /// update. The queue must contain at least \a n items.
+    void release(uint32_t n)
+    {
+        assert(m_side != side_t::producer);
+        uint32_t h = head().load(std::memory_order_relaxed);
+        // Check against the current tail, leaving the cached copy alone
+        assert(n <= ((tail().load(std::memory_order_acquire) - h) & m_mask));
+        if (!std::is_trivially_destructible<T>::value)
+            for (uint32_t i = 0, j = h; i < n; ++i, j = increment(j))
+                m_rec_ptr[j].~T();
+        head().store(increment(h, n), std::memory_order_release);
+    }
+
+    /// Move up to \a n items from the front of the queue to \a a_out
+    /// (Consumer side).
+    /// @return the number of items removed from the queue
+    template <class OutputIt>
+    uint32_t pop_n(OutputIt a_out, uint32_t n)
+    {
+        span_pair r = peek(n);
+        for (T& v : r.first)
+            *a_out++ = std::move(v);
+        for (T& v : r.second)
+            *a_out++ = std::move(v);
+        if (!r.empty())
+            release(r.size());
+        return r.size();
+    }
+
     /// Clear: Remove all entries from the queue. Only safe if invoked on the
     /// Consumer side:
     void clear(bool force = false)
@@ -329,11 +472,10 @@ public:
         // NOT be on the Producer side:
         assert(force || m_side != side_t::producer);
 
-        if (std::is_trivially_destructible<T>::value)
-            head().store
-                (tail().load(std::memory_order_acquire),
-                 std::memory_order_release);
-        else
+        if (std::is_trivially_destructible<T>::value) {
+            m_tail_cache = tail().load(std::memory_order_acquire);
+            head().store(m_tail_cache, std::memory_order_release);
+        } else
             // Have to do it by-one so the Dtor is called every time:
             while (!empty())
                 pop();
@@ -736,6 +878,11 @@ private:
     bool     const  m_shared_data;
     side_t          m_side;
     uint32_t const  m_mask;
+    char            m_head_cache_pad[s_pad];
+    uint32_t        m_head_cache;   // Producer's copy of head
+    char            m_tail_cache_pad[s_pad];
+    mutable uint32_t m_tail_cache;  // Consumer's copy of tail
+    char            m_records_pad[s_pad];
     T               m_records[StaticCapacity];
 
     //-----------------------------------------------------------------------//
@@ -160,6 +160,15 @@ namespace utxx
                 invoker(it->sink);
         }
 
+        /// Notify all event sinks passing each sink's id to the invoker
+        /// as: invoker(int id, TSink& sink)
+        template <class TInvoker>
+        void emit_with_id(TInvoker const& invoker)
+        {
+            for (sink_list_iter it=m_sinks.begin(), e=m_sinks.end(); it != e; ++it)
+                invoker(it->id, it->sink);
+        }
+
         /// Syntactic sugar for <emit()>
         template <class TInvoker>
         void operator() (TInvoker const& invoker) { emit(invoker); }
@@ -0,0 +1,77 @@
+// vim:ts=4:et:sw=4
+//----------------------------------------------------------------------------
+/// \file  span_pair.hpp
+//----------------------------------------------------------------------------
+/// \brief A pair of contiguous memory spans describing a range of slots in a
+/// circular buffer that may wrap around the end of its storage.
+//----------------------------------------------------------------------------
+// Copyright (c) 2026 agent <agent@local>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <cstddef>
+
+namespace utxx {
+namespace detail {
+
+    /// Range of slots in a circular buffer. The \a second span is non-empty
+    /// only when the range wraps around the end of the storage, in which
+    /// case it starts at the beginning of the storage.
+    template <class E>
+    struct span_pair {
+        struct span {
+            E*     data;
+            size_t size;
+
+            E* begin() const { return data;        }
+            E* end()   const { return data + size; }
+        };
+
+        span first;
+        span second;
+
+        /// Total number of slots in both spans
+        size_t size()  const { return first.size + second.size; }
+        bool   empty() const { return !first.size; }
+
+        /// Access i-th slot of the range (i < size())
+        E& operator[](size_t i) const {
+            return i < first.size ? first.data[i] : second.data[i-first.size];
+        }
+
+        /// Make a range of \a n slots starting at index \a pos in the
+        /// storage \a base of \a capacity slots
+        static span_pair make(E* base, size_t capacity, size_t pos, size_t n) {
+            size_t n1 = capacity - pos;
+            if (n <= n1)
+                return span_pair{{base + pos, n}, {base, 0}};
+            return span_pair{{base + pos, n1}, {base, n - n1}};
+        }
+    };
+
+} // namespace detail
+} // namespace utxx
@@ -0,0 +1,122 @@
+// vim:ts=4:et:sw=4
+//----------------------------------------------------------------------------
+/// \file  thread_owned.hpp
+//----------------------------------------------------------------------------
+/// \brief Objects that a container keeps for each thread using it (such as
+/// a magazine of free nodes), looked up without locking and handed over to
+/// another thread when the owner exits.
+//----------------------------------------------------------------------------
+// Copyright (c) 2026 agent <agent@local>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace utxx {
+namespace detail {
+
+    /// Base of an object owned by one thread on behalf of a container.
+    /// The object is shared by the container and the thread's cache, so
+    /// either of them may go away first.
+    struct thread_owned {
+        /// Set when the owner thread exits. The container may then hand
+        /// the object over to another thread with adopt().
+        std::atomic<bool> orphaned{false};
+        /// Cleared by the container when it's destroyed
+        std::atomic<bool> alive{true};
+
+        /// Take over an orphaned object. The caller sees all changes made
+        /// by the previous owner.
+        bool adopt() {
+            bool exp = true;
+            return orphaned.load(std::memory_order_relaxed) &&
+                   orphaned.compare_exchange_strong(exp, false, std::memory_order_acquire);
+        }
+    };
+
+    /// Unique id of a container keeping thread_owned objects. Ids are shared
+    /// by all container types, since they all use the same thread cache.
+    inline uint64_t next_thread_owned_id() {
+        static std::atomic<uint64_t> s_next_id(1);
+        return s_next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Per-thread map of container ids to the objects the calling thread
+    /// owns in those containers. Entries are few, so they are kept in a
+    /// vector with the most recently added one first.
+    class thread_owned_cache {
+        struct entry {
+            uint64_t                      id;
+            std::shared_ptr<thread_owned> obj;
+        };
+
+        std::vector<entry> m_entries;
+
+        static bool& destroyed() { static thread_local bool s_val = false; return s_val; }
+
+        thread_owned_cache() {}
+
+        ~thread_owned_cache() {
+            destroyed() = true;
+            for (auto& e : m_entries)
+                e.obj->orphaned.store(true, std::memory_order_release);
+        }
+    public:
+        /// Cache of the calling thread or NULL if the thread is exiting
+        /// and its cache has already been destroyed
+        static thread_owned_cache* instance() {
+            if (destroyed())
+                return nullptr;
+            static thread_local thread_owned_cache s_cache;
+            return &s_cache;
+        }
+
+        /// Object owned by the calling thread in the container \a a_id
+        thread_owned* find(uint64_t a_id) const {
+            for (auto& e : m_entries)
+                if (e.id == a_id)
+                    return e.obj.get();
+            return nullptr;
+        }
+
+        /// Register the object \a a_obj owned by the calling thread in the
+        /// container \a a_id, and drop the entries of destroyed containers
+        void add(uint64_t a_id, std::shared_ptr<thread_owned> a_obj) {
+            for (auto it = m_entries.begin(); it != m_entries.end(); )
+                if (it->obj->alive.load(std::memory_order_relaxed))
+                    ++it;
+                else
+                    it = m_entries.erase(it);
+            m_entries.insert(m_entries.begin(), entry{a_id, std::move(a_obj)});
+        }
+    };
+
+} // namespace detail
+} // namespace utxx
@@ -0,0 +1,303 @@
+//----------------------------------------------------------------------------
+/// \file  direct_file_writer.hpp
+//----------------------------------------------------------------------------
+/// \brief File writer bypassing the page cache.
+///
+/// Data is accumulated in a block-aligned staging buffer, and whole blocks
+/// are written to a file open with O_DIRECT. The last partial block is
+/// written through the page cache when the file is closed. File extents
+/// are preallocated with fallocate(2) to reduce fragmentation.
+//----------------------------------------------------------------------------
+// Copyright (c) 2026 agent <agent@local>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <new>
+#include <string>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <boost/noncopyable.hpp>
+
+namespace utxx {
+
+/// Writer of a file open with O_DIRECT
+///
+/// If the file system doesn't support O_DIRECT, the file is written through
+/// the page cache using the same block-sized writes. This class is not
+/// thread-safe.
+class direct_file_writer : private boost::noncopyable {
+public:
+    /// Alignment of buffers, file offsets and write sizes required by O_DIRECT
+    static constexpr size_t s_block_size = 4096;
+
+    /// @param a_buf_sz     size of the staging buffer (rounded up to the
+    ///                     block size)
+    /// @param a_prealloc   size of file extents to preallocate at a time
+    ///                     (0 - don't preallocate)
+    explicit direct_file_writer(size_t a_buf_sz   = 1024 * 1024,
+                                size_t a_prealloc = 64 * 1024 * 1024)
+        : m_fd(-1), m_direct(false)
+        , m_buf(nullptr)
+        , m_buf_sz(round_up(std::max<size_t>(a_buf_sz, 1)))
+        , m_fill(0), m_offset(0), m_allocated(0), m_prealloc(a_prealloc)
+    {
+        if (::posix_memalign((void**)&m_buf, s_block_size, m_buf_sz))
+            throw std::bad_alloc();
+    }
+
+    ~direct_file_writer() {
+        close();
+        ::free(m_buf);
+    }
+
+    /// Open the file \a a_filename
+    /// @return 0 on success or -1 on error, in which case errno is set
+    int open(const std::string& a_filename, bool a_append = true,
+             int a_perm = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+
+    /// Append \a a_sz bytes to the staging buffer writing out whole blocks
+    /// when it's full
+    /// @return \a a_sz on success or -1 on error
+    ssize_t write(const char* a_data, size_t a_sz);
+
+    /// Append an array of \a a_cnt buffers
+    /// @return number of bytes written or -1 on error
+    ssize_t writev(const iovec* a_iov, size_t a_cnt);
+
+    /// Write out all whole blocks in the staging buffer. The last partial
+    /// block remains in the buffer until more data arrives or the file is
+    /// closed.
+    /// @return 0 on success or -1 on error
+    int flush() { return write_blocks(); }
+
+    /// Write all remaining data and close the file
+    /// @return 0 on success or -1 on error
+    int close();
+
+    int    fd()       const { return m_fd;             }
+    bool   is_open()  const { return m_fd >= 0;        }
+    /// True if the file is open with O_DIRECT
+    bool   direct()   const { return m_direct;         }
+    /// Logical size of the file including buffered data
+    size_t size()     const { return m_offset + m_fill; }
+    size_t buf_size() const { return m_buf_sz;         }
+
+private:
+    int     m_fd;
+    bool    m_direct;
+    char*   m_buf;
+    size_t  m_buf_sz;
+    size_t  m_fill;         // Number of bytes in the staging buffer
+    size_t  m_offset;       // File offset of the staging buffer (block-aligned)
+    size_t  m_allocated;    // End of the preallocated file extent
+    size_t  m_prealloc;
+
+    static size_t round_up(size_t a) {
+        return (a + s_block_size - 1) & ~(s_block_size - 1);
+    }
+
+    int pwrite_all(const char* a_data, size_t a_sz, size_t a_offset);
+    int write_blocks();
+    void reserve(size_t a_end);
+};
+
+//----------------------------------------------------------------------------
+// Implementation
+//----------------------------------------------------------------------------
+
+inline int direct_file_writer::
+open(const std::string& a_filename, bool a_append, int a_perm)
+{
+    if (is_open()) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    int flags = O_RDWR | O_CREAT | O_LARGEFILE | (a_append ? 0 : O_TRUNC);
+
+    m_fd     = ::open(a_filename.c_str(), flags | O_DIRECT, a_perm);
+    m_direct = m_fd >= 0;
+
+    // File system doesn't support O_DIRECT
+    if (m_fd < 0 && errno == EINVAL)
+        m_fd = ::open(a_filename.c_str(), flags, a_perm);
+
+    if (m_fd < 0)
+        return -1;
+
+    struct stat st;
+    if (::fstat(m_fd, &st) < 0) {
+        int e = errno;
+        ::close(m_fd);
+        m_fd  = -1;
+        errno = e;
+        return -1;
+    }
+
+    // Writes start at the beginning of the last partial block, so read
+    // that block into the staging buffer
+    m_allocated = st.st_size;
+    m_offset    = st.st_size & ~(s_block_size - 1);
+    m_fill      = st.st_size - m_offset;
+
+    if (m_fill) {
+        ssize_t n = ::pread(m_fd, m_buf, s_block_size, m_offset);
+        if (n != ssize_t(m_fill)) {
+            int e = n < 0 ? errno : EIO;
+            ::close(m_fd);
+            m_fd  = -1;
+            errno = e;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+inline ssize_t direct_file_writer::
+write(const char* a_data, size_t a_sz)
+{
+    for (size_t left = a_sz; left; ) {
+        size_t n = std::min(left, m_buf_sz - m_fill);
+        memcpy(m_buf + m_fill, a_data, n);
+        m_fill += n;
+        a_data += n;
+        left   -= n;
+
+        if (m_fill == m_buf_sz && write_blocks() < 0)
+            return -1;
+    }
+    return a_sz;
+}
+
+inline ssize_t direct_file_writer::
+writev(const iovec* a_iov, size_t a_cnt)
+{
+    ssize_t total = 0;
+    for (auto p = a_iov, e = a_iov + a_cnt; p != e; ++p) {
+        if (write(static_cast<const char*>(p->iov_base), p->iov_len) < 0)
+            return -1;
+        total += p->iov_len;
+    }
+    return total;
+}
+
+inline int direct_file_writer::
+close()
+{
+    if (!is_open())
+        return 0;
+
+    int rc = write_blocks();
+
+    // Write the tail through the page cache since its size is not a
+    // multiple of the block size
+    if (!rc && m_fill) {
+        if (m_direct)
+            ::fcntl(m_fd, F_SETFL, ::fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+        rc = pwrite_all(m_buf, m_fill, m_offset);
+        if (!rc) {
+            m_offset += m_fill;
+            m_fill    = 0;
+        }
+    }
+
+    int e = errno;
+
+    // Release extents preallocated beyond the end of data
+    if (m_allocated > m_offset && !rc)
+        (void)::ftruncate(m_fd, m_offset);
+
+    ::close(m_fd);
+    m_fd        = -1;
+    m_direct    = false;
+    m_fill      = 0;
+    m_offset    = 0;
+    m_allocated = 0;
+    errno       = e;
+    return rc;
+}
+
+inline int direct_file_writer::
+pwrite_all(const char* a_data, size_t a_sz, size_t a_offset)
+{
+    while (a_sz) {
+        ssize_t n = ::pwrite(m_fd, a_data, a_sz, a_offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        a_data   += n;
+        a_sz     -= n;
+        a_offset += n;
+    }
+    return 0;
+}
+
+inline int direct_file_writer::
+write_blocks()
+{
+    size_t n = m_fill & ~(s_block_size - 1);
+    if (!n)
+        return 0;
+
+    reserve(m_offset + n);
+
+    if (pwrite_all(m_buf, n, m_offset) < 0)
+        return -1;
+
+    m_offset += n;
+    m_fill   -= n;
+    // Move the partial block to the beginning of the buffer
+    if (m_fill)
+        memcpy(m_buf, m_buf + n, m_fill);
+    return 0;
+}
+
+inline void direct_file_writer::
+reserve(size_t a_end)
+{
+    if (!m_prealloc || a_end <= m_allocated)
+        return;
+
+    size_t len = round_up(std::max(m_prealloc, a_end - m_allocated));
+
+    // FALLOC_FL_KEEP_SIZE leaves the file size to reflect the data written
+    if (::fallocate(m_fd, FALLOC_FL_KEEP_SIZE, m_allocated, len) < 0) {
+        // Not supported by the file system - don't try again
+        m_prealloc = 0;
+        return;
+    }
+    m_allocated += len;
+}
+
+} // namespace utxx
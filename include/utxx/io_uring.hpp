@@ -0,0 +1,270 @@
+//----------------------------------------------------------------------------
+/// \file  io_uring.hpp
+//----------------------------------------------------------------------------
+/// \brief Minimal io_uring submission/completion queue wrapper.
+///
+/// The wrapper talks to the kernel through raw system calls so that it
+/// doesn't depend on liburing. It is meant to be used by a single thread
+/// that both submits requests and reaps their completions.
+//----------------------------------------------------------------------------
+// Copyright (c) 2026 agent <agent@local>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <utxx/config.h>
+
+#ifdef UTXX_HAVE_IO_URING_H
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <cstdint>
+
+namespace utxx {
+
+/// Single-threaded io_uring instance
+class io_uring_queue {
+    int         m_fd       = -1;
+    unsigned    m_features = 0;
+
+    void*       m_sq_ptr   = nullptr;
+    size_t      m_sq_sz    = 0;
+    void*       m_cq_ptr   = nullptr;
+    size_t      m_cq_sz    = 0;
+    io_uring_sqe* m_sqes   = nullptr;
+    size_t      m_sqes_sz  = 0;
+
+    unsigned*   m_sq_head  = nullptr;
+    unsigned*   m_sq_tail  = nullptr;
+    unsigned    m_sq_mask  = 0;
+    unsigned    m_sq_size  = 0;
+    unsigned*   m_sq_array = nullptr;
+
+    unsigned*   m_cq_head  = nullptr;
+    unsigned*   m_cq_tail  = nullptr;
+    unsigned    m_cq_mask  = 0;
+    io_uring_cqe* m_cqes   = nullptr;
+
+    unsigned    m_local_tail = 0;   // SQ tail not yet published to the kernel
+    unsigned    m_to_submit  = 0;   // Number of SQEs prepared but not submitted
+    unsigned    m_inflight   = 0;   // Number of submitted requests not reaped
+
+    static unsigned load_acquire(const unsigned* p) {
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    }
+    static void store_release(unsigned* p, unsigned v) {
+        __atomic_store_n(p, v, __ATOMIC_RELEASE);
+    }
+    template <class T>
+    static T* at(void* a_base, unsigned a_off) {
+        return reinterpret_cast<T*>(static_cast<char*>(a_base) + a_off);
+    }
+public:
+    io_uring_queue() {}
+    ~io_uring_queue() { close(); }
+
+    io_uring_queue(const io_uring_queue&) = delete;
+    io_uring_queue& operator=(const io_uring_queue&) = delete;
+
+    /// Create the ring with \a a_entries submission queue slots
+    /// @return 0 on success or -errno on failure
+    int init(unsigned a_entries) {
+        if (active())
+            return -EBUSY;
+
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        int fd = ::syscall(__NR_io_uring_setup, a_entries, &params);
+        if (fd < 0)
+            return -errno;
+
+        m_fd       = fd;
+        m_features = params.features;
+
+        // Writes must be done at the current file position, which
+        // preserves O_APPEND semantics of the file
+        if (!(m_features & IORING_FEAT_RW_CUR_POS)) {
+            close();
+            return -ENOTSUP;
+        }
+
+        m_sq_sz   = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cq_sz   = params.cq_off.cqes  + params.cq_entries * sizeof(io_uring_cqe);
+        m_sqes_sz = params.sq_entries * sizeof(io_uring_sqe);
+
+        bool single = m_features & IORING_FEAT_SINGLE_MMAP;
+        if (single && m_cq_sz > m_sq_sz)
+            m_sq_sz = m_cq_sz;
+
+        m_sq_ptr = ::mmap(nullptr, m_sq_sz, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        if (m_sq_ptr == MAP_FAILED) {
+            m_sq_ptr = nullptr;
+            return fail();
+        }
+
+        if (single)
+            m_cq_ptr = m_sq_ptr;
+        else {
+            m_cq_ptr = ::mmap(nullptr, m_cq_sz, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+            if (m_cq_ptr == MAP_FAILED) {
+                m_cq_ptr = nullptr;
+                return fail();
+            }
+        }
+
+        void* sqes = ::mmap(nullptr, m_sqes_sz, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            return fail();
+        m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+        m_sq_head  = at<unsigned>(m_sq_ptr, params.sq_off.head);
+        m_sq_tail  = at<unsigned>(m_sq_ptr, params.sq_off.tail);
+        m_sq_mask  = *at<unsigned>(m_sq_ptr, params.sq_off.ring_mask);
+        m_sq_size  = params.sq_entries;
+        m_sq_array = at<unsigned>(m_sq_ptr, params.sq_off.array);
+
+        m_cq_head  = at<unsigned>(m_cq_ptr, params.cq_off.head);
+        m_cq_tail  = at<unsigned>(m_cq_ptr, params.cq_off.tail);
+        m_cq_mask  = *at<unsigned>(m_cq_ptr, params.cq_off.ring_mask);
+        m_cqes     = at<io_uring_cqe>(m_cq_ptr, params.cq_off.cqes);
+
+        m_local_tail = *m_sq_tail;
+        m_to_submit  = 0;
+        m_inflight   = 0;
+        return 0;
+    }
+
+    /// Unmap the rings and close the io_uring file descriptor.
+    /// Requests still in flight are not waited for.
+    void close() {
+        if (m_sqes)                         ::munmap(m_sqes,   m_sqes_sz);
+        if (m_cq_ptr && m_cq_ptr!=m_sq_ptr) ::munmap(m_cq_ptr, m_cq_sz);
+        if (m_sq_ptr)                       ::munmap(m_sq_ptr, m_sq_sz);
+        if (m_fd >= 0)                      ::close(m_fd);
+        m_sqes   = nullptr;
+        m_cq_ptr = m_sq_ptr = nullptr;
+        m_fd     = -1;
+        m_inflight = m_to_submit = 0;
+    }
+
+    bool     active()   const { return m_fd >= 0; }
+    int      fd()       const { return m_fd;      }
+    unsigned features() const { return m_features; }
+
+    /// Number of requests prepared or submitted whose completions
+    /// haven't been reaped yet
+    unsigned inflight() const { return m_inflight; }
+
+    /// Get the next free submission queue entry.
+    /// @return NULL if the submission queue is full
+    io_uring_sqe* get_sqe() {
+        if (m_local_tail - load_acquire(m_sq_head) >= m_sq_size)
+            return nullptr;
+        // Don't let the number of outstanding requests overflow the CQ ring
+        if (m_inflight >= m_sq_size)
+            return nullptr;
+        unsigned idx = m_local_tail & m_sq_mask;
+        io_uring_sqe* sqe = &m_sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        m_sq_array[idx] = idx;
+        ++m_local_tail;
+        ++m_to_submit;
+        ++m_inflight;
+        return sqe;
+    }
+
+    /// Prepare a writev(2) at the current file position of \a a_fd
+    static void prep_writev(io_uring_sqe* a_sqe, int a_fd, const iovec* a_iov,
+                            unsigned a_cnt, const void* a_user_data)
+    {
+        a_sqe->opcode    = IORING_OP_WRITEV;
+        a_sqe->fd        = a_fd;
+        a_sqe->off       = uint64_t(-1);
+        a_sqe->addr      = reinterpret_cast<uint64_t>(a_iov);
+        a_sqe->len       = a_cnt;
+        a_sqe->user_data = reinterpret_cast<uint64_t>(a_user_data);
+    }
+
+    /// Submit prepared entries to the kernel, and optionally wait
+    /// for at least \a a_wait_nr completions.
+    /// @return number of submitted entries or -errno on error
+    int submit(unsigned a_wait_nr = 0) {
+        if (!m_to_submit && !a_wait_nr)
+            return 0;
+
+        store_release(m_sq_tail, m_local_tail);
+
+        unsigned flags = a_wait_nr ? IORING_ENTER_GETEVENTS : 0;
+        int      n;
+        do {
+            n = ::syscall(__NR_io_uring_enter, m_fd, m_to_submit, a_wait_nr,
+                          flags, nullptr, 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n < 0)
+            return -errno;
+        m_to_submit -= std::min<unsigned>(n, m_to_submit);
+        return n;
+    }
+
+    /// Call \a a_fun(uint64_t user_data, int result) for every
+    /// available completion
+    /// @return number of completions processed
+    template <class Fun>
+    int reap(const Fun& a_fun) {
+        int      n    = 0;
+        unsigned head = *m_cq_head;
+        for (; head != load_acquire(m_cq_tail); ++n) {
+            io_uring_cqe cqe = m_cqes[head & m_cq_mask];
+            store_release(m_cq_head, ++head);
+            --m_inflight;
+            a_fun(cqe.user_data, cqe.res);
+            head = *m_cq_head;
+        }
+        return n;
+    }
+
+private:
+    int fail() {
+        int e = errno;
+        close();
+        return -e;
+    }
+};
+
+} // namespace utxx
+
+#endif // UTXX_HAVE_IO_URING_H
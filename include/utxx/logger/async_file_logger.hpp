@@ -33,6 +33,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #pragma once
 
 #include <utxx/synch.hpp>
+#include <utxx/compiler_hints.hpp>
 #include <iostream>
 #include <functional>
 #include <atomic>
@@ -45,6 +46,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <assert.h>
 #include <sys/types.h>
 #include <fcntl.h>
+#include <utxx/direct_file_writer.hpp>
+#include <utxx/detail/thread_owned.hpp>
+#include <sched.h>
+#include <vector>
 
 namespace utxx {
 
@@ -54,6 +59,16 @@ namespace utxx {
 #   define UTXX_ASYNC_TRACE(...)
 #endif
 
+//-----------------------------------------------------------------------------
+/// Action taken by basic_async_logger when a producer thread's pool of
+/// message slots is exhausted
+//-----------------------------------------------------------------------------
+enum class pool_overflow {
+    ALLOCATE,   ///< Take the message from the allocator (memory isn't bounded)
+    BLOCK,      ///< Wait until the writer thread returns a slot
+    FAIL        ///< Fail the write
+};
+
 //-----------------------------------------------------------------------------
 /// Traits of asynchronous logger using file stream writing
 //-----------------------------------------------------------------------------
@@ -99,6 +114,15 @@ struct async_file_logger_traits {
     static const int commit_timeout     = 1000;    // commit interval in msecs
     static const int commit_queue_limit = 1000000; // max queue size forcing commit
     static const int write_buf_sz       = 256;
+
+    // Messages fitting in a slot are taken from a per-producer-thread pool
+    // of msg_pool_slots slots (0 - always use the allocator). Pools are off
+    // by default, since each producer thread of each logger would reserve
+    // msg_pool_slots * msg_pool_slot_sz bytes (e.g. 4096 * 320 = 1.3M).
+    static const size_t msg_pool_slots   = 0;
+    static const size_t msg_pool_slot_sz = 320;    // including message header
+    // Default action when a thread's pool is exhausted
+    static const pool_overflow msg_pool_overflow = pool_overflow::ALLOCATE;
 };
 
 //-----------------------------------------------------------------------------
@@ -121,28 +145,94 @@ struct async_fd_logger_traits : public async_file_logger_traits {
     static int file_flush(file_type  a_fd) { return 0; }
 };
 
+//-----------------------------------------------------------------------------
+/// Traits of asynchronous logger writing files with O_DIRECT
+/// Messages are staged in a block-aligned buffer of direct_buf_sz bytes,
+/// so that writing a log doesn't evict other data from the page cache.
+/// On every commit whole blocks are written to disk. The last partial
+/// block is written when the file is closed.
+//-----------------------------------------------------------------------------
+struct async_direct_logger_traits : public async_file_logger_traits {
+    using file_type  = direct_file_writer*;
+    static constexpr const file_type null_file_value = nullptr;
+
+    static const size_t direct_buf_sz      = 1024 * 1024;       // staging buffer
+    static const size_t direct_prealloc_sz = 64 * 1024 * 1024;  // fallocate size
+
+    static file_type file_open(const std::string& a_filename,
+                               int a_perm  = def_permissions) {
+        std::unique_ptr<direct_file_writer>
+            p(new direct_file_writer(direct_buf_sz, direct_prealloc_sz));
+        return p->open(a_filename, true, a_perm) < 0 ? nullptr : p.release();
+    };
+
+    static int file_write(file_type a_fd, const char* a_data, size_t a_sz) {
+        return a_fd->write(a_data, a_sz);
+    };
+
+    static int file_close(file_type& a_fd) {
+        int rc = a_fd->close();
+        delete a_fd;
+        a_fd = nullptr;
+        return rc;
+    }
+    static int file_flush(file_type  a_fd) { return a_fd->flush(); }
+};
+
 //-----------------------------------------------------------------------------
 /// Asynchronous logger of text messages.
 //-----------------------------------------------------------------------------
 template<typename traits = async_file_logger_traits>
 class basic_async_logger {
 protected:
+    struct magazine;
+
     class cons: public traits::msg_type {
         using base      = typename traits::msg_type;
         using allocator = typename traits::allocator;
     public:
-        cons(const char* a_data, size_t a_sz) : base(a_data, a_sz) {}
+        cons(const char* a_data, size_t a_sz, magazine* a_pool = nullptr)
+            : base(a_data, a_sz), m_pool(a_pool)
+        {}
 
-        cons* next()        { return m_next; }
-        void  next(cons* p) { m_next = p;    }
+        cons*     next()        { return m_next; }
+        void      next(cons* p) { m_next = p;    }
+        /// Pool owning this message (NULL if it came from the allocator)
+        magazine* pool()  const { return m_pool; }
     private:
-        cons* m_next = nullptr;
+        cons*     m_next = nullptr;
+        magazine* m_pool;
     };
 
+    /// Pool of message slots owned by one producer thread. The owner takes
+    /// slots from its private free list, and when it runs dry grabs the whole
+    /// list of slots returned by the writer thread. Neither side calls
+    /// malloc/free in the steady state. When the owner exits, the pool is
+    /// adopted by the next thread that needs one.
+    struct magazine : public detail::thread_owned {
+        char*               slab;
+        cons*               free     = nullptr; // Accessed by the owner only
+        std::atomic<cons*>  returned{nullptr};  // Slots released by consumers
+
+        /// Push a chain of released slots [a_first, a_last]
+        void release(cons* a_first, cons* a_last) {
+            cons* head = returned.load(std::memory_order_relaxed);
+            do {
+                a_last->next(head);
+            } while (!returned.compare_exchange_weak(head, a_first,
+                        std::memory_order_release, std::memory_order_relaxed));
+        }
+    };
+
+    // Size of a pool slot rounded up to preserve alignment of messages
+    static constexpr size_t s_slot_sz =
+        (traits::msg_pool_slot_sz + alignof(cons) - 1) & ~(alignof(cons) - 1);
+
     using allocator    = typename traits::allocator;
     using event_type   = typename traits::event_type;
     using log_msg_type = cons;
     using file_type    = typename traits::file_type;
+    using magazine_vec = std::vector<std::shared_ptr<magazine>>;
 
     std::unique_ptr<std::thread> m_thread;
     allocator                    m_allocator;
@@ -159,6 +249,17 @@ protected:
     bool                         m_close_on_exit;
     std::mutex                   m_starter_mtx;
     std::condition_variable      m_starter_cv;
+    const uint64_t               m_id;          // Unique id of this instance
+    magazine_vec                 m_magazines;
+    std::mutex                   m_pool_mtx;    // Guards m_magazines
+    pool_overflow                m_pool_overflow;
+
+    // Pool of the calling thread (created or adopted on first use).
+    // NULL if the thread is exiting.
+    magazine* local_magazine();
+    void      free_magazines();
+    // Take a slot from the pool, applying m_pool_overflow when it's empty
+    log_msg_type* pool_allocate(magazine* a_mag, size_t a_sz);
 
     // Invoked by the async thread to flush messages from queue to file
     int  commit(const struct timespec* tsp = NULL);
@@ -183,11 +284,13 @@ public:
         , m_commit_msec        (a_commit_msec)
         , m_commit_queue_limit (traits::commit_queue_limit)
         , m_close_on_exit      (true)
+        , m_id                 (detail::next_thread_owned_id())
+        , m_pool_overflow      (traits::msg_pool_overflow)
     {}
 
     ~basic_async_logger() {
-        if (m_file != traits::null_file_value)
-            stop();
+        stop();
+        free_magazines();
     }
 
     /// Initialize and start asynchronous file writer
@@ -228,13 +331,29 @@ public:
     /// Approximate uncommitted queue size
     long queue_size() const { return m_queue_size.load(std::memory_order_relaxed); }
 
+    /// Action taken when a producer thread's pool of message slots is
+    /// exhausted (defaults to traits::msg_pool_overflow)
+    pool_overflow       msg_pool_overflow()  const { return m_pool_overflow;    }
+    void msg_pool_overflow(pool_overflow a)        { m_pool_overflow = a;       }
+
+    /// Number of per-thread pools of message slots
+    size_t msg_pools() {
+        std::lock_guard<std::mutex> guard(m_pool_mtx);
+        return m_magazines.size();
+    }
+
     /// Allocate a message of size \a a_sz.
-    /// The content of the message is accessible via its data() property
+    /// The content of the message is accessible via its data() property.
+    /// Small messages are taken from the calling thread's pool of
+    /// traits::msg_pool_slots slots, others come from the allocator.
+    /// @return NULL if the pool is exhausted and msg_pool_overflow() is
+    ///         FAIL, or is BLOCK and the logger is not running
     log_msg_type* allocate(size_t a_sz);
     /// Deallocate an object previously allocated by call to allocate().
     void  deallocate(log_msg_type* a_msg);
 
     /// Write a message to the logger by making of copy of
+    /// @return -3 if the message couldn't be allocated
     int   write_copy(const void* a_data, size_t a_sz);
     // Enqueues msg to internal queue
     int   write(log_msg_type* msg);
@@ -331,6 +450,9 @@ start(typename traits::file_type a_file,
     if (m_file != traits::null_file_value)
         return -1;
 
+    // Reap the thread that exited on a write error
+    stop();
+
     m_event.reset();
 
     m_file              = a_file;
@@ -352,15 +474,21 @@ start(typename traits::file_type a_file,
 template<typename traits>
 void basic_async_logger<traits>::stop()
 {
-    if (m_file == traits::null_file_value)
+    // The thread may have exited on a write error, but still needs joining
+    if (!m_thread)
         return;
 
     m_cancel = true;
     UTXX_ASYNC_TRACE("Stopping async logger (head %p)\n", m_head);
     m_event.signal();
-    if (m_thread) {
-        m_thread->join();
-        m_thread.reset();
+    m_thread->join();
+    m_thread.reset();
+
+    // Release the messages queued after the thread exited on a write error
+    for (auto p = m_head.exchange(nullptr, std::memory_order_acquire); p; ) {
+        auto next = p->next();
+        deallocate(p);
+        p = next;
     }
 }
 
@@ -446,16 +574,42 @@ int basic_async_logger<traits>::commit(const struct timespec* tsp)
 
     next = last;
 
+    // Pooled messages are returned to their magazines in runs of consecutive
+    // messages of the same producer, with one CAS per run. On a write error
+    // the rest of the batch is dropped, but still released, so that the
+    // producers' pools don't shrink.
+    log_msg_type* run_head = nullptr;
+    log_msg_type* run_tail = nullptr;
+    int           rc       = 0;
+
     for (auto p = last; next; p = next) {
-        if (traits::file_write(m_file, p->data(), p->size()) < 0)
-            return -1;
+        if (!rc && traits::file_write(m_file, p->data(), p->size()) < 0)
+            rc = -1;
         next = p->next();
         p->next(nullptr);
         UTXX_ASYNC_TRACE("Wrote (%ld bytes): %p (next: %p): %s\n",
                     p->size(), p, next, p->c_str());
-        deallocate(p);
+        if (!p->pool()) {
+            deallocate(p);
+            continue;
+        }
+        if (run_head && run_head->pool() != p->pool()) {
+            run_head->pool()->release(run_head, run_tail);
+            run_head = nullptr;
+        }
+        if (run_head)
+            run_tail->next(p);
+        else
+            run_head = p;
+        run_tail = p;
     }
 
+    if (run_head)
+        run_head->pool()->release(run_head, run_tail);
+
+    if (rc < 0)
+        return rc;
+
     if (traits::file_flush(m_file) < 0)
         return -2;
 
@@ -468,6 +622,16 @@ inline typename basic_async_logger<traits>::log_msg_type*
 basic_async_logger<traits>::
 allocate(size_t  a_sz)
 {
+    if (traits::msg_pool_slots && sizeof(log_msg_type) + a_sz <= s_slot_sz) {
+        // An exiting thread whose pool is gone uses the allocator
+        magazine* m = local_magazine();
+        if (m) {
+            auto p = pool_allocate(m, a_sz);
+            if (p || m_pool_overflow != pool_overflow::ALLOCATE)
+                return p;
+        }
+    }
+
     auto   size  = sizeof(log_msg_type) + a_sz;
     char*  p     = m_allocator.allocate(size);
     char*  data  = p + sizeof(log_msg_type);
@@ -476,22 +640,113 @@ allocate(size_t  a_sz)
     return q;
 }
 
+//-----------------------------------------------------------------------------
+template<typename traits>
+typename basic_async_logger<traits>::log_msg_type*
+basic_async_logger<traits>::
+pool_allocate(magazine* a_mag, size_t a_sz)
+{
+    auto p = a_mag->free;
+    if (!p)
+        p = a_mag->returned.exchange(nullptr, std::memory_order_acquire);
+
+    // Under the blocking policy wait for the writer thread to return slots
+    while (!p && m_pool_overflow == pool_overflow::BLOCK) {
+        if (m_cancel || m_file == traits::null_file_value)
+            return nullptr;
+        m_event.signal();
+        sched_yield();
+        p = a_mag->returned.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    if (!p)
+        return nullptr;
+
+    a_mag->free = p->next();
+    char* data  = reinterpret_cast<char*>(p) + sizeof(log_msg_type);
+    new  (p) log_msg_type(data, a_sz, a_mag);
+    return p;
+}
+
 //-----------------------------------------------------------------------------
 template<typename traits>
 inline void basic_async_logger<traits>::
 deallocate(log_msg_type* a_msg)
 {
+    if (a_msg->pool()) {
+        a_msg->pool()->release(a_msg, a_msg);
+        return;
+    }
     auto size = sizeof(log_msg_type) + a_msg->size();
     a_msg->~log_msg_type();
     m_allocator.deallocate(reinterpret_cast<char*>(a_msg), size);
 }
 
+//-----------------------------------------------------------------------------
+template<typename traits>
+typename basic_async_logger<traits>::magazine*
+basic_async_logger<traits>::
+local_magazine()
+{
+    auto cache = detail::thread_owned_cache::instance();
+    if (unlikely(!cache))
+        return nullptr;
+
+    if (auto m = cache->find(m_id))
+        return static_cast<magazine*>(m);
+
+    std::lock_guard<std::mutex> guard(m_pool_mtx);
+
+    // Reuse the pool of a thread that has exited
+    std::shared_ptr<magazine> m;
+    for (auto& mag : m_magazines)
+        if (mag->adopt()) {
+            m = mag;
+            break;
+        }
+
+    if (!m) {
+        m        = std::make_shared<magazine>();
+        m->slab  = m_allocator.allocate(traits::msg_pool_slots * s_slot_sz);
+        // Thread all slots on the free list
+        for (size_t i = traits::msg_pool_slots; i--; ) {
+            auto p = reinterpret_cast<log_msg_type*>(m->slab + i * s_slot_sz);
+            new (p) log_msg_type(nullptr, 0, m.get());
+            p->next(m->free);
+            m->free = p;
+        }
+        m_magazines.push_back(m);
+    }
+
+    cache->add(m_id, m);
+    return m.get();
+}
+
+//-----------------------------------------------------------------------------
+template<typename traits>
+void basic_async_logger<traits>::
+free_magazines()
+{
+    // Thread caches may still reference the pools, so only their
+    // slabs are freed here
+    std::lock_guard<std::mutex> guard(m_pool_mtx);
+    for (auto& m : m_magazines) {
+        m->alive.store(false, std::memory_order_relaxed);
+        m_allocator.deallocate(m->slab, traits::msg_pool_slots * s_slot_sz);
+        m->slab = nullptr;
+        m->free = nullptr;
+    }
+    m_magazines.clear();
+}
+
 //-----------------------------------------------------------------------------
 template<typename traits>
 inline int basic_async_logger<traits>::
 write_copy(const void* a_data, size_t a_sz)
 {
     auto msg = allocate(a_sz);
+    if (unlikely(!msg))
+        return -3;
     memcpy(msg->data(), a_data, a_sz);
     return write(msg);
 }
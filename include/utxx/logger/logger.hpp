@@ -54,8 +54,13 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/compiler_hints.hpp>
 #include <utxx/config_tree.hpp>
 #include <utxx/concurrent_mpsc_queue.hpp>
+#include <utxx/concurrent_spsc_queue.hpp>
 #include <utxx/logger/logger_enums.hpp>
 #include <utxx/logger/logger_util.hpp>
+#include <utxx/logger/logger_category.hpp>
+#include <utxx/logger/logger_thread.hpp>
+#include <utxx/logger/logger_stats.hpp>
+#include <utxx/logger/logger_record.hpp>
 #include <utxx/synch.hpp>
 #include <thread>
 #include <mutex>
@@ -67,6 +72,19 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/persist_array.hpp>
 #endif
 
+//------------------------------------------------------------------------------
+/// Least severe level of messages compiled in by the UTXX_LOG*/UTXX_CLOG*
+/// macros. Calls of lower levels compile to nothing, so that their arguments
+/// are never evaluated. E.g.: -DUTXX_LOG_MIN_LEVEL=LEVEL_INFO
+//------------------------------------------------------------------------------
+#ifndef UTXX_LOG_MIN_LEVEL
+#   define UTXX_LOG_MIN_LEVEL LEVEL_TRACE5
+#endif
+
+/// Evaluates to false at compile time if \a Level is below UTXX_LOG_MIN_LEVEL
+#define UTXX_LOG_COMPILED(Level) \
+    utxx::is_at_least(Level, utxx::UTXX_LOG_MIN_LEVEL)
+
 #ifndef UTXX_SKIP_LOG_MACROS
 #   define UTXX_LOG_TRACE4( Fmt, ...)     UTXX_CLOG(utxx::LEVEL_TRACE4 , "",  Fmt, ##__VA_ARGS__)
 #   define UTXX_LOG_TRACE3( Fmt, ...)     UTXX_CLOG(utxx::LEVEL_TRACE3 , "",  Fmt, ##__VA_ARGS__)
@@ -167,7 +185,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #define UTXX_LOG_2_ARGS(SI, Level) \
     utxx::logger::msg_streamer(utxx::LEVEL_##Level, "",  SI)
 #define UTXX_LOG_3_ARGS(SI, Level, Cat) \
-    utxx::logger::msg_streamer(utxx::LEVEL_##Level, Cat, SI)
+    utxx::logger::msg_streamer(utxx::LEVEL_##Level, UTXX_LOG_CATEGORY(Cat), SI)
 
 #define UTXX_GET_3RD_ARG(arg1, arg2, arg3, ...) arg3
 #define UTXX_LOG_MACRO_CHOOSER(...) \
@@ -178,17 +196,27 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 /// the <printf> function: <(const char* fmt, ...)>
 //------------------------------------------------------------------------------
 #define UTXX_CLOG(Level, Cat, Fmt, ...) \
-    utxx::logger::instance().logfmt(Level, Cat, UTXX_LOG_SRCINFO, \
-                                    Fmt, ##__VA_ARGS__)
+    (UTXX_LOG_COMPILED(Level) && \
+     utxx::logger::instance().logfmt(Level, UTXX_LOG_CATEGORY(Cat), \
+                                     UTXX_LOG_SRCINFO, \
+                                     Fmt, ##__VA_ARGS__))
 
 //------------------------------------------------------------------------------
 /// Support for streaming version of the logger
 //------------------------------------------------------------------------------
+/// The streamer is only constructed if the level is compiled in and enabled
+//------------------------------------------------------------------------------
+#define UTXX_LOG_IF_ENABLED(Level) \
+    if (!UTXX_LOG_COMPILED(utxx::LEVEL_##Level) || \
+        !utxx::logger::instance().is_enabled(utxx::LEVEL_##Level)) {} else
+
 #define UTXX_LOG(Level, ...) \
+    UTXX_LOG_IF_ENABLED(Level) \
     UTXX_LOG_MACRO_CHOOSER(Level, ##__VA_ARGS__)(UTXX_SRC,  Level, ##__VA_ARGS__)
 
 // Use this macro when the function body begins with: UTXX_PRETTY_FUNCTION()
 #define UTXX_XLOG(Level, ...) \
+    UTXX_LOG_IF_ENABLED(Level) \
     UTXX_LOG_MACRO_CHOOSER(Level, ##__VA_ARGS__)(UTXX_SRCX, Level, ##__VA_ARGS__)
 
 namespace utxx {
@@ -255,24 +283,43 @@ struct logger : boost::noncopyable {
     using str_function   = function
         <std::string (const char* pfx, size_t plen, const char* sfx, size_t slen)>;
 
-    enum class payload_t { STR_FUN, CHAR_FUN, STR };
+    enum class payload_t { STR_FUN, CHAR_FUN, STR, BIN };
+
+    /// Action taken when the shared queue reaches "logger.queue-capacity"
+    enum class overflow_policy {
+        BLOCK,          ///< Wait until the logger's thread frees room (the
+                        ///< logger's thread itself spills or drops)
+        DROP_NEWEST,    ///< Drop the message being logged
+        DROP_BY_LEVEL,  ///< Drop messages below "logger.queue-overflow-level"
+        SPILL           ///< Write the message to "logger.queue-spill-file"
+    };
+
+    /// Strategy used by the logger's thread to wait for new messages
+    enum class wait_strategy {
+        PARK,       ///< Futex wait with wait-timeout-ms after sched-yield-us
+        SPIN,       ///< Busy-spin polling the queues (never parks)
+        BACKOFF,    ///< Spin with exponential pause backoff, then park
+        ADAPTIVE    ///< Spin only when messages are expected to arrive soon
+    };
 
     class msg {
         time_val      m_timestamp;
         log_level     m_level;
-        std::string   m_category;
+        log_category  m_category;
         std::size_t   m_src_loc_len;
         const char*   m_src_location;
         std::size_t   m_src_fun_len;
         const char*   m_src_fun;
         payload_t     m_type;
-        pthread_t     m_thread_id;
-        char          m_thread_name[16];
+        uint16_t      m_thread_idx;     ///< Index in the log_threads registry
 
         union U {
             char_function  cf;
             str_function   sf;
             std::string    str;
+#ifdef UTXX_LOGGER_DEFERRED
+            detail::log_record rec;
+#endif
             U() : cf(nullptr) {}
             U(const char_function& f) : cf(f)  {}
             U(const str_function&  f) : sf(f)  {}
@@ -283,7 +330,7 @@ struct logger : boost::noncopyable {
         friend struct logger;
 
         template <typename Fun>
-        msg(log_level a_ll, const std::string& a_category, payload_t a_type,
+        msg(log_level a_ll, log_category a_category, payload_t a_type,
             const Fun& a_fun,
             const char* a_src_loc, std::size_t a_sloc_len,
             const char* a_src_fun, std::size_t a_sfun_len
@@ -295,24 +342,54 @@ struct logger : boost::noncopyable {
             , m_src_fun_len (a_sfun_len)
             , m_src_fun     (a_src_fun)
             , m_type        (a_type)
-            , m_thread_id   (pthread_self())
+            , m_thread_idx  (this_thread_idx())
             , m_fun         (a_fun)
-        {
-            if (!logger::instance().show_thread() ||
-                pthread_getname_np(m_thread_id, m_thread_name, sizeof(m_thread_name)) < 0)
-                m_thread_name[0] = '\0';
+        {}
+
+        /// @return index of the current thread in the log_threads registry
+        ///         or 0 if thread names are not logged
+        static uint16_t this_thread_idx() {
+            return instance().show_thread() ? log_threads::current() : 0;
         }
 
     public:
+        /// Tag used to construct a message with deferred formatting
+        struct deferred {};
+
+#ifdef UTXX_LOGGER_DEFERRED
+        /// Construct a message by storing raw arguments in a binary record
+        /// that gets formatted in the context of the logger's thread.
+        /// @param a_fmt printf-like format string with static storage
+        ///              duration (if NULL the \a a_args are printed as
+        ///              by the logs() call)
+        template <typename... Args>
+        msg(log_level a_ll, log_category a_cat, deferred,
+            const char* a_src_loc, std::size_t a_sloc_len,
+            const char* a_src_fun, std::size_t a_sfun_len,
+            const char* a_fmt,     Args&&...   a_args)
+            : m_timestamp   (now_utc())
+            , m_level       (a_ll)
+            , m_category    (a_cat)
+            , m_src_loc_len (a_sloc_len)
+            , m_src_location(a_src_loc)
+            , m_src_fun_len (a_sfun_len)
+            , m_src_fun     (a_src_fun)
+            , m_type        (payload_t::BIN)
+            , m_thread_idx  (this_thread_idx())
+        {
+            new (&m_fun.rec) detail::log_record();
+            m_fun.rec.encode(a_fmt, std::forward<Args>(a_args)...);
+        }
+#endif
 
-        msg(log_level a_ll, const std::string& a_cat, const char_function& a_fun,
+        msg(log_level a_ll, log_category a_cat, const char_function& a_fun,
             const char* a_src_loc, std::size_t a_sloc_len,
             const char* a_src_fun, std::size_t a_sfun_len)
             : msg(a_ll, a_cat, payload_t::CHAR_FUN, a_fun,
                   a_src_loc, a_sloc_len, a_src_fun, a_sfun_len)
         {}
 
-        msg(log_level a_ll, const std::string& a_cat, const str_function& a_fun,
+        msg(log_level a_ll, log_category a_cat, const str_function& a_fun,
             const char* a_src_loc, std::size_t a_sloc_len,
             const char* a_src_fun, std::size_t a_sfun_len)
             : msg(a_ll, a_cat, payload_t::STR_FUN, a_fun,
@@ -320,20 +397,20 @@ struct logger : boost::noncopyable {
         {}
 
         template <int N, int M>
-        msg(log_level a_ll, const std::string& a_cat, const str_function& a_fun,
+        msg(log_level a_ll, log_category a_cat, const str_function& a_fun,
             const char (&a_src_loc)[N], const char (&a_src_fun)[M])
             : msg(a_ll, a_cat, payload_t::STR_FUN, a_fun,
                   a_src_loc, N-1, a_src_fun, M-1)
         {}
 
         template <int N, int M>
-        msg(log_level a_ll, const std::string& a_cat, const std::string& a_str,
+        msg(log_level a_ll, log_category a_cat, const std::string& a_str,
             const char (&a_src_loc)[N], const char (&a_src_fun)[M])
             : msg(a_ll, a_cat, payload_t::STR, a_str,
                   a_src_loc, N-1, a_src_fun, M-1)
         {}
 
-        msg(log_level a_ll, const std::string& a_cat, const std::string& a_str,
+        msg(log_level a_ll, log_category a_cat, const std::string& a_str,
             const char* a_src_loc, std::size_t a_sloc_len,
             const char* a_src_fun, std::size_t a_sfun_len)
             : msg(a_ll, a_cat, payload_t::STR, a_str,
@@ -345,36 +422,42 @@ struct logger : boost::noncopyable {
                 case payload_t::STR_FUN:  m_fun.sf = nullptr;  break;
                 case payload_t::CHAR_FUN: m_fun.cf = nullptr;  break;
                 case payload_t::STR:      m_fun.str.~basic_string(); break;
+                case payload_t::BIN:      break;
             }
         }
 
         time_val      timestamp   () const { return m_timestamp;    }
         log_level     level       () const { return m_level;        }
-        std::string   category    () const { return m_category;     }
+        const std::string& category() const { return m_category.name(); }
+        uint16_t      category_id () const { return m_category.id();   }
         std::size_t   src_loc_len () const { return m_src_loc_len;  }
         const char*   src_location() const { return m_src_location; }
         std::size_t   src_fun_len () const { return m_src_fun_len;  }
         const char*   src_fun_name() const { return m_src_fun;      }
         payload_t     type        () const { return m_type;         }
+        uint16_t      thread_idx  () const { return m_thread_idx;   }
+        /// Copy the name of the thread that logged the message to \a a_buf
+        const char*   thread_name (char (&a_buf)[log_threads::s_max_name_len]) const
+        { return log_threads::instance().name(m_thread_idx, a_buf); }
     };
 
     struct msg_streamer {
         detail::basic_buffered_print<512> data;
         log_level                         level;
-        std::string                       category;
+        log_category                      category;
         const char*                       src_loc;
         size_t                            src_loc_len;
         const char*                       src_fun;
         size_t                            src_fun_len;
 
-        msg_streamer(log_level a_ll, const std::string& a_cat, src_info&& a_si)
+        msg_streamer(log_level a_ll, log_category a_cat, src_info&& a_si)
             : level(a_ll), category(a_cat)
             , src_loc(a_si.srcloc()), src_loc_len(a_si.srcloc_len())
             , src_fun(a_si.fun()),    src_fun_len(a_si.fun_len())
         {}
 
         template <int N, int M>
-        msg_streamer(log_level a_ll, const std::string& a_cat,
+        msg_streamer(log_level a_ll, log_category a_cat,
                      const char (&a_src_loc)[N], const char (&a_src_fun)[M])
             : level(a_ll), category(a_cat)
             , src_loc(a_src_loc), src_loc_len(N-1)
@@ -456,10 +539,71 @@ struct logger : boost::noncopyable {
 
 private:
     using concurrent_queue = concurrent_mpsc_queue<msg>;
+    using thread_ring      = concurrent_spsc_queue<msg>;
     using signal_delegate  = signal<on_msg_delegate_t>;
 
+    /// Per-thread queue of messages used when "logger.thread-queue-capacity"
+    /// is non-zero. Queues are never freed while the logger is alive, and
+    /// the queue of an exited thread is reused by the next registered thread.
+    /// A queue still owned by a thread when the logger is destroyed is freed
+    /// by that thread on exit.
+    struct thread_queue {
+        enum state_t { FREE, OWNED, ORPHANED };
+
+        explicit thread_queue(uint32_t a_capacity)
+            : m_ring(a_capacity), m_busy(false), m_state(OWNED), m_owner(0)
+            , m_next(nullptr)
+        {}
+
+        thread_ring             m_ring;
+        std::atomic<bool>       m_busy;     ///< Owner is enqueuing a message
+        std::atomic<int>        m_state;
+        std::atomic<long>       m_owner;    ///< Kernel thread id of the owner
+        thread_queue*           m_next;
+    };
+
+    /// Thread-local reference to the queue owned by the current thread
+    struct thread_queue_ref {
+        thread_queue* m_queue = nullptr;
+        ~thread_queue_ref() {
+            if (m_queue && m_queue->m_state.exchange(thread_queue::FREE) ==
+                           thread_queue::ORPHANED)
+                delete m_queue;
+        }
+    };
+
+    /// Ring of a thread and the number of its messages to be written by
+    /// the current drain_queues() call
+    struct drain_item {
+        thread_ring* ring;
+        uint32_t     count;
+    };
+
+    /// Level filter read by every LOG_* call. It's kept on its own cache
+    /// line, so that it's not invalidated by updates of other members.
+    alignas(64)
+    unsigned int                    m_level_filter          = LEVEL_NO_DEBUG;
+    char                            m_level_filter_pad[64 - sizeof(unsigned int)];
+
+    alignas(64)
     std::unique_ptr<std::thread>    m_thread;
     concurrent_queue                m_queue;
+    long                            m_queue_capacity        = 0;
+    std::atomic<long>               m_queue_size{0};
+    overflow_policy                 m_queue_overflow        = overflow_policy::BLOCK;
+    log_level                       m_queue_overflow_level  = LEVEL_WARNING;
+    std::atomic<long>               m_dropped[NLEVELS];
+    int                             m_spill_fd              = -1;
+    std::mutex                      m_spill_mutex;
+    uint32_t                        m_thread_queue_capacity = 0;
+    std::atomic<thread_queue*>      m_thread_queues{nullptr};
+    std::vector<drain_item>         m_drain_list;
+    std::vector<concurrent_queue::node*> m_sort_buf;
+    concurrent_queue::node*         m_held                  = nullptr;
+    /// Kernel thread id of the logger's thread (0 if it's not running)
+    std::atomic<long>               m_thread_tid{0};
+    /// Set while drain_queues() passes messages to the backends
+    std::atomic<bool>               m_draining{false};
     bool                            m_abort                 = false;
     std::atomic<bool>               m_initialized;
     futex                           m_event;
@@ -467,7 +611,6 @@ private:
     struct timespec                 m_wait_timeout;
 
     signal_delegate                 m_sig_slot[NLEVELS];
-    unsigned int                    m_level_filter          = LEVEL_NO_DEBUG;
     implementations_vector          m_implementations;
     stamp_type                      m_timestamp_type        = TIME;
     char                            m_src_location[256];
@@ -478,15 +621,54 @@ private:
     bool                            m_show_thread           = false;
     std::string                     m_ident;
     bool                            m_silent_finish         = false;
+    bool                            m_deferred_format       = false;
     int                             m_fatal_kill_signal     = 0;
     long                            m_sched_yield_us        = 250;
+    wait_strategy                   m_wait_strategy         = wait_strategy::PARK;
+    long                            m_spin_ns               = 50000;
+    long                            m_arrival_gap_ns        = 0;
+    time_val                        m_last_arrival;
+    std::atomic<bool>               m_parked{false};
     bool                            m_block_signals         = true;
     std::atomic<bool>               m_finalizer_installed;
     config_macros                   m_macro_var_map;
+    bool                            m_latency_stats         = false;
+    latency_histogram               m_queue_latency;
+    latency_histogram               m_format_latency;
+    sigset_t                        m_stats_sigset;
+
+    /// Set by the signal handler to request a dump of latency statistics
+    static std::atomic<bool>        s_dump_stats;
+
+    /// Timestamp of the last whole second formatted by format_header().
+    /// Only the fractional second digits are patched in for every message
+    /// (each instance is used by one thread at a time).
+    struct header_cache {
+        long        sec    = -1;
+        stamp_type  type   = stamp_type::NO_TIMESTAMP;
+        int         len    = 0;     ///< Length of the formatted timestamp
+        int         digits = 0;     ///< Number of fractional second digits
+        char        buf[32];
+    };
+
+    header_cache                    m_header_cache; ///< Used by logger's thread
+    header_cache                    m_spill_cache;  ///< Guarded by m_spill_mutex
 
     /// Signal set handled by the installed crash signal handler
     static std::atomic<sigset_t*>   m_crash_sigset;
 
+    /// Emergency buffer used by flush_on_crash() (reserved by init())
+    std::unique_ptr<char[]>         m_crash_buf;
+    size_t                          m_crash_buf_size        = 0;
+    /// File descriptors of backends written by flush_on_crash()
+    std::vector<int>                m_crash_fds;
+    /// Time flush_on_crash() gives the logger's thread to write out the
+    /// crashing thread's messages
+    int                             m_crash_wait_ms         = 100;
+    /// Offset of local time from UTC in seconds (captured by init())
+    long                            m_utc_offset            = 0;
+    std::atomic<bool>               m_crash_flushed{false};
+
     /// Callback executed on error (e.g. problem writing to logger's back-end)
     std::function<void (const char* a_reason)> m_error;
     /// Callback executed on start of async thread (in the thread's context)
@@ -496,13 +678,17 @@ private:
 
     void  do_finalize();
 
-    char* format_header(const msg& a_msg, char* a_buf, const char* a_end);
+    /// Async-signal-safe formatting of a message used by flush_on_crash()
+    char* format_crash_msg(const msg& a_msg, char* a_buf, const char* a_end) const;
+
+    char* format_header(const msg& a_msg, char* a_buf, const char* a_end,
+                        header_cache& a_cache);
     char* format_footer(const msg& a_msg, char* a_buf, const char* a_end);
 
-    /// @return <true> if log <level> is enabled.
-    bool is_enabled(log_level level) const {
-        return (m_level_filter & (unsigned int)level) != 0;
-    }
+    /// Format a message and pass the resulting buffer to \a a_sink
+    /// that is called as: a_sink(const char* a_buf, size_t a_size)
+    template <typename Sink>
+    void  format_msg(const msg& a_msg, header_cache& a_cache, const Sink& a_sink);
 
     void set_timestamp(char* buf, time_t seconds) const;
 
@@ -517,17 +703,116 @@ private:
 
     void dolog_msg(const msg& a_msg);
     void dolog_fatal_msg(const char* buf, size_t sz);
+    /// Let backends write out messages they buffered
+    void flush_impls();
+
+    /// Add a message to the queue owned by the current thread, or to the
+    /// shared queue if per-thread queues are disabled or full.
+    template <typename... Args>
+    bool enqueue(log_level a_level, Args&&... a_args);
+
+    /// Reserve room for a message in the shared queue when
+    /// "logger.queue-capacity" is set.
+    /// @return false if the message must not be added to the shared queue
+    bool reserve_queue_slot(log_level a_level) {
+        if (likely(m_queue_size.fetch_add(1, std::memory_order_relaxed) < m_queue_capacity))
+            return true;
+        return on_queue_full(a_level);
+    }
+
+    /// Apply the overflow policy to a message that doesn't fit in the queue
+    bool on_queue_full(log_level a_level);
+
+    /// Returns true when called by the logger's own thread
+    bool in_logger_thread() const;
+
+    /// Release a chain of \a a_count shared queue's nodes and their reserved
+    /// capacity
+    void free_queue_items(concurrent_queue::node* a_first, long a_count) {
+        m_queue.free_all(a_first);
+        if (m_queue_capacity && a_count)
+            m_queue_size.fetch_sub(a_count, std::memory_order_release);
+    }
+
+    /// Deliver a formatted message to the backends timing each of them
+    void  emit_timed(int a_slot, const on_msg_delegate_t::invoker_type& a_inv,
+                     time_val a_start);
+
+    /// Log latency statistics if requested by a signal
+    void  dump_stats_on_signal();
+
+    static void on_stats_signal(int);
+
+    /// Write a message to the spill file
+    /// @return false if the message couldn't be written
+    bool spill_msg(const msg& a_msg);
+
+    /// @return the queue owned by the current thread (register one on the
+    ///         first call)
+    thread_queue* this_thread_queue();
+    thread_queue* register_thread_queue();
+
+    /// @return true if there are no pending messages in any queue
+    bool queues_empty() const;
+
+    /// Wait for new messages using the spinning strategies
+    void spin_wait();
+
+    /// Notify the logger's thread about a new message. The futex syscall
+    /// is only made when the thread is parked by a spinning strategy.
+    void wake_logger() {
+        if (unlikely(m_parked.load(std::memory_order_relaxed)))
+            m_event.signal();
+        else
+            m_event.signal_fast();
+    }
+
+    /// Write pending messages merging per-thread queues by timestamp.
+    /// Only the messages enqueued before the call are written, and unless
+    /// \a a_final is set, those stamped after the call started are left
+    /// for the next call, since older messages of other threads may still
+    /// be on their way to the queues.
+    /// @return false on fatal error writing messages
+    bool drain_queues(bool a_final = false);
 
     template<typename Fun>
-    bool dolog(log_level   a_ll, const std::string& a_cat, const Fun& a_fun,
+    bool dolog(log_level   a_ll, log_category a_cat, const Fun& a_fun,
                const char* a_src_loc,  std::size_t  a_src_loc_len,
                const char* a_src_fun,  std::size_t  a_src_fun_len);
 
-    bool dolog(log_level   a_ll, const std::string& a_cat,
+    bool dolog(log_level   a_ll, log_category a_cat,
                const char* a_buf,      std::size_t  a_size,
                const char* a_src_loc,  std::size_t  a_src_loc_len,
                const char* a_src_fun,  std::size_t  a_src_fun_len);
 
+    /// Enqueue a message with arguments stored in a binary record, so that
+    /// formatting happens in the logger's thread.
+    template<typename... Args>
+    bool dolog_deferred(std::true_type,
+               log_level   a_ll, log_category a_cat,
+               const char* a_src_loc,  std::size_t  a_src_loc_len,
+               const char* a_src_fun,  std::size_t  a_src_fun_len,
+               const char* a_fmt,      Args&&...    a_args);
+
+    /// Arguments don't fit in a binary record (never called)
+    template<typename... Args>
+    bool dolog_deferred(std::false_type, log_level, log_category,
+                        const char*, std::size_t, const char*, std::size_t,
+                        const char*, Args&&...) { return false; }
+
+#ifdef UTXX_LOGGER_DEFERRED
+    /// Arguments can be stored in a binary record and formatted by logfmt()
+    template <class... Args>
+    using can_defer_fmt   = detail::log_record::can_defer_fmt<Args...>;
+    /// Arguments can be stored in a binary record and formatted by logs()
+    template <class... Args>
+    using can_defer_print = detail::log_record::can_defer<Args...>;
+#else
+    // Messages have no room for a binary record (see WITH_LOGGER_DEFERRED)
+    template <class... Args> using can_defer_fmt   = std::false_type;
+    template <class... Args> using can_defer_print = std::false_type;
+#endif
+
     void run();
 
     friend class log_msg_info;
@@ -538,8 +823,14 @@ public:
         return s_logger;
     }
 
-    logger()  {}
-    ~logger() { finalize(); }
+    logger() {
+        // The registries are read by finalize() called from the destructor,
+        // so they must be constructed first to be destroyed last
+        log_categories::instance();
+        log_threads::instance();
+        sigemptyset(&m_stats_sigset);
+    }
+    ~logger();
 
     /// @return vector of active back-end logging implementations
     const implementations_vector&  implementations() const;
@@ -601,6 +892,29 @@ public:
     /// Set a callback to be called on start of the logger's async thread
     void set_on_before_run(std::function<void()> a_cb) { m_on_before_run = a_cb; }
 
+    /// Write messages pending in the logger's queues directly to file
+    /// descriptors of the backends (see logger_impl::crash_fd()), and pass
+    /// them to the backends' logger_impl::crash_write().
+    ///
+    /// The function is async-signal-safe and is called by the crash signal
+    /// handler. It formats the messages into a buffer reserved by init(),
+    /// and writes them with write(2). Messages with deferred formatting are
+    /// written as their format strings. Only the first call after init()
+    /// has any effect.
+    ///
+    /// The per-thread queues, the messages held back for ordering, and the
+    /// backends' buffers are owned by the logger's thread:
+    ///   - when the logger's thread is the crashing one, the backends'
+    ///     buffers are written first (see logger_impl::crash_flush()),
+    ///     followed by the held messages and the per-thread queues;
+    ///   - otherwise the logger's thread is given up to
+    ///     "logger.handle-crash-signals.wait-ms" to write out the crashing
+    ///     thread's queue and to finish its current pass.
+    /// In both cases the shared queue is then stolen with an atomic exchange
+    /// and written out.
+    /// @return number of messages written by this call
+    int flush_on_crash();
+
     /// Set a callback to be called on start of the logger's async thread
     void set_on_after_run (std::function<void()> a_cb) { m_on_after_run  = a_cb; }
 
@@ -638,6 +952,28 @@ public:
     /// cause the logger to terminate process by given signal.
     /// @return Fatal kill signal number, 0 is disabled.
     int         fatal_kill_signal()    const { return m_fatal_kill_signal;   }
+    /// @return true if formatting of LOG_* messages is deferred to the
+    ///         logger's thread (see "logger.deferred-format" option)
+    bool        deferred_format()      const { return m_deferred_format;     }
+    /// Enable/disable deferred formatting of LOG_* messages
+    void        deferred_format(bool a_on)   { m_deferred_format = a_on;     }
+    /// @return max number of messages in the shared queue (0 - unbounded)
+    long        queue_capacity()       const { return m_queue_capacity;      }
+    /// @return action taken when the shared queue is full
+    overflow_policy queue_overflow()   const { return m_queue_overflow;      }
+    /// @return number of messages of \a a_level dropped because the
+    ///         shared queue was full
+    long        dropped(log_level a_level) const {
+        return m_dropped[level_to_signal_slot(a_level)].load(std::memory_order_relaxed);
+    }
+    /// @return total number of messages dropped because the queue was full
+    long        dropped()              const;
+    /// @return true if latency statistics are collected
+    bool        latency_stats()        const { return m_latency_stats;       }
+    /// @return snapshot of latency statistics (see "logger.latency-stats")
+    logger_stats stats()               const;
+    /// Reset latency statistics
+    void        reset_stats();
     /// Get program identifier to be used in the log output.
     const std::string&  ident()  const { return m_ident; }
     /// Set program identifier to be used in the log output.
@@ -663,6 +999,11 @@ public:
     /// String representation of log levels enabled by default.  Used in config
     /// parsing.
     static const char* default_log_levels;
+    /// @return <true> if log <level> is enabled.
+    bool is_enabled(log_level level) const {
+        return (m_level_filter & (unsigned int)level) != 0;
+    }
+
     /// Filter mask of levels that need to be logged
     int        level_filter()     const { return m_level_filter; }
     log_level  min_level_filter() const { int n = m_level_filter < LEVEL_TRACE ? LEVEL_TRACE : 0;
@@ -688,7 +1029,7 @@ public:
     ///                  obtained by using UTXX_FILE_SRC_LOCATION macro.
     /// @param a_src_fun identifies the current function name (i.e. __func__).
     template <int N, int M>
-    bool logcs(log_level a_level, const std::string& a_category,
+    bool logcs(log_level a_level, log_category a_category,
                const char* a_msg, size_t a_size,
                const char (&a_src_loc)[N] = "",
                const char (&a_src_fun)[M] = "");
@@ -697,6 +1038,12 @@ public:
     /// Logged message will be limited in size to 1024 bytes.
     /// Formatting of the resulting string to be logged happens in the caller's
     /// context, but actual message logging is handled asynchronously.
+    /// If deferred_format() is enabled and the arguments fit in a binary
+    /// record (see logger_record.hpp), only the raw arguments are copied
+    /// and formatting is done in the logger's thread, in which case
+    /// \a a_fmt must have static storage duration.  Deferred formatting
+    /// requires building with WITH_LOGGER_DEFERRED, which reserves room for
+    /// the binary record in every queued message.
     /// Use the provided <LOG_*> macros instead of calling it directly.
     /// @param a_level is the log level to record
     /// @param a_cat is a category of the message (use NULL if undefined).
@@ -706,7 +1053,7 @@ public:
     /// @param a_fmt is the format string passed to <sprintf()>
     /// @param args is the list of optional arguments passed to <args>
     template<int N, int M, typename... Args>
-    bool logfmt(log_level a_level, const std::string& a_cat,
+    bool logfmt(log_level a_level, log_category a_cat,
                 const char (&a_src_loc)[N], const char (&a_src_fun)[M],
                 const char*  a_fmt, Args&&... a_args);
 
@@ -721,8 +1068,9 @@ public:
     /// @param a_src_fun identifies the current function name (i.e. __func__).
     /// @param a_fmt   is the format string passed to <sprintf()>
     /// @param args    is the list of optional arguments passed to <args>
+    /// @see logfmt() regarding deferred formatting
     template<int N, int M, typename... Args>
-    bool logs(log_level a_level, const std::string& a_cat,
+    bool logs(log_level a_level, log_category a_cat,
               const char (&a_src_loc)[N], const char (&a_src_fun)[M],
               Args&&... a_args);
 
@@ -735,7 +1083,7 @@ public:
     /// @param a_si    identifies the source location of the event
     /// @param args    is the list of optional arguments passed to <args>
     template<typename... Args>
-    bool logs(log_level  a_level, const std::string& a_cat,
+    bool logs(log_level  a_level, log_category a_cat,
               src_info&& a_si,    Args&&... a_args);
 
     /// Log a message of given log level to registered implementations.
@@ -747,7 +1095,7 @@ public:
     ///                  obtained by using UTXX_LOG_SRCINFO macro.
     /// @param a_src_fun identifies the current function name (i.e. __func__).
     template <int N, int M>
-    bool log(utxx::log_level a_level, const std::string& a_cat,
+    bool log(utxx::log_level a_level, log_category a_cat,
              const std::string& a_msg,
              const char (&a_src_loc)[N] = "", const char (&a_src_fun)[M] = "");
 
@@ -757,7 +1105,7 @@ public:
     /// @param a_cat   is a category of the message (use NULL if undefined).
     /// @param a_msg   is the message to be logged
     /// @param a_src   identifies the source location of the error
-    bool log(utxx::log_level  a_level, const std::string& a_cat,
+    bool log(utxx::log_level  a_level, log_category a_cat,
              const std::string& a_msg, src_info&&         a_src);
 
     /// Log a message of given log level to registered implementations.
@@ -773,7 +1121,7 @@ public:
     ///                  obtained by using UTXX_LOG_SRCINFO macro.
     /// @param a_src_fun identifies the current function name (i.e. __func__).
     template<typename Fun, int N, int M>
-    bool async_logf(log_level a_level, const std::string& a_cat, const Fun& a_fun,
+    bool async_logf(log_level a_level, log_category a_cat, const Fun& a_fun,
                     const char (&a_src_loc)[N] = "", const char (&a_src_fun)[M] = "")
     { return dolog(a_level, a_cat, a_fun, a_src_loc, N-1, a_src_fun, M-1); }
 
@@ -785,7 +1133,7 @@ public:
     /// @param a_cat   is a category of the message (use NULL if undefined).
     /// @param args are the arguments to be converted to buffer and logged as string
     template<typename... Args>
-    bool async_logs(log_level a_level, const std::string& a_cat, Args&&... args)
+    bool async_logs(log_level a_level, log_category a_cat, Args&&... args)
     { return async_logs(a_level, a_cat, "", "", std::forward<Args>(args)...); }
 
     /// Log a message of given log level message to registered implementations.
@@ -799,7 +1147,7 @@ public:
     /// @param a_src_fun identifies the current function name (i.e. __func__).
     /// @param args are the arguments to be converted to buffer and logged as string
     template<int N, int M, typename... Args>
-    bool async_logs(log_level a_level, const std::string& a_category,
+    bool async_logs(log_level a_level, log_category a_category,
                     const char (&a_src_loc)[N], const char (&a_src_fun)[M],
                     Args&&... args);
 
@@ -816,7 +1164,7 @@ public:
     /// @param a_src_fun identifies the current function name (i.e. __func__).
     /// @param args is the list of optional arguments passed to <args>
     template<int N, int M, typename... Args>
-    bool async_logfmt(log_level a_level, const std::string& a_cat,
+    bool async_logfmt(log_level a_level, log_category a_cat,
                       const char (&a_src_loc)[N], const char (&a_src_fun)[M],
                       const char* a_fmt, Args&&... a_args);
 };
@@ -838,6 +1186,32 @@ struct logger_impl {
     /// Called by logger upon reading initialization from configuration
     void set_log_mgr(logger* a_log_mgr) { m_log_mgr = a_log_mgr; }
 
+    /// Called by logger in the context of its thread after all messages
+    /// pending in the queue are passed to the backend. Backends that buffer
+    /// messages should write them out here.
+    virtual void flush() {}
+
+    /// File descriptor to which logger::flush_on_crash() writes pending
+    /// messages on crash (-1 if the backend doesn't have one)
+    virtual int crash_fd() const { return -1; }
+
+    /// Called by logger::flush_on_crash() in the logger's thread interrupted
+    /// by a crash signal. Backends that buffer messages should write them
+    /// out here using only async-signal-safe calls.
+    virtual void crash_flush() {}
+
+    /// Called by logger::flush_on_crash() for each message pending in the
+    /// logger's queues, formatted in \a a_buf, so that backends not having
+    /// a crash_fd() can save it. \a a_logger_thread is true when the
+    /// interrupted thread is the logger's one, which may have been in the
+    /// middle of log_msg() of this backend. Only async-signal-safe calls
+    /// may be made here.
+    virtual void crash_write(const logger::msg& a_msg, const char* a_buf,
+                             size_t a_size, bool a_logger_thread) {}
+
+    /// @return time spent writing messages when "logger.latency-stats" is on
+    const latency_histogram& write_latency() const { return m_write_latency; }
+
     /// To be called by <logger_impl> child to register a delegate to be
     /// invoked on a call to LOG_*() macros.
     /// @return Id assigned to the message logger, which is to be used
@@ -854,6 +1228,9 @@ protected:
     logger* m_log_mgr;
     int     m_msg_sink_id[logger::NLEVELS]; // Message sink identifiers in the loggers' signal
 
+    latency_histogram m_write_latency;
+    friend struct logger;
+
     //void do_log(const log_msg_info<>& a_info);
 };
 
@@ -39,10 +39,59 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 namespace utxx {
 
+inline logger::thread_queue* logger::this_thread_queue()
+{
+    static thread_local thread_queue_ref t_ref;
+    if (unlikely(!t_ref.m_queue))
+        t_ref.m_queue = register_thread_queue();
+    return t_ref.m_queue;
+}
+
+template <typename... Args>
+inline bool logger::enqueue(log_level a_level, Args&&... a_args)
+{
+    // While a message is being stamped and enqueued, the thread's queue is
+    // marked busy, so that drain_queues() waits for it to arrive before
+    // writing newer messages of other threads
+    thread_queue* q = nullptr;
+
+    if (m_thread_queue_capacity) {
+        q = this_thread_queue();
+        q->m_busy.store(true, std::memory_order_seq_cst);
+        // The message is only constructed by push() when there's room in the ring
+        bool res = q->m_ring.push(a_level, std::forward<Args>(a_args)...);
+        q->m_busy.store(false, std::memory_order_release);
+        if (res) {
+            wake_logger();
+            return true;
+        }
+    }
+
+    if (m_queue_capacity && unlikely(!reserve_queue_slot(a_level))) {
+        // Under BLOCK this is only reached by the logger's own thread
+        if ((m_queue_overflow == overflow_policy::SPILL ||
+             m_queue_overflow == overflow_policy::BLOCK) &&
+            spill_msg(msg(a_level, std::forward<Args>(a_args)...)))
+            return true;
+        m_dropped[level_to_signal_slot(a_level)].fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (q)
+        q->m_busy.store(true, std::memory_order_seq_cst);
+    bool res = m_queue.emplace(a_level, std::forward<Args>(a_args)...);
+    if (q)
+        q->m_busy.store(false, std::memory_order_release);
+    if (!res && m_queue_capacity)
+        m_queue_size.fetch_sub(1, std::memory_order_relaxed);
+    wake_logger();
+    return res;
+}
+
 template <typename Fun>
 inline bool logger::dolog(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const Fun&          a_fun,
     const char*         a_src_loc,
     std::size_t         a_src_loc_len,
@@ -52,16 +101,14 @@ inline bool logger::dolog(
     if (!is_enabled(a_level))
         return false;
 
-    bool res = m_queue.emplace(a_level, a_cat, a_fun,
-                               a_src_loc, a_src_loc_len,
-                               a_src_fun, a_src_fun_len);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, a_fun,
+                   a_src_loc, a_src_loc_len,
+                   a_src_fun, a_src_fun_len);
 }
 
 inline bool logger::dolog(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const char*         a_buf,
     std::size_t         a_size,
     const char*         a_src_loc,
@@ -74,17 +121,33 @@ inline bool logger::dolog(
 
     std::string sbuf(a_buf, a_size);
 
-    bool res = m_queue.emplace(a_level, a_cat, sbuf,
-                               a_src_loc, a_src_loc_len,
-                               a_src_fun, a_src_fun_len);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, sbuf,
+                   a_src_loc, a_src_loc_len,
+                   a_src_fun, a_src_fun_len);
+}
+
+template <typename... Args>
+inline bool logger::dolog_deferred(
+    std::true_type,
+    log_level           a_level,
+    log_category        a_cat,
+    const char*         a_src_loc,
+    std::size_t         a_src_loc_len,
+    const char*         a_src_fun,
+    std::size_t         a_src_fun_len,
+    const char*         a_fmt,
+    Args&&...           a_args)
+{
+    return enqueue(a_level, a_cat, msg::deferred(),
+                   a_src_loc, a_src_loc_len,
+                   a_src_fun, a_src_fun_len,
+                   a_fmt, std::forward<Args>(a_args)...);
 }
 
 template <int N, int M>
 inline bool logger::logcs(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const char*         a_buf,
     std::size_t         a_size,
     const char        (&a_src_loc)[N],
@@ -94,9 +157,8 @@ inline bool logger::logcs(
 }
 
 namespace {
-    inline int do_copy(char* a_buf, size_t a_sz, const char* a_str) {
-        char* p = a_buf;
-        return stpncpy(p, a_str, a_sz) - a_buf;
+    inline int do_copy(char* a_buf, size_t a_sz, const char* a_fmt) {
+        return detail::copy_fmt(a_buf, a_sz, a_fmt);
     }
     template <class... Args>
     inline int do_copy(char* a_buf, size_t a_sz, const char* a_fmt, Args&&... args) {
@@ -107,7 +169,7 @@ namespace {
 template <int N, int M, typename... Args>
 inline bool logger::logfmt(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const char        (&a_src_loc)[N],
     const char        (&a_src_fun)[M],
     const char*         a_fmt,
@@ -116,40 +178,49 @@ inline bool logger::logfmt(
     if (!is_enabled(a_level))
         return false;
 
+    using can_defer = can_defer_fmt<Args...>;
+    if (can_defer::value && m_deferred_format)
+        return dolog_deferred(can_defer(), a_level, a_cat,
+                              a_src_loc, N-1, a_src_fun, M-1,
+                              a_fmt, std::forward<Args>(a_args)...);
+
     char buf[1024];
     int  n;
     // The condition below prevents the compiler warning about snprintf
     // when there are no arguments provides, since a_fmt is not a string literal
     n = do_copy(buf, sizeof(buf), a_fmt, std::forward<Args>(a_args)...);
     std::string sbuf(buf, std::min<int>(n, sizeof(buf)-1));
-    bool res = m_queue.emplace(a_level, a_cat, sbuf, a_src_loc, N-1, a_src_fun, M-1);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, sbuf, a_src_loc, N-1, a_src_fun, M-1);
 }
 
 template <typename... Args>
 inline bool logger::logs(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     src_info&&          a_si,
     Args&&...           a_args)
 {
     if (!is_enabled(a_level))
         return false;
 
+    using can_defer = can_defer_print<Args...>;
+    if (can_defer::value && m_deferred_format)
+        return dolog_deferred(can_defer(), a_level, a_cat,
+                              a_si.srcloc(), a_si.srcloc_len(),
+                              a_si.fun(),    a_si.fun_len(),
+                              nullptr, std::forward<Args>(a_args)...);
+
     detail::basic_buffered_print<1024> buf;
     buf.print(std::forward<Args>(a_args)...);
-    bool res = m_queue.emplace(a_level, a_cat, buf.to_string(),
-                               a_si.srcloc(), a_si.srcloc_len(),
-                               a_si.fun(), a_si.fun_len());
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, buf.to_string(),
+                   a_si.srcloc(), a_si.srcloc_len(),
+                   a_si.fun(), a_si.fun_len());
 }
 
 template <int N, int M, typename... Args>
 inline bool logger::logs(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const char        (&a_src_loc)[N],
     const char        (&a_src_fun)[M],
     Args&&...           a_args)
@@ -157,18 +228,22 @@ inline bool logger::logs(
     if (!is_enabled(a_level))
         return false;
 
+    using can_defer = can_defer_print<Args...>;
+    if (can_defer::value && m_deferred_format)
+        return dolog_deferred(can_defer(), a_level, a_cat,
+                              a_src_loc, N-1, a_src_fun, M-1,
+                              nullptr, std::forward<Args>(a_args)...);
+
     detail::basic_buffered_print<1024> buf;
     buf.print(std::forward<Args>(a_args)...);
-    bool res = m_queue.emplace(a_level, a_cat, buf.to_string(),
-                               a_src_loc, N-1, a_src_fun, M-1);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, buf.to_string(),
+                   a_src_loc, N-1, a_src_fun, M-1);
 }
 
 template <int N, int M>
 inline bool logger::log(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const std::string&  a_msg,
     const char        (&a_src_loc)[N],
     const char        (&a_src_fun)[M])
@@ -176,30 +251,26 @@ inline bool logger::log(
     if (!is_enabled(a_level))
         return false;
 
-    bool res = m_queue.emplace(a_level, a_cat, a_msg, a_src_loc, N-1, a_src_fun, M-1);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, a_msg, a_src_loc, N-1, a_src_fun, M-1);
 }
 
 inline bool logger::log(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const std::string&  a_msg,
     src_info&&          a_si)
 {
     if (!is_enabled(a_level))
         return false;
 
-    bool res = m_queue.emplace(a_level, a_cat, a_msg, a_si.srcloc(), a_si.srcloc_len(),
-                               a_si.fun(), a_si.fun_len());
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, a_msg, a_si.srcloc(), a_si.srcloc_len(),
+                   a_si.fun(), a_si.fun_len());
 }
 
 template <int N, int M, typename... Args>
 inline bool logger::async_logs(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const char        (&a_src_loc)[N],
     const char        (&a_src_fun)[M],
     Args&&...           a_args)
@@ -214,16 +285,14 @@ inline bool logger::async_logs(
         buf.sprint(sfx, ssz);
         return buf.to_string();
     };
-    bool res = m_queue.emplace(a_level, a_cat, fun, a_src_loc, N-1, a_src_fun, M-1);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, fun, a_src_loc, N-1, a_src_fun, M-1);
 }
 
 // TODO: make synchronous string formatting
 template <int N, int M, typename... Args>
 inline bool logger::async_logfmt(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const char         (&a_src_loc)[N],
     const char         (&a_src_fun)[M],
     const char*         a_fmt,
@@ -235,9 +304,7 @@ inline bool logger::async_logfmt(
     auto fun = [=](char* a_buf, size_t a_size) {
         return snprintf(a_buf, a_size, a_fmt, std::forward<Args>(a_args)...);
     };
-    bool res = m_queue.emplace(a_level, a_cat, fun, a_src_loc, N-1, a_src_fun, M-1);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, fun, a_src_loc, N-1, a_src_fun, M-1);
 }
 
 } // namespace utxx
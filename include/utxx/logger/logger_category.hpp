@@ -0,0 +1,187 @@
+//------------------------------------------------------------------------------
+/// \file   logger_category.hpp
+/// \author agent
+//------------------------------------------------------------------------------
+/// \brief Registry of interned log categories.
+///
+/// Category names are interned once and identified by a small integer ID,
+/// so that log messages don't need to carry a copy of the category string.
+//------------------------------------------------------------------------------
+// Copyright (C) 2026 agent <agent@local>
+// Created: 2026-10-17
+//------------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <cstring>
+#include <utxx/compiler_hints.hpp>
+
+#ifndef UTXX_LOG_MAX_CATEGORIES
+#   define UTXX_LOG_MAX_CATEGORIES 4096
+#endif
+
+namespace utxx {
+
+//------------------------------------------------------------------------------
+/// Registry of interned log category names.
+/// Lookups are lock-free and never allocate memory. Registration of a new
+/// name is guarded by a mutex. Registered names are never removed, so
+/// references returned by name() remain valid for the life of the process.
+//------------------------------------------------------------------------------
+class log_categories {
+public:
+    static constexpr size_t s_max_categories = UTXX_LOG_MAX_CATEGORIES;
+
+    static log_categories& instance() {
+        static log_categories s_instance;
+        return s_instance;
+    }
+
+    /// Intern a category name.
+    /// @return ID of the category (0 is the ID of the empty category). When
+    ///         the max number of categories is reached, new names map to the
+    ///         empty category and are counted by overflows().
+    uint16_t intern(const char* a_name, size_t a_len);
+
+    /// Find the ID of a category.
+    /// @return ID of the category or -1 if it's not registered
+    int find(const char* a_name, size_t a_len) const;
+
+    /// @return name of a category given its ID (empty string if not found)
+    const std::string& name(uint16_t a_id) const {
+        auto p = a_id < s_max_categories
+               ? m_names[a_id].load(std::memory_order_acquire) : nullptr;
+        return p ? p->name : m_names[0].load(std::memory_order_relaxed)->name;
+    }
+
+    /// @return number of registered categories (including the empty one)
+    size_t size() const { return m_count.load(std::memory_order_acquire); }
+
+    /// @return number of intern() calls that didn't fit in the registry
+    size_t overflows() const { return m_overflows.load(std::memory_order_relaxed); }
+
+private:
+    struct entry {
+        std::string name;
+        size_t      hash;
+        uint16_t    id;
+    };
+
+    static constexpr size_t s_table_size = 2*s_max_categories;
+
+    std::atomic<const entry*> m_names[s_max_categories];
+    std::atomic<const entry*> m_table[s_table_size];  ///< Open-addressing hash
+    std::atomic<size_t>       m_count;
+    std::atomic<size_t>       m_overflows;
+    std::mutex                m_mutex;
+
+    log_categories();
+    ~log_categories();
+
+    static size_t hash(const char* a_name, size_t a_len) {
+        // FNV-1a
+        size_t h = 14695981039346656037ul;
+        for (auto p = a_name, e = a_name + a_len; p != e; ++p)
+            h = (h ^ (unsigned char)*p) * 1099511628211ul;
+        return h;
+    }
+
+    const entry* lookup(const char* a_name, size_t a_len, size_t a_hash,
+                        size_t& a_slot) const;
+};
+
+//------------------------------------------------------------------------------
+/// Interned log category.
+/// Implicitly constructible from a string, so that it can be passed in
+/// place of the category name to the logging functions.
+//------------------------------------------------------------------------------
+class log_category {
+    uint16_t m_id;
+public:
+    log_category() : m_id(0) {}
+    explicit log_category(uint16_t a_id) : m_id(a_id) {}
+
+    log_category(const char* a_name)
+        : m_id(a_name && *a_name
+               ? log_categories::instance().intern(a_name, strlen(a_name)) : 0)
+    {}
+
+    log_category(const std::string& a_name)
+        : m_id(a_name.empty()
+               ? 0 : log_categories::instance().intern(a_name.c_str(), a_name.size()))
+    {}
+
+    uint16_t           id()    const { return m_id;      }
+    bool               empty() const { return m_id == 0; }
+    const std::string& name()  const { return log_categories::instance().name(m_id); }
+
+    bool operator==(log_category a) const { return m_id == a.m_id; }
+    bool operator!=(log_category a) const { return m_id != a.m_id; }
+};
+
+//------------------------------------------------------------------------------
+/// Category argument of a LOG_* call site (see UTXX_LOG_CATEGORY).
+/// The ID of a category given by a constant character array (e.g. a string
+/// literal) is cached, and reused as long as the array holds the same name,
+/// so that a literal is interned on the first call only. Other arguments are
+/// interned on every call.
+//------------------------------------------------------------------------------
+class log_category_cache {
+    std::atomic<int> m_id;
+public:
+    log_category_cache() : m_id(-1) {}
+
+    template <size_t N>
+    log_category get(const char (&a_name)[N]) {
+        // A const array other than a literal may change between calls
+        int id = m_id.load(std::memory_order_relaxed);
+        if (likely(id >= 0)) {
+            auto& s = log_categories::instance().name(uint16_t(id));
+            if (likely(s.size() < N &&
+                       memcmp(s.c_str(), a_name, s.size()+1) == 0))
+                return log_category(uint16_t(id));
+        }
+        log_category cat(a_name);
+        m_id.store(cat.id(), std::memory_order_relaxed);
+        return cat;
+    }
+
+    template <size_t N>
+    log_category get(char (&a_name)[N]) { return log_category(a_name); }
+
+    template <class T>
+    log_category get(const T& a_name)   { return log_category(a_name); }
+};
+
+} // namespace utxx
+
+/// Convert the category argument of a LOG_* macro to utxx::log_category
+/// caching the result in a static variable of the call site
+#define UTXX_LOG_CATEGORY(Cat) \
+    ([&]() -> utxx::log_category { \
+        static utxx::log_category_cache s_cat; return s_cat.get(Cat); }())
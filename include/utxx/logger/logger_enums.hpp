@@ -95,6 +95,13 @@ inline log_level as_log_level(uint8_t a) {
     return log_level(i < 5 ? (1 << 5 | 1 << i) : 1 << i);
 }
 
+/// Check that \a a_lhs log level is at least as severe as \a a_rhs
+/// (TRACE5 < TRACE4 < ... < TRACE < DEBUG < INFO < ... < ALERT < LOG).
+constexpr bool is_at_least(log_level a_lhs, log_level a_rhs) {
+    return a_lhs != LEVEL_NONE &&
+          (a_rhs == LEVEL_NONE || __builtin_ctz(a_lhs) >= __builtin_ctz(a_rhs));
+}
+
 } // namespace utxx
 
 #endif // _UTXX_LOGGER_ENUMS_HPP_
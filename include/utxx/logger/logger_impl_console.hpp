@@ -77,6 +77,8 @@ public:
 
     void log_msg(const logger::msg& a_msg, const char* a_buf, size_t a_size)
          throw  (io_error);
+
+    int  crash_fd() const override { return STDERR_FILENO; }
 };
 
 } // namespace utxx
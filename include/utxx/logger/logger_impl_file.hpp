@@ -73,16 +73,33 @@ class logger_impl_file: public logger_impl {
     int          m_fd;
     boost::mutex m_mutex;
     bool         m_no_header;
+    /// When non-zero, messages are coalesced in m_batch and written with a
+    /// single write(2) call at the end of each drain of the logger's queue,
+    /// or when the batch exceeds this number of bytes
+    size_t       m_batch_size;
+    std::string  m_batch;
+    /// When non-zero, fdatasync(2) is called after writing a batch if this
+    /// number of milliseconds passed since the last sync
+    int          m_sync_interval_ms;
+    time_val     m_next_sync;
 
     logger_impl_file(const char* a_name)
         : m_name(a_name), m_append(true), m_use_mutex(false)
         , m_levels(LEVEL_NO_DEBUG)
         , m_mode(0644), m_fd(-1), m_no_header(false)
+        , m_batch_size(0), m_sync_interval_ms(0)
     {}
 
     void finalize() {
-        if (m_fd > -1) { close(m_fd); m_fd = -1; }
+        if (m_fd > -1) {
+            try { flush(); } catch (...) {}
+            close(m_fd);
+            m_fd = -1;
+        }
     }
+
+    /// Write all bytes of the buffer to file
+    void write_all(const char* a_buf, size_t a_size) throw(io_error);
 public:
     static logger_impl_file* create(const char* a_name) {
         return new logger_impl_file(a_name);
@@ -102,6 +119,14 @@ public:
 
     void log_msg(const logger::msg& a_msg, const char* a_buf, size_t a_size)
         throw(io_error);
+
+    /// Write out the pending batch of messages
+    void flush() override;
+
+    int  crash_fd() const override { return m_fd; }
+
+    /// Write out the pending batch of messages with write(2)
+    void crash_flush() override;
 };
 
 } // namespace utxx
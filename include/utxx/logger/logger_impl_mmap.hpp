@@ -0,0 +1,97 @@
+//----------------------------------------------------------------------------
+/// \file   logger_impl_mmap.hpp
+/// \author agent
+//----------------------------------------------------------------------------
+/// \brief Back-end plugin writing log records to a memory-mapped ring file
+/// for the <logger> class.
+///
+/// Formatted messages are copied into a fixed-size circular file mapped in
+/// memory (see <mmap_log_ring>), so logging a message doesn't involve any
+/// system calls, and the last "logger.mmap.size-mb" megabytes of the log
+/// survive a crash of the process. Use the <mmaptail> utility to read the
+/// ring either live or post-mortem.
+///
+/// Like other backends, the ring is written by the logger's thread. When
+/// "logger.handle-crash-signals" is on, the messages still in the logger's
+/// queues on a crash are also written to the ring by
+/// logger::flush_on_crash() (see crash_write()).
+///
+/// Only one process may write a given ring file: init() fails if another
+/// one has it open.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 agent <agent@local>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#ifndef _UTXX_LOGGER_MMAP_HPP_
+#define _UTXX_LOGGER_MMAP_HPP_
+
+#include <utxx/logger.hpp>
+#include <utxx/mmap_log_ring.hpp>
+
+namespace utxx {
+
+class logger_impl_mmap: public logger_impl {
+    std::string   m_name;
+    std::string   m_filename;
+    size_t        m_size_mb;
+    bool          m_append;
+    mode_t        m_mode;
+    uint32_t      m_levels;
+    mmap_log_ring m_ring;
+
+    logger_impl_mmap(const char* a_name)
+        : m_name(a_name), m_size_mb(16), m_append(true), m_mode(0644)
+        , m_levels(LEVEL_NO_DEBUG)
+    {}
+
+    void finalize() { m_ring.close(); }
+public:
+    static logger_impl_mmap* create(const char* a_name) {
+        return new logger_impl_mmap(a_name);
+    }
+
+    virtual ~logger_impl_mmap() {
+        finalize();
+    }
+
+    const std::string& name() const { return m_name; }
+
+    /// Dump all settings to stream
+    std::ostream& dump(std::ostream& out, const std::string& a_prefix) const;
+
+    bool init(const variant_tree& a_config)
+        throw(badarg_error, io_error);
+
+    void log_msg(const logger::msg& a_msg, const char* a_buf, size_t a_size)
+        throw(io_error);
+
+    void crash_write(const logger::msg& a_msg, const char* a_buf, size_t a_size,
+                     bool a_logger_thread) override;
+};
+
+} // namespace utxx
+
+#endif
@@ -2,29 +2,19 @@
 /// \file   logger_impl_scribe.hpp
 /// \author Serge Aleynikov
 //----------------------------------------------------------------------------
-/// \brief Back-end plugin implementating synchronous file writer for the
+/// \brief Back-end plugin sending log messages to a scribed server for the
 /// <logger> class.
 ///
-/// This implementation allows multiple threads to call the <LOG_*> 
-/// logging macros concurrently.  However, its performance is dependent upon
-/// the file writing mode.  Linux has a bug ("feature"?) that if a file is
-/// open without O_APPEND option, making write(2) calls on a file descriptor
-/// is not thread-safe in a way that content written by one thread can be 
-/// overwriten by the content written by another thread before that data is
-/// written by kernel to the filesystem.  Consequently, concurrent writes
-/// to a file descriptor open without O_APPEND flag must be protected by a 
-/// mutex.  In our testing it seemed that the Linux kernel implementation of 
-/// the write(2) function in presence of the O_APPEND flag is using proper
-/// synchronization.  As a workaround for this oddity, the <logger_impl_scribe>
-/// uses a mutex to guard the write(2) call when "logger.file.append" option
-/// is <false> and doesn't use the mutex otherwise.  This has a rather drastic
-/// impact on performance (up to 10x in latency hit).
-/// Use the following test cases to see performance impact of using a mutex:
-/// <code>
-/// "THREAD=3 VERBOSE=1 test_logger --run_test=test_file_perf_overwrite
-/// "THREAD=3 VERBOSE=1 test_logger --run_test=test_file_perf_append
-/// "THREAD=3 VERBOSE=1 test_logger --run_test=test_file_perf_no_mutex
-/// </code>
+/// Messages are appended to an in-memory spool by the logger's thread, and
+/// a separate sender thread sends them to the server in batches of up to
+/// "logger.scribe.batch-size" entries with one Log() call. A batch is sent
+/// when it's full or when its oldest entry is "logger.scribe.batch-age-ms"
+/// old. While the server is unavailable (including at startup, which
+/// doesn't fail initialization), the spool holds up to
+/// "logger.scribe.spool-size" messages and reconnection is attempted with
+/// exponential backoff, so that the logger's thread is never blocked by
+/// the network. Messages that don't fit in the spool are appended to the
+/// "logger.scribe.spill-file" (or dropped if it's not configured).
 //----------------------------------------------------------------------------
 // Copyright (C) 2009 Serge Aleynikov <saleyn@gmail.com>
 // Created: 2009-11-25
@@ -61,6 +51,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/logger.hpp>
 #include <utxx/logger/logger_impl.hpp>
 #include <utxx/multi_file_async_logger.hpp>
+#include <utxx/time_val.hpp>
 #include <utxx/url.hpp>
 #include <sys/types.h>
 
@@ -76,27 +67,25 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <thrift/transport/TSocket.h>
 #include <thrift/transport/TBufferTransports.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace utxx {
 
 class logger_impl_scribe
     : public logger_impl
 {
-//     struct logger_traits: public multi_file_async_logger_traits {
-//         typedef memory::cached_allocator<char> allocator;
-//     };
-
-//    typedef basic_multi_file_async_logger<logger_traits> async_logger_engine;
-
     struct log_item {
         std::string category;
         std::string message;
+        time_val    time;       ///< Time when the item was spooled
     };
 
-    typedef basic_multi_file_async_logger<>                 async_logger_engine;
-    typedef typename async_logger_engine::stream_state_base stream_state_base;
-
     enum {
         DEFAULT_PORT    = 1463,
         DEFAULT_TIMEOUT = 5000,
@@ -111,12 +100,30 @@ class logger_impl_scribe
     addr_info                                m_server_addr;
     int                                      m_server_timeout;
     int                                      m_levels;
-    boost::mutex                             m_mutex;
+    size_t                                   m_batch_size;
+    int                                      m_batch_age_ms;
+    size_t                                   m_spool_size;
+    int                                      m_reconnect_min_ms;
+    int                                      m_reconnect_max_ms;
+    std::string                              m_spill_file;
+    int                                      m_spill_fd;
+    std::mutex                               m_spill_mutex;
+
+    // Spool of messages not yet sent to the server (guarded by m_mutex)
+    std::deque<log_item>                     m_spool;
+    std::mutex                               m_mutex;
+    std::condition_variable                  m_cond;
+    std::thread                              m_thread;
+    bool                                     m_stop;
+
+    // Reconnection state (used by the sender thread only)
     int                                      m_reconnecting;
+    int                                      m_backoff_ms;
+    time_val                                 m_next_attempt;
 
-    std::unique_ptr<async_logger_engine>     m_engine_ptr;
-    async_logger_engine*                     m_engine;
-    typename async_logger_engine::file_id    m_fd;
+    std::atomic<size_t>                      m_sent;
+    std::atomic<size_t>                      m_spilled;
+    std::atomic<size_t>                      m_dropped;
 
     boost::shared_ptr<apache::thrift::transport::TSocket>           m_socket;
     boost::shared_ptr<apache::thrift::transport::TFramedTransport>  m_transport;
@@ -133,15 +140,21 @@ class logger_impl_scribe
     int  connect();
     void disconnect();
 
-    int writev(typename async_logger_engine::stream_info& a_si,
-               const char* a_categories[], const iovec* a_data, size_t size);
-    int on_reconnect(typename async_logger_engine::stream_info& a_si);
+    /// Sender thread's loop
+    void run();
+    /// Try to reconnect to the server unless it's too early since the last
+    /// attempt. @return true if connected
+    bool reconnect(time_val a_now);
+    /// Send a batch with one Log() call. @return true on success
+    bool send_batch(const std::vector<log_item>& a_batch);
+    /// Append items to the spill file or count them as dropped
+    void spill(const log_item* a_items, size_t a_count);
 
     int write_string(const char* a_str, int a_size);
     uint32_t read_scribe_result(scribe_result_code& a_rc, bool& a_is_set);
     scribe_result_code recv_log_reply();
 
-    int write_items(const char* a_categories[], const iovec* a_data, size_t a_size);
+    int write_items(const std::vector<log_item>& a_items);
 
 public:
     static logger_impl_scribe* create(const char* a_name) {
@@ -150,12 +163,21 @@ public:
 
     virtual ~logger_impl_scribe() { finalize(); }
 
-    // This method allows the logging implementation to use
-    // an external logging engine
-    void set_engine(multi_file_async_logger& a_engine) { m_engine = &a_engine; }
+    /// Messages are sent by the backend's own thread, so the external
+    /// engine is no longer used. Kept for source compatibility.
+    [[deprecated]]
+    void set_engine(multi_file_async_logger&) {}
 
     const std::string& name() const { return m_name; }
 
+    /// Number of messages delivered to the server
+    size_t sent()    const { return m_sent.load(std::memory_order_relaxed);    }
+    /// Number of messages written to the spill file
+    size_t spilled() const { return m_spilled.load(std::memory_order_relaxed); }
+    /// Number of messages lost because the spool was full and there's no
+    /// spill file
+    size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
     /// Dump all settings to stream
     std::ostream& dump(std::ostream& out, const std::string& a_prefix) const;
 
@@ -50,10 +50,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 ***** END LICENSE BLOCK *****
 */
-#ifndef _UTXX_LOGGER_FILE_HPP_
-#define _UTXX_LOGGER_FILE_HPP_
+#ifndef _UTXX_LOGGER_SYSLOG_HPP_
+#define _UTXX_LOGGER_SYSLOG_HPP_
 
 #include <utxx/logger.hpp>
+#include <syslog.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <boost/thread.hpp>
@@ -85,6 +86,13 @@ public:
 
     const std::string& name() const { return m_name; }
 
+    /// Convert a facility name (e.g. "log-local6") to the LOG_* constant
+    static int parse_facility(const std::string& a_facility)
+        throw(std::runtime_error);
+
+    /// Convert a log level to the syslog priority (0 if not supported)
+    static int priority(log_level a_level);
+
     /// Dump all settings to stream
     std::ostream& dump(std::ostream& out, const std::string& a_prefix) const;
 
@@ -0,0 +1,133 @@
+//----------------------------------------------------------------------------
+/// \file   logger_impl_syslog_dgram.hpp
+/// \author agent
+//----------------------------------------------------------------------------
+/// \brief Back-end plugin sending RFC5424 syslog frames to a datagram socket
+/// for the <logger> class.
+///
+/// Unlike <logger_impl_syslog>, which calls syslog(3) that takes a lock and
+/// sends each message separately, this backend formats frames itself and
+/// sends the frames accumulated during a drain of the logger's queue with a
+/// single sendmmsg(2) call.
+///
+/// Configuration options:
+///  - logger.syslog-dgram.address = URL::string()
+///      Either "uds:///dev/log" (default) or "udp://host:port".
+///  - logger.syslog-dgram.levels, facility, show-pid
+///      Same as the corresponding options of the "syslog" backend.
+///  - logger.syslog-dgram.batch-size = int()
+///      Max number of frames sent by one sendmmsg(2) call. Default: 64.
+///  - logger.syslog-dgram.max-frame = int()
+///      Max size of a frame in bytes (longer messages are truncated).
+///      Default: 2048.
+///  - logger.syslog-dgram.nonblock = bool()
+///      When true, frames that can't be sent without blocking are dropped.
+///      Default: false.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 agent <agent@local>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#ifndef _UTXX_LOGGER_SYSLOG_DGRAM_HPP_
+#define _UTXX_LOGGER_SYSLOG_DGRAM_HPP_
+
+#include <utxx/logger.hpp>
+#include <sys/socket.h>
+#include <atomic>
+#include <vector>
+
+namespace utxx {
+
+class logger_impl_syslog_dgram: public logger_impl {
+    std::string           m_name;
+    std::string           m_address;
+    uint32_t              m_levels;
+    std::string           m_facility;
+    int                   m_facility_code;
+    bool                  m_show_pid;
+    bool                  m_nonblock;
+    size_t                m_batch_size;
+    size_t                m_max_frame;
+    int                   m_fd;
+    /// " HOSTNAME APP-NAME PROCID " part of the frame header
+    std::string           m_host_app_pid;
+    /// Cached "YYYY-MM-DDTHH:MM:SS" of m_last_sec
+    char                  m_time_str[20];
+    long                  m_last_sec;
+    /// Frames of the current batch (m_batch_size slots of m_max_frame bytes)
+    std::vector<char>     m_frames;
+    std::vector<iovec>    m_iov;
+    std::vector<mmsghdr>  m_msgs;
+    size_t                m_count;
+    std::atomic<size_t>   m_dropped;
+
+    logger_impl_syslog_dgram(const char* a_name)
+        : m_name(a_name), m_levels(LEVEL_NO_DEBUG & ~LEVEL_LOG)
+        , m_facility_code(0), m_show_pid(true), m_nonblock(false)
+        , m_batch_size(64), m_max_frame(2048), m_fd(-1)
+        , m_last_sec(-1), m_count(0), m_dropped(0)
+    {}
+
+    void finalize() {
+        if (m_fd > -1) {
+            try { flush(); } catch (...) {}
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    void connect(const std::string& a_url) throw(badarg_error, io_error);
+    void format_time(time_val a_tv);
+public:
+    static logger_impl_syslog_dgram* create(const char* a_name) {
+        return new logger_impl_syslog_dgram(a_name);
+    }
+
+    virtual ~logger_impl_syslog_dgram() {
+        finalize();
+    }
+
+    const std::string& name() const { return m_name; }
+
+    /// Number of frames dropped because the socket wasn't writable (in the
+    /// non-blocking mode) or the receiver rejected them
+    size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /// Dump all settings to stream
+    std::ostream& dump(std::ostream& out, const std::string& a_prefix) const;
+
+    bool init(const variant_tree& a_config)
+        throw(badarg_error, io_error);
+
+    void log_msg(const logger::msg& a_msg, const char* a_buf, size_t a_size)
+        throw(io_error);
+
+    /// Send the frames of the pending batch
+    void flush() override;
+};
+
+} // namespace utxx
+
+#endif
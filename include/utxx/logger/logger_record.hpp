@@ -0,0 +1,310 @@
+//------------------------------------------------------------------------------
+/// \file   logger_record.hpp
+/// \author agent
+//------------------------------------------------------------------------------
+/// \brief Fixed-size binary record of log arguments with deferred formatting.
+///
+/// The record is filled in the caller's context by copying raw arguments
+/// (integers, doubles, pointers, strings copied inline) into a fixed-size
+/// buffer.  The argument layout is described at
+/// compile time by the instantiation of the decoding function stored in the
+/// record, so that formatting can be performed later in the context of the
+/// logger's thread.
+//------------------------------------------------------------------------------
+// Copyright (C) 2026 agent <agent@local>
+// Created: 2026-10-17
+//------------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <string>
+#include <tuple>
+#include <utility>
+#include <cstring>
+#include <type_traits>
+#include <utxx/config.h>
+#include <utxx/print.hpp>
+#include <utxx/time_val.hpp>
+
+#ifndef UTXX_LOGGER_RECORD_SIZE
+#   define UTXX_LOGGER_RECORD_SIZE 128
+#endif
+
+namespace utxx {
+namespace detail {
+
+    //--------------------------------------------------------------------------
+    /// Encoding of a single argument of type T in a log_record.
+    /// Unsupported types have `supported == false`, in which case the
+    /// message is formatted in the caller's context.  Types that can't be
+    /// passed to printf have `vararg == false`.
+    //--------------------------------------------------------------------------
+    template <class T, class Enable = void>
+    struct log_arg {
+        static constexpr bool   supported  = false;
+        static constexpr bool   vararg     = false;
+        static constexpr size_t fixed_size = 0;
+        using type = T;
+    };
+
+    /// Scalars are copied by value
+    template <class T>
+    struct log_arg<T, typename std::enable_if<
+        std::is_arithmetic<T>::value || std::is_enum<T>::value ||
+        (std::is_pointer<T>::value &&
+         !std::is_same<typename std::remove_cv<
+             typename std::remove_pointer<T>::type>::type, char>::value)
+    >::type> {
+        static constexpr bool   supported  = true;
+        static constexpr bool   vararg     = true;
+        static constexpr size_t fixed_size = sizeof(T);
+        using type = T;
+
+        static void encode(char*& a_pos, const char*, const T& a) {
+            memcpy(a_pos, &a, sizeof(T));
+            a_pos += sizeof(T);
+        }
+
+        static T decode(const char*& a_pos) {
+            T a;
+            memcpy(&a, a_pos, sizeof(T));
+            a_pos += sizeof(T);
+            return a;
+        }
+    };
+
+    /// Strings are copied inline in the form: Len:uint16, Data, '\0'.
+    /// The string is truncated if it doesn't fit in the record.
+    /// Note that character arrays are copied as well, since a string literal
+    /// can't be distinguished from a local array at compile time.
+    struct log_str_arg {
+        static constexpr bool   supported  = true;
+        static constexpr bool   vararg     = true;
+        static constexpr size_t fixed_size = sizeof(uint16_t) + 1;
+        using type = const char*;
+
+        static void encode(char*& a_pos, const char* a_end, const char* a, size_t a_len) {
+            size_t   avail = a_end - a_pos - fixed_size;
+            uint16_t n     = uint16_t(a_len < avail ? a_len : avail);
+            memcpy(a_pos, &n, sizeof(n));
+            a_pos += sizeof(n);
+            memcpy(a_pos, a, n);
+            a_pos += n;
+            *a_pos++ = '\0';
+        }
+
+        static void encode(char*& a_pos, const char* a_end, const char* a) {
+            encode(a_pos, a_end, a ? a : "", a ? strlen(a) : 0);
+        }
+
+        static void encode(char*& a_pos, const char* a_end, const std::string& a) {
+            encode(a_pos, a_end, a.c_str(), a.size());
+        }
+
+        static const char* decode(const char*& a_pos) {
+            uint16_t n;
+            memcpy(&n, a_pos, sizeof(n));
+            const char* p = a_pos + sizeof(n);
+            a_pos = p + n + 1;
+            return p;
+        }
+    };
+
+    /// time_val is copied by value. It can only be printed by logs(), since
+    /// it isn't a valid printf argument.
+    template <>
+    struct log_arg<time_val> {
+        static constexpr bool   supported  = true;
+        static constexpr bool   vararg     = false;
+        static constexpr size_t fixed_size = sizeof(long);
+
+        using type = time_val;
+
+        static void encode(char*& a_pos, const char*, time_val a) {
+            long ns = a.nanoseconds();
+            memcpy(a_pos, &ns, sizeof(ns));
+            a_pos += sizeof(ns);
+        }
+
+        static time_val decode(const char*& a_pos) {
+            long ns;
+            memcpy(&ns, a_pos, sizeof(ns));
+            a_pos += sizeof(ns);
+            return time_val(nsecs(ns));
+        }
+    };
+
+    template <size_t N> struct log_arg<char[N]>     : log_str_arg {};
+    template <>         struct log_arg<char*>       : log_str_arg {};
+    template <>         struct log_arg<const char*> : log_str_arg {};
+    template <>         struct log_arg<std::string> : log_str_arg {};
+
+    /// Map the deduced argument type to the log_arg specialization
+    template <class A>
+    using log_arg_t = log_arg<typename std::remove_cv<
+        typename std::remove_reference<A>::type>::type>;
+
+    /// Copy a printf format string that has no arguments to \a a_buf,
+    /// replacing "%%" with "%" as snprintf() would.
+    /// @return number of bytes written (excluding the terminating '\0')
+    inline int copy_fmt(char* a_buf, size_t a_size, const char* a_fmt) {
+        if (!a_size)
+            return 0;
+        char* p = a_buf;
+        char* e = a_buf + a_size - 1;
+        for (const char* q = a_fmt; *q && p < e; *p++ = *q++)
+            if (*q == '%' && q[1] == '%')
+                ++q;
+        *p = '\0';
+        return p - a_buf;
+    }
+
+    //--------------------------------------------------------------------------
+    /// Fixed-size binary record holding raw arguments of a log message.
+    //--------------------------------------------------------------------------
+    class log_record {
+        using format_fun = int (*)(const log_record&, char*, size_t);
+
+        format_fun  m_format;
+        const char* m_fmt;
+        char        m_data[UTXX_LOGGER_RECORD_SIZE];
+
+        template <class... Args> struct fixed_size;
+
+        template <class... Args>
+        static void do_encode(char*&, const char*) {}
+
+        template <class T, class... Args>
+        static void do_encode(char*& a_pos, const char* a_end, T&& a, Args&&... a_args) {
+            // Reserve the space needed by the remaining arguments, so that
+            // only strings get truncated when the record is full
+            log_arg_t<T>::encode(a_pos, a_end - fixed_size<Args...>::value,
+                                 std::forward<T>(a));
+            do_encode(a_pos, a_end, std::forward<Args>(a_args)...);
+        }
+
+        /// Evaluates to true if all of \a Pred are true
+        template <bool... Pred>
+        using all_of = std::is_same<std::integer_sequence<bool, true, Pred...>,
+                                    std::integer_sequence<bool, Pred..., true>>;
+
+        static int copy(char* a_buf, size_t a_size, const char* a_fmt) {
+            return copy_fmt(a_buf, a_size, a_fmt);
+        }
+        template <class... Args>
+        static int copy(char* a_buf, size_t a_size, const char* a_fmt, Args... a_args) {
+            return snprintf(a_buf, a_size, a_fmt, a_args...);
+        }
+
+        template <class Tuple, size_t... I>
+        static int do_printf(std::true_type, const char* a_fmt, char* a_buf,
+                             size_t a_size, const Tuple& a_args,
+                             std::index_sequence<I...>)
+        {
+            int n = copy(a_buf, a_size, a_fmt, std::get<I>(a_args)...);
+            return n < 0 ? 0 : std::min<int>(n, a_size ? a_size-1 : 0);
+        }
+
+        /// Never called, since logfmt() doesn't defer such arguments
+        template <class Tuple, size_t... I>
+        static int do_printf(std::false_type, const char*, char*, size_t,
+                             const Tuple&, std::index_sequence<I...>)
+        { return 0; }
+
+        template <class VarArgs, class Tuple, size_t... I>
+        static int do_format(VarArgs a_va, const char* a_fmt, char* a_buf,
+                             size_t a_size, const Tuple& a_args,
+                             std::index_sequence<I...> a_idx)
+        {
+            if (a_fmt)
+                return do_printf(a_va, a_fmt, a_buf, a_size, a_args, a_idx);
+            basic_buffered_print<UTXX_LOGGER_RECORD_SIZE*2> buf;
+            buf.print(std::get<I>(a_args)...);
+            auto n = std::min(buf.size(), a_size ? a_size-1 : 0);
+            memcpy(a_buf, buf.str(), n);
+            return int(n);
+        }
+
+        template <class... Args>
+        static int decode(const log_record& a_rec, char* a_buf, size_t a_size) {
+            const char* p = a_rec.m_data;
+            // Braced initialization guarantees left-to-right decoding order
+            std::tuple<typename log_arg_t<Args>::type...> args
+                {log_arg_t<Args>::decode(p)...};
+            (void)p;    // Unused when Args is empty
+            return do_format(all_of<log_arg_t<Args>::vararg...>(),
+                             a_rec.m_fmt, a_buf, a_size, args,
+                             std::index_sequence_for<Args...>());
+        }
+    public:
+        /// Evaluates to true if all arguments can be stored in the record
+        template <class... Args>
+        struct can_defer : std::integral_constant<bool,
+            all_of<log_arg_t<Args>::supported...>::value
+            && fixed_size<Args...>::value <= UTXX_LOGGER_RECORD_SIZE>
+        {};
+
+        /// Evaluates to true if all arguments can be stored in the record
+        /// and formatted with a printf format string
+        template <class... Args>
+        struct can_defer_fmt : std::integral_constant<bool,
+            can_defer<Args...>::value && all_of<log_arg_t<Args>::vararg...>::value>
+        {};
+
+        log_record() : m_format(nullptr), m_fmt(nullptr) {}
+
+        /// Copy the arguments to the record.
+        /// @param a_fmt  printf-like format string that must have static
+        ///               storage duration (if NULL, the arguments are printed
+        ///               using basic_buffered_print)
+        /// @param a_args arguments to store
+        template <class... Args>
+        void encode(const char* a_fmt, Args&&... a_args) {
+            static_assert(can_defer<Args...>::value, "Unsupported argument types!");
+            m_fmt    = a_fmt;
+            m_format = &decode<Args...>;
+            char* p  = m_data;
+            do_encode(p, m_data + sizeof(m_data), std::forward<Args>(a_args)...);
+        }
+
+        /// Format the record into the given buffer.
+        /// @return number of bytes written to \a a_buf (excluding the
+        ///         terminating '\0').  The output is truncated to fit the buffer.
+        int format(char* a_buf, size_t a_size) const {
+            return m_format ? m_format(*this, a_buf, a_size) : 0;
+        }
+
+        const char* fmt() const { return m_fmt; }
+    };
+
+    template <>
+    struct log_record::fixed_size<> : std::integral_constant<size_t, 0> {};
+
+    template <class T, class... Args>
+    struct log_record::fixed_size<T, Args...> : std::integral_constant<size_t,
+        log_arg_t<T>::fixed_size + log_record::fixed_size<Args...>::value> {};
+
+} // namespace detail
+} // namespace utxx
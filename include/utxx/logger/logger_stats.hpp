@@ -0,0 +1,201 @@
+//------------------------------------------------------------------------------
+/// \file   logger_stats.hpp
+/// \author agent
+//------------------------------------------------------------------------------
+/// \brief Latency statistics collected by the logger.
+///
+/// When "logger.latency-stats" is enabled the logger measures the time each
+/// message spends in the queue, the time it takes to format it, and the time
+/// each backend takes to write it. The samples are accumulated in log-linear
+/// histograms.
+//------------------------------------------------------------------------------
+// Copyright (C) 2026 agent <agent@local>
+// Created: 2026-10-17
+//------------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+#include <cstdint>
+#include <utxx/compiler_hints.hpp>
+
+namespace utxx {
+
+//------------------------------------------------------------------------------
+/// Log-linear histogram of latencies in nanoseconds.
+/// Every power of two range is split into 2^SUB_BITS linear buckets, which
+/// bounds the relative error of a reported percentile to 1/2^SUB_BITS.
+/// Samples are added by a single thread, and can be read by any thread.
+//------------------------------------------------------------------------------
+class latency_histogram {
+public:
+    static constexpr int SUB_BITS = 3;
+    static constexpr int SUBS     = 1 << SUB_BITS;
+    static constexpr int BUCKETS  = (64 - SUB_BITS) * SUBS;
+
+    latency_histogram() { reset(); }
+
+    /// Make a snapshot of another histogram
+    latency_histogram(const latency_histogram& a_rhs) { *this = a_rhs; }
+
+    latency_histogram& operator=(const latency_histogram& a_rhs) {
+        for (int i=0; i < BUCKETS; ++i)
+            m_buckets[i].store(a_rhs.m_buckets[i].load(std::memory_order_relaxed),
+                               std::memory_order_relaxed);
+        m_count.store(a_rhs.count(), std::memory_order_relaxed);
+        m_sum  .store(a_rhs.sum(),   std::memory_order_relaxed);
+        m_min  .store(a_rhs.m_min.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+        m_max  .store(a_rhs.max(),   std::memory_order_relaxed);
+        return *this;
+    }
+
+    void reset() {
+        for (auto& b : m_buckets) b.store(0, std::memory_order_relaxed);
+        m_count.store(0,          std::memory_order_relaxed);
+        m_sum  .store(0,          std::memory_order_relaxed);
+        m_min  .store(UINT64_MAX, std::memory_order_relaxed);
+        m_max  .store(0,          std::memory_order_relaxed);
+    }
+
+    /// Add a sample of \a a_ns nanoseconds (negative values count as 0).
+    /// Must only be called by one thread at a time.
+    void add(int64_t a_ns) {
+        uint64_t v = a_ns < 0 ? 0 : uint64_t(a_ns);
+        inc(m_buckets[to_bucket(v)], 1);
+        inc(m_count, 1);
+        inc(m_sum,   v);
+        if (v < m_min.load(std::memory_order_relaxed))
+            m_min.store(v, std::memory_order_relaxed);
+        if (v > m_max.load(std::memory_order_relaxed))
+            m_max.store(v, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    uint64_t sum()   const { return m_sum.load(std::memory_order_relaxed);   }
+    uint64_t max()   const { return m_max.load(std::memory_order_relaxed);   }
+    uint64_t min()   const { return count() ? m_min.load(std::memory_order_relaxed) : 0; }
+    uint64_t mean()  const { auto n = count(); return n ? sum() / n : 0; }
+
+    /// @return number of samples in the bucket \a a_idx
+    uint64_t bucket(int a_idx) const {
+        return m_buckets[a_idx].load(std::memory_order_relaxed);
+    }
+
+    /// @return upper bound of the value at percentile \a a_pcnt (0..100)
+    uint64_t percentile(double a_pcnt) const {
+        auto n = count();
+        if (!n) return 0;
+        auto rank = uint64_t(a_pcnt / 100.0 * double(n) + 0.5);
+        if (rank < 1) rank = 1;
+        uint64_t sum = 0;
+        for (int i=0; i < BUCKETS; ++i) {
+            sum += bucket(i);
+            if (sum >= rank)
+                return std::min(from_bucket(i+1) - 1, max());
+        }
+        return max();
+    }
+
+    /// Bucket index of the value \a a_val
+    static int to_bucket(uint64_t a_val) {
+        if (a_val < SUBS)
+            return int(a_val);
+        int msb   = 63 - __builtin_clzll(a_val);
+        int shift = msb - SUB_BITS;
+        return (shift + 1) * SUBS + int((a_val >> shift) & (SUBS - 1));
+    }
+
+    /// Lowest value that falls in the bucket \a a_idx
+    static uint64_t from_bucket(int a_idx) {
+        if (a_idx < SUBS)
+            return uint64_t(a_idx);
+        if (a_idx >= BUCKETS)
+            return UINT64_MAX;
+        int shift = a_idx / SUBS - 1;
+        return uint64_t(SUBS + a_idx % SUBS) << shift;
+    }
+
+    /// Print summary: count, min/mean/max and percentiles in microseconds
+    std::ostream& dump(std::ostream& out, const char* a_name) const {
+        auto us = [](uint64_t ns) { return double(ns) / 1000.0; };
+        auto f  = out.flags();
+        auto p  = out.precision();
+        out << std::fixed << std::setprecision(3)
+            << a_name << ": count=" << count()
+            << " min="   << us(min())
+            << " mean="  << us(mean())
+            << " p50="   << us(percentile(50.0))
+            << " p90="   << us(percentile(90.0))
+            << " p99="   << us(percentile(99.0))
+            << " p99.9=" << us(percentile(99.9))
+            << " max="   << us(max()) << " us";
+        out.flags(f);
+        out.precision(p);
+        return out;
+    }
+
+private:
+    using counter = std::atomic<uint64_t>;
+
+    // Single writer: a plain load/store pair avoids a locked instruction
+    static void inc(counter& a, uint64_t a_n) {
+        a.store(a.load(std::memory_order_relaxed) + a_n, std::memory_order_relaxed);
+    }
+
+    counter m_buckets[BUCKETS];
+    counter m_count;
+    counter m_sum;
+    counter m_min;
+    counter m_max;
+};
+
+//------------------------------------------------------------------------------
+/// Snapshot of logger's latency statistics returned by logger::stats()
+//------------------------------------------------------------------------------
+struct logger_stats {
+    struct backend {
+        std::string         name;
+        latency_histogram   write;  ///< Time spent in the backend's write
+    };
+
+    latency_histogram       queue;  ///< From enqueue to dequeue by logger's thread
+    latency_histogram       format; ///< From dequeue to formatted message
+    std::vector<backend>    backends;
+
+    std::ostream& dump(std::ostream& out) const {
+        queue .dump(out, "queue")  << '\n';
+        format.dump(out, "format") << '\n';
+        for (auto& b : backends)
+            b.write.dump(out, ("write." + b.name).c_str()) << '\n';
+        return out;
+    }
+};
+
+} // namespace utxx
@@ -0,0 +1,136 @@
+//------------------------------------------------------------------------------
+/// \file   logger_thread.hpp
+/// \author agent
+//------------------------------------------------------------------------------
+/// \brief Registry of cached names of threads that write to the logger.
+///
+/// Each logging thread is assigned a small integer index on its first log
+/// call, and its name is cached in the registry, so that log messages only
+/// need to carry the index.
+//------------------------------------------------------------------------------
+// Copyright (C) 2026 agent <agent@local>
+// Created: 2026-10-17
+//------------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <utxx/compiler_hints.hpp>
+
+#ifndef UTXX_LOG_MAX_THREADS
+#   define UTXX_LOG_MAX_THREADS 4096
+#endif
+
+namespace utxx {
+
+//------------------------------------------------------------------------------
+/// Registry of cached thread names.
+/// A thread is registered on its first call to current() and is retired
+/// when it exits. Its index is only reused by another thread after the
+/// logger has written all messages queued before the thread exited (see
+/// reclaim()), so that they are not printed under the new thread's name.
+/// Index 0 is reserved for threads that couldn't be registered because the
+/// registry is full (their name is empty).
+//------------------------------------------------------------------------------
+class log_threads {
+public:
+    static constexpr size_t s_max_threads  = UTXX_LOG_MAX_THREADS;
+    static constexpr size_t s_max_name_len = 16;
+
+    static log_threads& instance() {
+        static log_threads s_instance;
+        return s_instance;
+    }
+
+    /// @return index of the calling thread (registers it on first call)
+    static uint16_t current() {
+        static thread_local slot_ref t_ref;
+        if (UNLIKELY(!t_ref.m_idx))
+            t_ref.m_idx = instance().attach();
+        return t_ref.m_idx;
+    }
+
+    /// Refresh the cached name of the calling thread.
+    /// Call this after renaming the thread with pthread_setname_np().
+    static void refresh() { instance().update(current()); }
+
+    /// Set the name of the calling thread and refresh its cached copy
+    static void set_name(const char* a_name);
+
+    /// Copy the cached name of a thread given its index to \a a_buf.
+    /// The name may be concurrently updated by its thread.
+    /// @return \a a_buf containing a NULL-terminated name (empty if unknown)
+    const char* name(uint16_t a_idx, char (&a_buf)[s_max_name_len]) const;
+
+    /// @return number of indices ever allocated (including the reserved one)
+    size_t size() const { return m_count.load(std::memory_order_acquire); }
+
+    /// @return number of threads retired so far. Pass it to reclaim() once
+    ///         all messages queued before this call have been written.
+    size_t retired() const { return m_retired_count.load(std::memory_order_acquire); }
+
+    /// Make indices of the first \a a_retired retired threads reusable
+    void reclaim(size_t a_retired) {
+        if (a_retired > m_reclaimed_count.load(std::memory_order_relaxed))
+            do_reclaim(a_retired);
+    }
+
+private:
+    /// Releases the index of a thread on thread exit
+    struct slot_ref {
+        uint16_t m_idx = 0;
+        ~slot_ref() { if (m_idx) instance().detach(m_idx); }
+    };
+
+    static constexpr size_t s_name_words = s_max_name_len / sizeof(uint64_t);
+
+    /// Thread name guarded by a sequence lock. It's only written by the
+    /// thread that owns the slot.
+    struct slot {
+        std::atomic<uint32_t> version;
+        std::atomic<uint64_t> name[s_name_words];
+    };
+
+    slot                    m_slots[s_max_threads];
+    std::atomic<size_t>     m_count;
+    std::vector<uint16_t>   m_free;
+    std::deque<uint16_t>    m_retired;
+    std::atomic<size_t>     m_retired_count;
+    std::atomic<size_t>     m_reclaimed_count;
+    std::mutex              m_mutex;
+
+    log_threads();
+
+    uint16_t attach();
+    void     detach(uint16_t a_idx);
+    void     update(uint16_t a_idx);
+    void     do_reclaim(size_t a_retired);
+};
+
+} // namespace utxx
@@ -0,0 +1,417 @@
+//----------------------------------------------------------------------------
+/// \file  mmap_log_ring.hpp
+//----------------------------------------------------------------------------
+/// \brief Circular log of records in a memory-mapped file.
+///
+/// The file begins with a page-sized header holding the byte sequence
+/// numbers of the oldest record (tail) and of the end of the last complete
+/// record (head), followed by the data area whose size is a power of two.
+/// Records are written by a single process with memcpy, so the last
+/// "capacity" bytes written to the ring survive a crash of the writing
+/// process and can be read by a concurrent or a post-mortem reader.
+///
+/// Record layout (8-byte aligned, may wrap around the end of the data area):
+/// \verbatim
+///     uint32_t length | char data[length] | padding
+/// \endverbatim
+//----------------------------------------------------------------------------
+// Copyright (c) 2026 agent <agent@local>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <string>
+#include <cstdint>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/noncopyable.hpp>
+#include <utxx/atomic.hpp>
+
+namespace utxx {
+
+/// Memory-mapped ring of log records
+///
+/// Only one process may write the ring at a time, which is enforced by an
+/// exclusive flock(2) taken by create(). Writes by threads of that process
+/// are serialized by a spin lock. Any number of readers may tail the ring
+/// concurrently with the writer.
+class mmap_log_ring : private boost::noncopyable {
+public:
+    struct header {
+        static const uint32_t s_magic   = 0x474f4c52;   // "RLOG"
+        static const uint32_t s_version = 1;
+
+        uint32_t              magic;
+        uint32_t              version;
+        uint64_t              capacity;     // Size of the data area
+        uint64_t              data_offset;  // Offset of the data area in file
+        std::atomic<uint64_t> head;         // End of the last complete record
+        std::atomic<uint64_t> tail;         // Start of the oldest record
+    };
+
+    static constexpr size_t s_align    = 8;
+    static constexpr size_t s_hdr_size = sizeof(uint32_t);
+
+    mmap_log_ring() : m_fd(-1), m_base(nullptr), m_size(0), m_hdr(nullptr)
+                    , m_data(nullptr), m_mask(0), m_pos(0), m_lost(0)
+                    , m_busy(false) {}
+    ~mmap_log_ring() { close(); }
+
+    /// Open the ring file \a a_filename for writing, creating it if needed.
+    /// An existing ring of the same capacity is continued, so that records
+    /// of a previous run remain available, unless \a a_reset is true.
+    /// @param a_capacity size of the data area (rounded up to a power of 2)
+    /// @return 0 on success or -1 on error, in which case errno is set
+    ///         (EWOULDBLOCK if another writer has the ring open)
+    int create(const std::string& a_filename, size_t a_capacity,
+               bool a_reset = false, int a_mode = S_IRUSR | S_IWUSR | S_IRGRP);
+
+    /// Open an existing ring file \a a_filename for reading. The read
+    /// position is set to the oldest record.
+    /// @return 0 on success or -1 on error, in which case errno is set
+    int open(const std::string& a_filename);
+
+    void close();
+
+    bool            is_open()  const { return m_hdr != nullptr;    }
+    size_t          capacity() const { return m_mask + 1;          }
+    const header*   hdr()      const { return m_hdr;               }
+    uint64_t        head()     const { return m_hdr->head.load(std::memory_order_acquire); }
+    uint64_t        tail()     const { return m_hdr->tail.load(std::memory_order_acquire); }
+
+    /// Max length of a record. Longer records are truncated.
+    size_t max_record_size() const { return capacity() / 2 - s_hdr_size; }
+
+    /// Append a record evicting the oldest records to make room for it.
+    /// This call doesn't involve any system calls.
+    void write(const char* a_data, size_t a_size);
+
+    /// Same as write(), but waits at most \a a_spins iterations for another
+    /// thread's write() to finish, and then writes anyway. To be used by
+    /// signal handlers, which may have interrupted a thread in write(): the
+    /// record it was writing is then overwritten. Async-signal-safe.
+    void write(const char* a_data, size_t a_size, size_t a_spins);
+
+    //------------------------------------------------------------------------
+    // Reader interface
+    //------------------------------------------------------------------------
+
+    /// Read the next record into \a a_rec.
+    /// @return true if a record was read, false if there are no new records
+    bool read(std::string& a_rec);
+
+    /// Set the read position to the start of the \a a_n newest records
+    void seek_last(size_t a_n);
+
+    /// Number of bytes overwritten by the writer before they could be read
+    uint64_t lost() const { return m_lost; }
+
+private:
+    int       m_fd;
+    char*     m_base;
+    size_t    m_size;
+    header*   m_hdr;
+    char*     m_data;
+    uint64_t  m_mask;
+    uint64_t  m_pos;    // Read position
+    uint64_t  m_lost;
+    std::atomic<bool> m_busy;   // Writer's lock
+
+    static uint64_t align(uint64_t a) { return (a + s_align - 1) & ~(s_align - 1); }
+    static size_t   page_size()       { return ::sysconf(_SC_PAGESIZE); }
+
+    uint64_t rec_len(uint64_t a_seq) const {
+        uint32_t n;
+        memcpy(&n, m_data + (a_seq & m_mask), sizeof(n));
+        return n;
+    }
+
+    void do_write(const char* a_data, size_t a_size);
+    void copy_in(uint64_t a_seq, const char* a_src, size_t a_sz);
+    void copy_out(uint64_t a_seq, char* a_dst, size_t a_sz) const;
+    int  map(int a_prot);
+    int  fail();
+};
+
+//----------------------------------------------------------------------------
+// Implementation
+//----------------------------------------------------------------------------
+
+inline int mmap_log_ring::
+create(const std::string& a_filename, size_t a_capacity, bool a_reset, int a_mode)
+{
+    if (is_open()) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    uint64_t cap = 4096;
+    while (cap < a_capacity)
+        cap <<= 1;
+
+    m_fd = ::open(a_filename.c_str(), O_RDWR | O_CREAT, a_mode);
+    if (m_fd < 0)
+        return -1;
+
+    // Lock the file before possibly truncating the ring of another writer.
+    // The lock is released when the descriptor is closed.
+    if (::flock(m_fd, LOCK_EX | LOCK_NB) < 0)
+        return fail();
+
+    size_t  hsz = std::max<size_t>(page_size(), sizeof(header));
+    m_size = hsz + cap;
+
+    struct stat st;
+    if (::fstat(m_fd, &st) < 0)
+        return fail();
+
+    // Continue an existing ring only if its layout matches
+    bool reuse = !a_reset && size_t(st.st_size) == m_size;
+    if (!reuse && ::ftruncate(m_fd, 0) < 0)
+        return fail();
+    if (::ftruncate(m_fd, m_size) < 0)
+        return fail();
+    if (map(PROT_READ | PROT_WRITE) < 0)
+        return fail();
+
+    if (reuse && (m_hdr->magic   != header::s_magic   ||
+                  m_hdr->version != header::s_version ||
+                  m_hdr->capacity != cap || m_hdr->data_offset != hsz ||
+                  m_hdr->head.load() - m_hdr->tail.load() > cap))
+        reuse = false;
+
+    if (!reuse) {
+        m_hdr->magic       = header::s_magic;
+        m_hdr->version     = header::s_version;
+        m_hdr->capacity    = cap;
+        m_hdr->data_offset = hsz;
+        m_hdr->head.store(0, std::memory_order_relaxed);
+        m_hdr->tail.store(0, std::memory_order_release);
+    }
+
+    m_data = m_base + hsz;
+    m_mask = cap - 1;
+    m_pos  = m_hdr->head.load(std::memory_order_relaxed);
+    return 0;
+}
+
+inline int mmap_log_ring::
+open(const std::string& a_filename)
+{
+    if (is_open()) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    m_fd = ::open(a_filename.c_str(), O_RDONLY);
+    if (m_fd < 0)
+        return -1;
+
+    struct stat st;
+    if (::fstat(m_fd, &st) < 0)
+        return fail();
+    if (size_t(st.st_size) < sizeof(header)) {
+        errno = EINVAL;
+        return fail();
+    }
+
+    m_size = st.st_size;
+    if (map(PROT_READ) < 0)
+        return fail();
+
+    uint64_t cap = m_hdr->capacity;
+    if (m_hdr->magic != header::s_magic || m_hdr->version != header::s_version ||
+        !cap || (cap & (cap - 1)) || m_hdr->data_offset + cap != m_size) {
+        errno = EINVAL;
+        return fail();
+    }
+
+    m_data = m_base + m_hdr->data_offset;
+    m_mask = cap - 1;
+    m_pos  = tail();
+    m_lost = 0;
+    return 0;
+}
+
+inline void mmap_log_ring::
+close()
+{
+    if (m_base)
+        ::munmap(m_base, m_size);
+    if (m_fd >= 0)
+        ::close(m_fd);
+    m_fd   = -1;
+    m_base = nullptr;
+    m_hdr  = nullptr;
+    m_data = nullptr;
+    m_mask = 0;
+}
+
+inline void mmap_log_ring::
+write(const char* a_data, size_t a_size)
+{
+    while (m_busy.exchange(true, std::memory_order_acquire))
+        while (m_busy.load(std::memory_order_relaxed))
+            atomic::cpu_relax();
+    do_write(a_data, a_size);
+    m_busy.store(false, std::memory_order_release);
+}
+
+inline void mmap_log_ring::
+write(const char* a_data, size_t a_size, size_t a_spins)
+{
+    bool locked;
+    while (!(locked = !m_busy.exchange(true, std::memory_order_acquire)) && a_spins--)
+        atomic::cpu_relax();
+    do_write(a_data, a_size);
+    if (locked)
+        m_busy.store(false, std::memory_order_release);
+}
+
+inline void mmap_log_ring::
+do_write(const char* a_data, size_t a_size)
+{
+    if (a_size > max_record_size())
+        a_size = max_record_size();
+
+    uint64_t head = m_hdr->head.load(std::memory_order_relaxed);
+    uint64_t tail = m_hdr->tail.load(std::memory_order_relaxed);
+    uint64_t need = align(s_hdr_size + a_size);
+
+    // Evict the oldest records. The new tail is published before their
+    // space is overwritten, so that readers can detect the overrun.
+    if (head + need - tail > capacity()) {
+        while (head + need - tail > capacity())
+            tail += align(s_hdr_size + rec_len(tail));
+        m_hdr->tail.store(tail, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    uint32_t n = a_size;
+    copy_in(head, reinterpret_cast<const char*>(&n), s_hdr_size);
+    copy_in(head + s_hdr_size, a_data, a_size);
+
+    m_hdr->head.store(head + need, std::memory_order_release);
+}
+
+inline bool mmap_log_ring::
+read(std::string& a_rec)
+{
+    while (true) {
+        if (m_pos == head())
+            return false;
+
+        uint64_t tail = this->tail();
+        if (m_pos < tail) {
+            m_lost += tail - m_pos;
+            m_pos   = tail;
+            continue;
+        }
+
+        uint64_t n = rec_len(m_pos);
+        if (n <= max_record_size()) {
+            a_rec.resize(n);
+            copy_out(m_pos + s_hdr_size, &a_rec[0], n);
+        }
+
+        // The record is valid only if it wasn't evicted while being copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_hdr->tail.load(std::memory_order_relaxed) > m_pos)
+            continue;
+
+        m_pos += align(s_hdr_size + n);
+        return true;
+    }
+}
+
+inline void mmap_log_ring::
+seek_last(size_t a_n)
+{
+    // Records can only be traversed forward, so find the start of the
+    // a_n newest records in two passes. Retry if the writer evicted
+    // records being traversed.
+    uint64_t tail, pos;
+    do {
+        uint64_t head = this->head();
+        size_t   cnt  = 0;
+        tail = pos = this->tail();
+        for (uint64_t p = pos; p < head; p += align(s_hdr_size + rec_len(p)))
+            ++cnt;
+        for (; cnt > a_n && pos < head; --cnt)
+            pos += align(s_hdr_size + rec_len(pos));
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while (m_hdr->tail.load(std::memory_order_relaxed) != tail);
+    m_pos = pos;
+}
+
+inline void mmap_log_ring::
+copy_in(uint64_t a_seq, const char* a_src, size_t a_sz)
+{
+    size_t off = a_seq & m_mask;
+    size_t n   = std::min<size_t>(a_sz, capacity() - off);
+    memcpy(m_data + off, a_src, n);
+    if (n < a_sz)
+        memcpy(m_data, a_src + n, a_sz - n);
+}
+
+inline void mmap_log_ring::
+copy_out(uint64_t a_seq, char* a_dst, size_t a_sz) const
+{
+    size_t off = a_seq & m_mask;
+    size_t n   = std::min<size_t>(a_sz, capacity() - off);
+    memcpy(a_dst, m_data + off, n);
+    if (n < a_sz)
+        memcpy(a_dst + n, m_data, a_sz - n);
+}
+
+inline int mmap_log_ring::
+map(int a_prot)
+{
+    void* p = ::mmap(nullptr, m_size, a_prot, MAP_SHARED, m_fd, 0);
+    if (p == MAP_FAILED)
+        return -1;
+    m_base = static_cast<char*>(p);
+    m_hdr  = reinterpret_cast<header*>(m_base);
+    return 0;
+}
+
+inline int mmap_log_ring::
+fail()
+{
+    int e = errno;
+    close();
+    errno = e;
+    return -1;
+}
+
+} // namespace utxx
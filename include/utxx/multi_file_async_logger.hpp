@@ -44,6 +44,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/compiler_hints.hpp>
 #include <utxx/time_val.hpp>
 #include <utxx/logger.hpp>
+#include <utxx/io_uring.hpp>
+#include <utxx/direct_file_writer.hpp>
 #include <iostream>
 #include <memory>
 #include <atomic>
@@ -59,6 +61,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <sys/uio.h>
 #include <fcntl.h>
 #include <sched.h>
+#include <pthread.h>
 
 #ifdef PERF_STATS
 #include <utxx/perf_histogram.hpp>
@@ -131,36 +134,83 @@ struct basic_multi_file_async_logger {
     using close_event_type     = synch::posix_event;
     using close_event_type_ptr = std::shared_ptr<close_event_type>;
 
-private:
-    struct stream_info_eq {
-        bool operator()(const stream_info* a, const stream_info* b) { return a == b; }
-    };
-    struct stream_info_lt {
-        bool operator()(const stream_info* a, const stream_info* b) { return a < b; }
+    /// Priority class of a stream. On every pass of a writer thread the
+    /// streams of a higher class are written before those of a lower class.
+    enum stream_priority {
+        PRIORITY_HIGH,
+        PRIORITY_NORMAL,
+        PRIORITY_LOW,
+        PRIORITY_COUNT
     };
 
+private:
     using cmd_allocator = typename traits::fixed_size_allocator::template
         rebind<command_t>::other;
-    using ptr_allocator = typename traits::fixed_size_allocator::template
-        rebind<stream_info*>::other;
-
-    using pending_data_streams_set = std::set<stream_info*, stream_info_lt, ptr_allocator>;
 
     using stream_info_vec = std::vector<stream_info*>;
 
+#ifdef UTXX_HAVE_IO_URING_H
+    /// Batch of messages of one stream submitted to io_uring
+    struct uring_write {
+        stream_info*        stream;
+        command_t*          cmds;   // NULL-terminated list of written commands
+        std::vector<iovec>  iov;
+        size_t              first;  // First iovec not yet fully written
+
+        // Account for \a a_bytes written. Return true if nothing is left.
+        bool advance(size_t a_bytes);
+    };
+#endif
+
+    /// Writer thread with its own command queue serving a subset of streams
+    struct shard {
+        size_t                          index;
+        std::shared_ptr<std::thread>    thread;
+        std::atomic<command_t*>         head;
+        event_type                      event;
+        stream_info*                    dirty[PRIORITY_COUNT]; // Streams with pending data
+        // Number of streams left with pending data after a pass
+        int                             backlog;
+        int                             cpu;            // Pinned CPU or -1
+        int                             max_queue_size;
+        bool                            started;        // Guarded by m_mutex
+#ifdef UTXX_HAVE_IO_URING_H
+        io_uring_queue                  uring;
+#endif
+
+        explicit shard(size_t a_index)
+            : index(a_index), head(nullptr), event(0), dirty{}, backlog(0)
+            , cpu(-1), max_queue_size(0), started(false)
+        {}
+
+        /// Add the stream to the intrusive list of streams with pending data
+        void mark_dirty(stream_info* a_si) {
+            if (a_si->m_dirty)
+                return;
+            a_si->m_dirty      = true;
+            a_si->m_next_dirty = dirty[a_si->priority];
+            dirty[a_si->priority] = a_si;
+        }
+
+        /// Revisit the stream on the next pass
+        void defer(stream_info* a_si) {
+            ++backlog;
+            mark_dirty(a_si);
+        }
+    };
+
+    using shard_vec = std::vector<std::unique_ptr<shard>>;
+
     std::mutex                                      m_mutex;
     std::condition_variable                         m_cond_var;
-    std::shared_ptr<std::thread>                    m_thread;
     cmd_allocator                                   m_cmd_allocator;
     msg_allocator                                   m_msg_allocator;
-    std::atomic<command_t*>                         m_head;
+    shard_vec                                       m_shards;
+    size_t                                          m_next_shard;
     std::atomic<bool>                               m_cancel;
-    int                                             m_max_queue_size;
     std::atomic<long>                               m_total_msgs_processed;
-    event_type                                      m_event;
     std::atomic<long>                               m_active_count;
     stream_info_vec                                 m_files;
-    pending_data_streams_set                        m_pending_data_streams;
     int                                             m_last_version;
     double                                          m_reconnect_sec;
     err_handler                                     m_err_handler;
@@ -169,6 +219,12 @@ private:
     std::atomic<size_t>                             m_stats_enque_spins;
     std::atomic<size_t>                             m_stats_deque_spins;
 #endif
+#ifdef UTXX_HAVE_IO_URING_H
+    bool uring_submit(shard& a_shard, stream_info* a_si);
+    int  uring_reap(shard& a_shard);
+#endif
+    // Write out all pending data of the shard's streams
+    void drain(shard& a_shard);
 
     // Default output writer
     static int writev(stream_info& a_si, const char** a_categories,
@@ -184,16 +240,20 @@ private:
     bool internal_update_stream(stream_info* a_si, int a_fd);
 
     // Invoked by the async thread to flush messages from queue to file
-    int  commit(const struct timespec* tsp = NULL);
+    int  commit(shard& a_shard, const struct timespec* tsp = NULL);
+    // Write commands pending in the streams' queues
+    void write_pending_streams(shard& a_shard);
+    // Write commands pending in the stream's queue
+    void write_stream(shard& a_shard, stream_info* a_si);
     // Invoked by the async thread
-    void run();
+    void run(shard& a_shard);
     // Enqueues msg to internal queue
     int  internal_enqueue(command_t* a_cmd, const stream_info* a_si);
     // Writes data to internal queue
     int  internal_write(const file_id& a_id, const char* a_cat, size_t a_cat_sz,
                         char* a_data, size_t a_sz, bool copied);
 
-    void internal_close();
+    void internal_close(shard& a_shard);
     void internal_close(stream_info* p, int a_errno = 0);
 
     command_t* allocate_message(const stream_info* a_si,
@@ -250,8 +310,35 @@ public:
     /// Stop asynchronous file writing thread
     void stop();
 
-    /// Returns true if the async logger's thread is running
-    bool running() { return m_thread.get(); }
+    /// Returns true if the async logger's threads are running
+    bool running() const {
+        for (auto& sh : m_shards)
+            if (sh->thread) return true;
+        return false;
+    }
+
+    /// Set the number of writer threads.
+    ///
+    /// Each writer thread has its own command queue and writes a subset of
+    /// streams. Streams are assigned to threads round-robin in the order they
+    /// are opened unless overriden by set_shard(). Call this function before
+    /// start() and before opening any files.
+    /// @return 0 on success or -1 if the logger is running or has open files
+    int  set_shards(size_t a_count);
+
+    /// @return number of writer threads
+    size_t shards() const { return m_shards.size(); }
+
+    /// Assign the stream \a a_id to the writer thread number \a a_shard.
+    /// Call this function immediately after calling open_file() and before
+    /// writing any messages to it: commands already queued to the previous
+    /// writer thread are not moved to the new one.
+    /// @return 0 on success or -1 if commands were queued for the stream
+    int  set_shard(file_id& a_id, size_t a_shard);
+
+    /// Pin the writer thread number \a a_shard to CPU \a a_cpu
+    /// (-1 means no pinning). Call this function before start().
+    void set_shard_cpu(size_t a_shard, int a_cpu);
 
     /// Start a new log file
     /// @param a_filename is the name of the output file
@@ -272,6 +359,25 @@ public:
         int                a_mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP
     );
 
+    /// Start a new log file written with O_DIRECT
+    ///
+    /// Messages are staged in a block-aligned buffer, and written to disk
+    /// bypassing the page cache when the buffer is full. The remaining data
+    /// is written when the file is closed.
+    /// @param a_filename is the name of the output file
+    /// @param a_append   if true the file is open in append mode
+    /// @param a_mode     file permission mode (default 660)
+    /// @param a_buf_sz   size of the staging buffer
+    /// @param a_prealloc size of file extents preallocated with fallocate(2)
+    file_id open_direct_file
+    (
+        const std::string& a_filename,
+        bool               a_append   = true,
+        int                a_mode     = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP,
+        size_t             a_buf_sz   = 1024 * 1024,
+        size_t             a_prealloc = 64 * 1024 * 1024
+    );
+
     /// Start a new logging stream
     ///
     /// The logger won't write any data to file but will call \a a_writer
@@ -330,11 +436,36 @@ public:
     /// Set a callback for reconnecting to stream
     void set_reconnect(file_id& a_id, stream_reconnecter a_reconnector);
 
+    /// Set the priority class of a stream and its byte budget.
+    ///
+    /// Streams with a non-zero \a a_quantum are scheduled with deficit
+    /// round-robin: on every pass of the writer thread a stream earns
+    /// \a a_quantum bytes of credit and writes messages as long as the
+    /// credit lasts. The remaining messages are written on subsequent passes,
+    /// after the streams of higher priority classes. Call this function
+    /// immediately after calling open_file() and before writing any messages
+    /// to it.
+    /// @param a_prio    priority class of the stream
+    /// @param a_quantum max number of bytes written per pass (0 - unlimited)
+    void set_priority(file_id& a_id, stream_priority a_prio, size_t a_quantum = 0);
+
     /// Enable usage of sched_yield() instead of usleep() in the logging thread.
     /// Occasionally when running processing thread on max priority the use of
     /// sched_yield() can cause system resource starvation.
     void use_sched_yield(bool a_enable) { m_use_sched_yield = a_enable; }
 
+    /// Write files through io_uring instead of a blocking writev(2).
+    ///
+    /// Batches of all streams with pending data are submitted to the kernel
+    /// in one system call, so that a stalled write to one file doesn't delay
+    /// writes to other files. Only streams using the default writer are
+    /// written this way. Each writer thread has its own ring. Call this
+    /// function after set_shards() and before start().
+    /// @param a_queue_depth is the size of the io_uring submission queue
+    /// @return 0 on success or -errno if io_uring is not available, in
+    ///         which case the logger keeps using writev(2)
+    int use_io_uring(unsigned a_queue_depth = 256);
+
     /// Close one log file
     /// @param a_id identifier of the file to be closed. After return the value
     ///             will be reset.
@@ -416,17 +547,26 @@ public:
     int write(const file_id& a_id, const char*        a_category, const std::string& a_msg);
 
     /// @return max size of the commit queue
-    const int   max_queue_size()        const { return m_max_queue_size; }
+    const int   max_queue_size()        const {
+        int n = 0;
+        for (auto& sh : m_shards) n = std::max(n, sh->max_queue_size);
+        return n;
+    }
     const long  total_msgs_processed()  const { return m_total_msgs_processed
                                                 .load(std::memory_order_relaxed); }
     const int   open_files_count()      const { return m_active_count
                                                 .load(std::memory_order_relaxed); }
-    /// Signaling event that can be used to wake up the logging I/O thread
-    const event_type& event()           const { return m_event; }
+    /// Signaling event that can be used to wake up a logging I/O thread
+    const event_type& event(size_t a_shard = 0) const {
+        return m_shards[a_shard]->event;
+    }
 
-    /// True when the logger has unprocessed data in its queue
-    bool  has_pending_data()            const { return m_head
-                                                .load(std::memory_order_relaxed); }
+    /// True when the logger has unprocessed data in its queues
+    bool  has_pending_data()            const {
+        for (auto& sh : m_shards)
+            if (sh->head.load(std::memory_order_relaxed)) return true;
+        return false;
+    }
 #ifdef PERF_STATS
     size_t stats_enque_spins()           const { return m_stats_enque_spins
                                                 .load(std::memory_order_relaxed); }
@@ -535,6 +675,15 @@ template<typename traits>
 class basic_multi_file_async_logger<traits>::
 stream_info {
     basic_multi_file_async_logger<traits>*  m_logger;
+    // Writer thread serving this stream
+    shard*                                  m_shard;
+    // Set once a command for this stream was queued to m_shard
+    mutable std::atomic<bool>               m_enqueued;
+    // Next stream in the shard's list of streams with pending data
+    stream_info*                            m_next_dirty;
+    bool                                    m_dirty;
+    // Unused byte credit of deficit round-robin scheduling
+    size_t                                  m_deficit;
     // This transient list stores commands that are to be written
     // to the stream represented by this stream_info structure
     command_t*                              m_pending_writes_head;
@@ -546,6 +695,11 @@ stream_info {
     msg_formatter                           on_format;     // "before-write" formatter
     msg_writer                              on_write;      // Message writer functor
     stream_reconnecter                      on_reconnect;  // Stream reconnecter
+#ifdef UTXX_HAVE_IO_URING_H
+    bool                                    m_in_flight;   // io_uring write pending
+#endif
+    // Staging buffer of a file open with O_DIRECT
+    std::unique_ptr<direct_file_writer>     m_direct;
 
     template <typename T> friend struct basic_multi_file_async_logger;
 
@@ -557,6 +711,8 @@ public:
     int                  version;       // Version number assigned when file is opened.
     size_t               max_batch_sz;  // Max number of messages to be batched
     stream_state_base*   state;
+    stream_priority      priority;      // Priority class of the stream
+    size_t               quantum;       // Byte budget per pass (0 - unlimited)
 
     explicit stream_info(stream_state_base* a_state = NULL);
 
@@ -576,9 +732,9 @@ public:
 
     void set_error(int a_errno, const char* a_err = NULL);
 
-    /// Push a list of commands to the internal pending queue in reverse order
+    /// Append a list of commands to the internal pending queue
     ///
-    /// The commands are pushed as long as they are destined to this stream.
+    /// The commands are appended in order as long as they are destined to this stream.
     /// This method is not thread-safe, it's meant for internal use.
     /// @return number of commands enqueued. Upon return \a a_cmd is updated
     ///         with the first command not belonging to this stream or NULL if no
@@ -611,11 +767,16 @@ template<typename traits>
 basic_multi_file_async_logger<traits>::
 stream_info::stream_info(stream_state_base* a_state)
     : m_logger(NULL)
+    , m_shard(NULL), m_enqueued(false)
+    , m_next_dirty(NULL), m_dirty(false), m_deficit(0)
     , m_pending_writes_head(NULL), m_pending_writes_tail(NULL)
     , on_format(&stream_info::def_on_format)
     , on_write(&basic_multi_file_async_logger<traits>::writev)
+#ifdef UTXX_HAVE_IO_URING_H
+    , m_in_flight(false)
+#endif
     , fd(-1), error(0), version(0), max_batch_sz(IOV_MAX)
-    , state(a_state)
+    , state(a_state), priority(PRIORITY_NORMAL), quantum(0)
 {}
 
 template<typename traits>
@@ -626,12 +787,17 @@ stream_info::stream_info(
     msg_writer a_writer,
     stream_state_base* a_state
 )   : m_logger(a_logger)
+    , m_shard(NULL), m_enqueued(false)
+    , m_next_dirty(NULL), m_dirty(false), m_deficit(0)
     , m_pending_writes_head(NULL), m_pending_writes_tail(NULL)
     , on_format(&stream_info::def_on_format)
     , on_write(a_writer)
+#ifdef UTXX_HAVE_IO_URING_H
+    , m_in_flight(false)
+#endif
     , name(a_name), fd(a_fd), error(0)
     , version(a_version), max_batch_sz(IOV_MAX)
-    , state(a_state)
+    , state(a_state), priority(PRIORITY_NORMAL), quantum(0)
 {}
 
 template<typename traits>
@@ -643,7 +809,12 @@ stream_info::reset(int a_errno) {
     if (a_errno >= 0)
         set_error(a_errno, NULL);
 
-    if (fd != -1) {
+    if (m_direct) {
+        // Write out the staged data, and close the file descriptor
+        (void)m_direct->close();
+        m_direct.reset();
+        fd = -1;
+    } else if (fd != -1) {
         (void)::close(fd);
         fd = -1;
     }
@@ -683,13 +854,11 @@ template<typename traits>
 int basic_multi_file_async_logger<traits>::
 stream_info::push(const command_t*& a_cmd) {
     int n = 0;
-    // Reverse the list
-    command_t* p = const_cast<command_t*>(a_cmd), *last = NULL;
+    command_t* first = const_cast<command_t*>(a_cmd), *p = first, *last = NULL;
     for (; p && p->stream == this; ++n) {
-        p->prev = p->next;
-        p->next = last;
+        p->prev = last;
         last    = p;
-        p       = p->prev; // Former p->next
+        p       = p->next;
 
         UTXX_ASYNC_TRACE(("  FD[%d]: caching cmd (tp=%s) %p (prev=%p, next=%p)\n",
                         fd, last->type_str(), last, last->prev, last->next));
@@ -698,15 +867,16 @@ stream_info::push(const command_t*& a_cmd) {
     if (!last)
         return 0;
 
-    last->prev = m_pending_writes_tail;
+    last->next  = NULL;
+    first->prev = m_pending_writes_tail;
 
     if (!m_pending_writes_head)
-        m_pending_writes_head = last;
+        m_pending_writes_head = first;
 
     if (m_pending_writes_tail)
-        m_pending_writes_tail->next = last;
+        m_pending_writes_tail->next = first;
 
-    m_pending_writes_tail = const_cast<command_t*>(a_cmd);
+    m_pending_writes_tail = last;
 
     UTXX_ASYNC_TRACE(("  FD=%d cache head=%p tail=%p\n", fd,
                     m_pending_writes_head, m_pending_writes_tail));
@@ -748,13 +918,10 @@ template<typename traits>
 basic_multi_file_async_logger<traits>::
 basic_multi_file_async_logger(
     size_t a_max_files, int a_reconnect_msec, const msg_allocator& alloc)
-    : m_thread(nullptr)
-    , m_msg_allocator(alloc)
-    , m_head(nullptr)
+    : m_msg_allocator(alloc)
+    , m_next_shard(0)
     , m_cancel(false)
-    , m_max_queue_size(0)
     , m_total_msgs_processed(0)
-    , m_event(0)
     , m_active_count(0)
     , m_files(a_max_files, nullptr)
     , m_last_version(0)
@@ -764,7 +931,9 @@ basic_multi_file_async_logger(
     , m_stats_enque_spins(0)
     , m_stats_deque_spins(0)
 #endif
-{}
+{
+    m_shards.emplace_back(new shard(0));
+}
 
 template<typename traits>
 inline int basic_multi_file_async_logger<traits>::
@@ -773,7 +942,9 @@ writev(stream_info& a_si, const char** a_categories, const iovec* a_iovec, size_
 #ifdef PERF_NO_WRITEV
     return a_sz;
 #else
-    return a_si.fd < 0 ? 0 : ::writev(a_si.fd, a_iovec, a_sz);
+    return a_si.fd < 0 ? 0
+         : a_si.m_direct ? a_si.m_direct->writev(a_iovec, a_sz)
+         : ::writev(a_si.fd, a_iovec, a_sz);
 #endif
 }
 
@@ -791,15 +962,20 @@ start(bool a_block_signals) {
         pthread_sigmask(SIG_SETMASK, &set, nullptr);
     }
 
-    m_event.reset();
     m_cancel = false;
+    m_total_msgs_processed = 0;
 
-    m_thread.reset(
-        new std::thread(
-            std::bind(&basic_multi_file_async_logger<traits>::run, this))
-    );
+    for (auto& sh : m_shards) {
+        sh->event.reset();
+        sh->started = false;
+        sh->thread.reset(
+            new std::thread(
+                std::bind(&basic_multi_file_async_logger<traits>::run, this,
+                          std::ref(*sh)))
+        );
 
-    m_cond_var.wait(lock);
+        m_cond_var.wait(lock, [&sh]() { return sh->started; });
+    }
 
     return 0;
 }
@@ -810,46 +986,59 @@ stop() {
     if (!running())
         return;
 
-    UTXX_ASYNC_TRACE((">>> Stopping async logger (head %p)\n", m_head.load()));
+    UTXX_ASYNC_TRACE((">>> Stopping async logger\n"));
 
-    std::shared_ptr<std::thread> t = m_thread;
-    if (t) {
-        m_cancel.store(true, std::memory_order_release);
-        m_event.signal();
+    std::vector<std::shared_ptr<std::thread>> threads;
+    for (auto& sh : m_shards)
+        threads.push_back(sh->thread);
 
-        t->join();
-    }
+    m_cancel.store(true, std::memory_order_release);
+
+    for (auto& sh : m_shards)
+        sh->event.signal();
+
+    for (auto& t : threads)
+        if (t) t->join();
 }
 
 template<typename traits>
 void basic_multi_file_async_logger<traits>::
-run() {
+run(shard& a_shard) {
+    if (a_shard.cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(a_shard.cpu, &cpus);
+        int ec = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (ec)
+            LOG_ERROR("Cannot pin logger thread %lu to CPU %d: %s\n",
+                      a_shard.index, a_shard.cpu, errno_string(ec).c_str());
+    }
+
     // Notify the caller that we are ready
     {
         std::unique_lock<std::mutex> lock(m_mutex);
+        a_shard.started = true;
         m_cond_var.notify_all();
     }
 
-    UTXX_ASYNC_TRACE(("Started async logging thread (cancel=%s)\n",
-        m_cancel ? "true" : "false"));
+    UTXX_ASYNC_TRACE(("Started async logging thread %lu (cancel=%s)\n",
+        a_shard.index, m_cancel ? "true" : "false"));
 
     static const timespec ts =
         {traits::commit_timeout / 1000, (traits::commit_timeout % 1000) * 1000000 };
 
-    m_total_msgs_processed = 0;
-
     while (true) {
         #if defined(DEBUG_ASYNC_LOGGER) && DEBUG_ASYNC_LOGGER != 2
         int rc =
         #endif
-        commit(&ts);
+        commit(a_shard, &ts);
 
         UTXX_ASYNC_TRACE(( "Async thread commit result: %d (head: %p, cancel=%s)\n",
-            rc, m_head.load(), m_cancel ? "true" : "false" ));
+            rc, a_shard.head.load(), m_cancel ? "true" : "false" ));
 
         // CPU-friendly spin for 250us
         time_val deadline(rel_time(0, 250));
-        while (!m_head.load(std::memory_order_relaxed)) {
+        while (!a_shard.head.load(std::memory_order_relaxed) && !a_shard.backlog) {
             if (m_cancel.load(std::memory_order_relaxed))
                 goto DONE;
             if (now_utc() > deadline)
@@ -865,21 +1054,55 @@ run() {
     }
 
 DONE:
+    drain(a_shard);
     UTXX_ASYNC_TRACE(("Logger loop finished - calling close()\n"));
-    internal_close();
+    internal_close(a_shard);
     UTXX_ASYNC_DEBUG_TRACE(("Logger notifying all of exiting (%ld) active_files=%d\n",
-                       m_thread.use_count(), open_files_count()));
+                       a_shard.thread.use_count(), open_files_count()));
 
-    m_thread.reset();
+    a_shard.thread.reset();
 }
 
 template<typename traits>
 void basic_multi_file_async_logger<traits>::
-internal_close() {
-    UTXX_ASYNC_TRACE(("Logger is closing\n"));
+internal_close(shard& a_shard) {
+    UTXX_ASYNC_TRACE(("Logger thread %lu is closing\n", a_shard.index));
     std::unique_lock<std::mutex> lock(m_mutex);
     for (auto* si : m_files)
-        internal_close(si, 0);
+        if (si && si->m_shard == &a_shard)
+            internal_close(si, 0);
+}
+
+template<typename traits>
+int basic_multi_file_async_logger<traits>::
+set_shards(size_t a_count) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (running() || open_files_count() || !a_count)
+        return -1;
+
+    m_shards.clear();
+    for (size_t i=0; i < a_count; ++i)
+        m_shards.emplace_back(new shard(i));
+    m_next_shard = 0;
+    return 0;
+}
+
+template<typename traits>
+int basic_multi_file_async_logger<traits>::
+set_shard(file_id& a_id, size_t a_shard) {
+    BOOST_ASSERT(a_id.stream());
+    BOOST_ASSERT(a_shard < m_shards.size());
+    if (a_id.stream()->m_enqueued.load(std::memory_order_acquire))
+        return -1;
+    a_id.stream()->m_shard = m_shards[a_shard].get();
+    return 0;
+}
+
+template<typename traits>
+void basic_multi_file_async_logger<traits>::
+set_shard_cpu(size_t a_shard, int a_cpu) {
+    BOOST_ASSERT(a_shard < m_shards.size());
+    m_shards[a_shard]->cpu = a_cpu;
 }
 
 template<typename traits>
@@ -950,6 +1173,15 @@ set_reconnect(file_id& a_id, stream_reconnecter a_reconnecter) {
     a_id.stream()->on_reconnect = a_reconnecter;
 }
 
+template<typename traits>
+void basic_multi_file_async_logger<traits>::
+set_priority(file_id& a_id, stream_priority a_prio, size_t a_quantum) {
+    BOOST_ASSERT(a_id.stream());
+    BOOST_ASSERT(a_prio >= PRIORITY_HIGH && a_prio < PRIORITY_COUNT);
+    a_id.stream()->priority = a_prio;
+    a_id.stream()->quantum  = a_quantum;
+}
+
 template<typename traits>
 typename basic_multi_file_async_logger<traits>::file_id
 basic_multi_file_async_logger<traits>::
@@ -977,6 +1209,26 @@ open_file_or_throw(const std::string& a_filename, bool a_append, int a_mode)
     return internal_register_stream(a_filename, &writev, NULL, n);
 }
 
+template<typename traits>
+typename basic_multi_file_async_logger<traits>::file_id
+basic_multi_file_async_logger<traits>::
+open_direct_file(const std::string& a_filename, bool a_append, int a_mode,
+                 size_t a_buf_sz, size_t a_prealloc)
+{
+    std::unique_ptr<direct_file_writer>
+        w(new direct_file_writer(a_buf_sz, a_prealloc));
+
+    if (w->open(a_filename, a_append, a_mode) < 0)
+        return file_id();
+    if (!check_range(w->fd()))
+        return file_id();
+
+    file_id id = internal_register_stream(a_filename, &writev, NULL, w->fd());
+    if (id)
+        id.stream()->m_direct = std::move(w);
+    return id;
+}
+
 template<typename traits>
 typename basic_multi_file_async_logger<traits>::file_id
 basic_multi_file_async_logger<traits>::
@@ -1023,6 +1275,7 @@ internal_register_stream(
 
     stream_info* si =
         new stream_info(this, a_name, a_fd, ++m_last_version, a_writer, a_state);
+    si->m_shard = m_shards[m_next_shard++ % m_shards.size()].get();
 
     if (!internal_update_stream(si, a_fd)) {
         delete si;
@@ -1069,7 +1322,7 @@ close_file(file_id& a_id, bool a_immediate, int a_wait_secs) {
 
     stream_info* si = a_id.stream();
 
-    if (!m_thread) {
+    if (!running()) {
         si->reset();
         a_id.reset();
         return 0;
@@ -1088,7 +1341,7 @@ close_file(file_id& a_id, bool a_immediate, int a_wait_secs) {
     if (!n && ev) {
         UTXX_ASYNC_TRACE(("----> close_file(%d) is waiting for ack secs=%d (event_val={%ld,%d})\n",
                      fd, a_wait_secs, event_val, ev->value()));
-        if (m_thread) {
+        if (running()) {
             if (a_wait_secs < 0)
                 n = ev->wait(&event_val);
             else {
@@ -1111,7 +1364,12 @@ close_file(file_id& a_id, bool a_immediate, int a_wait_secs) {
 template<typename traits>
 int basic_multi_file_async_logger<traits>::
 internal_enqueue(command_t* a_cmd, const stream_info* a_si) {
-    BOOST_ASSERT(a_cmd);
+    BOOST_ASSERT(a_cmd && a_cmd->stream->m_shard);
+
+    shard& sh = *a_cmd->stream->m_shard;
+
+    if (!a_cmd->stream->m_enqueued.load(std::memory_order_relaxed))
+        a_cmd->stream->m_enqueued.store(true, std::memory_order_release);
 
     command_t* old_head;
 
@@ -1126,13 +1384,13 @@ internal_enqueue(command_t* a_cmd, const stream_info* a_si) {
         if (i > 25)
             sched_yield();
 #endif
-        old_head = const_cast<command_t*>(m_head.load(std::memory_order_relaxed));
+        old_head = const_cast<command_t*>(sh.head.load(std::memory_order_relaxed));
         a_cmd->next = old_head;
-    } while(!m_head.compare_exchange_weak(old_head, a_cmd,
+    } while(!sh.head.compare_exchange_weak(old_head, a_cmd,
                 std::memory_order_release, std::memory_order_relaxed));
 
     if (!old_head)
-        m_event.signal();
+        sh.event.signal();
 
 #ifdef PERF_STATS
     if (i > 1) m_stats_enque_spins.fetch_add(i, std::memory_order_relaxed);
@@ -1140,7 +1398,7 @@ internal_enqueue(command_t* a_cmd, const stream_info* a_si) {
 
     UTXX_ASYNC_TRACE(("--> internal_enqueue cmd %p (type=%s) - "
                  "cur head: %p, prev head: %p%s\n",
-        a_cmd, a_cmd->type_str(), m_head.load(),
+        a_cmd, a_cmd->type_str(), sh.head.load(),
         old_head, !old_head ? " (signaled)" : ""));
 
     return 0;
@@ -1238,27 +1496,44 @@ deallocate_command(command_t* a_cmd) {
 
 template<typename traits>
 int basic_multi_file_async_logger<traits>::
-commit(const struct timespec* tsp)
+commit(shard& a_shard, const struct timespec* tsp)
 {
-    UTXX_ASYNC_TRACE(("Committing head: %p\n", m_head.load()));
+    UTXX_ASYNC_TRACE(("Committing head: %p\n", a_shard.head.load()));
 
-    int event_val = m_event.value();
+    int event_val = a_shard.event.value();
 
     while (!m_cancel.load(std::memory_order_relaxed) &&
-           !m_head.  load(std::memory_order_relaxed)) {
+           !a_shard.head.  load(std::memory_order_relaxed)) {
+        // Streams with data left over from the last pass
+        if (a_shard.backlog)
+            break;
+#ifdef UTXX_HAVE_IO_URING_H
+        // While io_uring writes are outstanding poll for their completion
+        // instead of sleeping on the event
+        if (a_shard.uring.inflight()) {
+            if (!uring_reap(a_shard)) {
+                if (m_use_sched_yield)
+                    sched_yield();
+                else
+                    usleep(50);
+            }
+            continue;
+        }
+#endif
         #ifdef DEBUG_ASYNC_LOGGER
         wakeup_result n =
         #endif
-        m_event.wait(tsp, &event_val);
+        a_shard.event.wait(tsp, &event_val);
 
         UTXX_ASYNC_DEBUG_TRACE(
             ("  %s COMMIT awakened (res=%s, val=%d, futex=%d), cancel=%d, head=%p\n",
-             timestamp::to_string().c_str(), to_string(n), event_val, m_event.value(),
-             m_cancel.load(std::memory_order_relaxed), m_head.load())
+             timestamp::to_string().c_str(), to_string(n), event_val, a_shard.event.value(),
+             m_cancel.load(std::memory_order_relaxed), a_shard.head.load())
         );
     }
 
-    if (m_cancel.load(std::memory_order_relaxed) && !m_head.load(std::memory_order_relaxed))
+    if (m_cancel.load(std::memory_order_relaxed) &&
+       !a_shard.head.load(std::memory_order_relaxed) && !a_shard.backlog)
         return 0;
 
     command_t* cur_head;
@@ -1272,21 +1547,28 @@ commit(const struct timespec* tsp)
 #ifdef PERF_STATS
         i++;
 #endif
-        cur_head = const_cast<command_t*>(m_head.load(std::memory_order_relaxed));
-    } while(!m_head.compare_exchange_strong(cur_head, static_cast<command_t*>(nullptr),
+        cur_head = const_cast<command_t*>(a_shard.head.load(std::memory_order_relaxed));
+    } while(!a_shard.head.compare_exchange_strong(cur_head, static_cast<command_t*>(nullptr),
                 std::memory_order_release, std::memory_order_relaxed));
 
 #ifdef PERF_STATS
     if (i > 1) m_stats_deque_spins.fetch_add(i, std::memory_order_relaxed);
 #endif
-    UTXX_ASYNC_TRACE((" --> cur head: %p, new head: %p\n", cur_head, m_head.load()));
-
-    BOOST_ASSERT(cur_head);
+    UTXX_ASYNC_TRACE((" --> cur head: %p, new head: %p\n", cur_head, a_shard.head.load()));
+
+    // The producers push commands to the head of the list, so restore
+    // their original order before dispatching them to streams
+    command_t* fifo = NULL;
+    for (command_t* p = cur_head, *next; p; p = next) {
+        next    = p->next;
+        p->next = fifo;
+        fifo    = p;
+    }
 
     int n, count = 0;
 
-    // Place reverse commands in the pending queues of individual streams.
-    for(const command_t* p = cur_head; p; count += n) {
+    // Place commands in the pending queues of individual streams.
+    for(const command_t* p = fifo; p; count += n) {
         stream_info* si = const_cast<stream_info*>(p->stream);
         BOOST_ASSERT(si);
 
@@ -1297,138 +1579,375 @@ commit(const struct timespec* tsp)
         // Insert data to the pending list
         // (this function advances p until there is a stream change)
         n = si->push(p);
-        // Update the index of fds that have pending data
-        m_pending_data_streams.insert(si);
+        // Update the list of streams that have pending data
+        a_shard.mark_dirty(si);
         UTXX_ASYNC_TRACE(("Set stream %p fd[%d].pending_writes(%p) -> %d, head(%p), next(%p)\n",
                      si, si->fd, last, n, si->pending_writes_head(), p));
     }
 
     // Process each fd's pending command queue
-    if (m_max_queue_size < count)
-        m_max_queue_size = count;
+    if (a_shard.max_queue_size < count)
+        a_shard.max_queue_size = count;
 
     m_total_msgs_processed.fetch_add(count, std::memory_order_relaxed);
 
     UTXX_ASYNC_DEBUG_TRACE(("Processed count: %d / %ld. (MaxQsz = %d)\n",
-                       count, m_total_msgs_processed.load(), m_max_queue_size));
+                       count, m_total_msgs_processed.load(), a_shard.max_queue_size));
 
-    for(auto it = m_pending_data_streams.begin(), e = m_pending_data_streams.end();
-             it != e; ++it)
-    {
-        stream_info*     si = *it;
-        msg_formatter& ffmt = si->on_format;
-
-        // If there was an error on this stream try to reconnect the stream
-        if (si->error && si->on_reconnect) {
-            time_val now(time_val::universal_time());
-            double time_diff = now.diff(si->last_reconnect_attempt());
-
-            if (time_diff > m_reconnect_sec) {
-                UTXX_ASYNC_TRACE(("===> Trying to reconnect stream %p "
-                             "(prev reconnect %.3fs ago)\n",
-                             si, si->last_reconnect_attempt() ? time_diff : 0.0));
-
-                int fd = si->on_reconnect(*si);
-
-                UTXX_ASYNC_TRACE(("     Stream %p %s\n",
-                             si, fd < 0 ? "not reconnected!"
-                                        : "reconnected successfully!"));
-
-                if (fd >= 0 && !internal_update_stream(si, fd)) {
-                    char buf[256];
-                    snprintf(buf, sizeof(buf),
-                             "Logger %s failed to register file descriptor %d!",
-                             si->name.c_str(), si->fd);
-                    if (m_err_handler)
-                        m_err_handler(*si, si->error, buf);
-                    else
-                        LOG_ERROR((buf));
-                }
+    write_pending_streams(a_shard);
+    return count;
+}
+
+template<typename traits>
+void basic_multi_file_async_logger<traits>::
+write_pending_streams(shard& a_shard)
+{
+#ifdef UTXX_HAVE_IO_URING_H
+    if (a_shard.uring.active())
+        uring_reap(a_shard);
+#endif
+    a_shard.backlog = 0;
+
+    // Streams of higher priority classes are written first. Each class's
+    // list is detached, and streams that still need attention after this
+    // pass are put back on it by mark_dirty().
+    for (int prio = 0; prio < PRIORITY_COUNT; ++prio) {
+        stream_info* next_si = a_shard.dirty[prio];
+        a_shard.dirty[prio]  = nullptr;
+
+        for (stream_info* si = next_si; si; si = next_si) {
+            next_si          = si->m_next_dirty;
+            si->m_next_dirty = nullptr;
+            si->m_dirty      = false;
+            write_stream(a_shard, si);
+        }
+    }
+
+#ifdef UTXX_HAVE_IO_URING_H
+    if (a_shard.uring.inflight())
+        a_shard.uring.submit();
+#endif
+}
 
-                si->m_last_reconnect_attempt = now;
+template<typename traits>
+void basic_multi_file_async_logger<traits>::
+write_stream(shard& a_shard, stream_info* a_si)
+{
+    msg_formatter& ffmt = a_si->on_format;
+
+    // If there was an error on this stream try to reconnect the stream
+    if (a_si->error && a_si->on_reconnect) {
+        time_val now(time_val::universal_time());
+        double time_diff = now.diff(a_si->last_reconnect_attempt());
+
+        if (time_diff > m_reconnect_sec) {
+            UTXX_ASYNC_TRACE(("===> Trying to reconnect stream %p "
+                         "(prev reconnect %.3fs ago)\n",
+                         a_si, a_si->last_reconnect_attempt() ? time_diff : 0.0));
+
+            int fd = a_si->on_reconnect(*a_si);
+
+            UTXX_ASYNC_TRACE(("     Stream %p %s\n",
+                         a_si, fd < 0 ? "not reconnected!"
+                                    : "reconnected successfully!"));
+
+            if (fd >= 0 && !internal_update_stream(a_si, fd)) {
+                char buf[256];
+                snprintf(buf, sizeof(buf),
+                         "Logger %s failed to register file descriptor %d!",
+                         a_si->name.c_str(), a_si->fd);
+                if (m_err_handler)
+                    m_err_handler(*a_si, a_si->error, buf);
+                else
+                    LOG_ERROR((buf));
             }
+
+            a_si->m_last_reconnect_attempt = now;
         }
+    }
 
-        UTXX_ASYNC_TRACE(("Processing commands for stream %p (fd=%d)\n", si, si->fd));
+    UTXX_ASYNC_TRACE(("Processing commands for stream %p (fd=%d)\n", a_si, a_si->fd));
 
-        struct iovec iov [si->max_batch_sz];  // Contains pointers to write
-        const  char* cats[si->max_batch_sz];  // List of message categories
-        size_t n = 0, sz = 0;
+#ifdef UTXX_HAVE_IO_URING_H
+    // Only one write per stream is in flight in order to preserve
+    // the order of messages. The rest waits for its completion.
+    if (a_si->m_in_flight) {
+        if (!a_si->pending_queue_empty())
+            a_shard.defer(a_si);
+        return;
+    }
+#endif
+
+    // Deficit round-robin: earn the byte credit of this pass
+    a_si->m_deficit += a_si->quantum;
+
+#ifdef UTXX_HAVE_IO_URING_H
+    if (a_shard.uring.active() && uring_submit(a_shard, a_si)) {
+        if (!a_si->pending_queue_empty())
+            a_shard.defer(a_si);
+        return;
+    }
+#endif
 
-        static const int SI_OK               = 0;
-        static const int SI_CLOSE_SCHEDULED  = 1 << 0;
-        static const int SI_CLOSE            = 1 << 1 | SI_CLOSE_SCHEDULED;
-        static const int SI_DESTROY          = 1 << 2 | SI_CLOSE;
+    struct iovec iov [a_si->max_batch_sz];  // Contains pointers to write
+    const  char* cats[a_si->max_batch_sz];  // List of message categories
+    size_t n = 0, sz = 0;
 
-        int status = SI_OK;
+    static const int SI_OK               = 0;
+    static const int SI_CLOSE_SCHEDULED  = 1 << 0;
+    static const int SI_CLOSE            = 1 << 1 | SI_CLOSE_SCHEDULED;
+    static const int SI_DESTROY          = 1 << 2 | SI_CLOSE;
 
-        const command_t* p = si->pending_writes_head();
-        command_t* end;
+    int status = SI_OK;
 
-        // Process commands in blocks of si->max_batch_sz
-        for (; p && !si->error && ((status & SI_CLOSE) != SI_CLOSE); p = end) {
-            end = p->next;
+    const command_t* p = a_si->pending_writes_head();
+    command_t* end;
 
-            if (p->type == command_t::msg) {
-                iov[n]  = ffmt(p->args.msg.category, p->args.msg.data);
-                cats[n] = p->args.msg.category.c_str();
-                sz     += iov[n].iov_len;
-                UTXX_ASYNC_TRACE(("FD=%d (stream %p) cmd %p (#%lu) next(%p), "
-                             "write(%p, %lu) free(%p, %lu)\n",
-                             si->fd, si, p, n, p->next, iov[n].iov_base, iov[n].iov_len,
-                             p->args.msg.data.iov_base, p->args.msg.data.iov_len));
-                assert(n < si->max_batch_sz);
+    // Process commands in blocks of a_si->max_batch_sz
+    for (; p && !a_si->error && ((status & SI_CLOSE) != SI_CLOSE); p = end) {
+        end = p->next;
 
-                if (++n == si->max_batch_sz) {
-                    int ec = do_writev_and_free(si, end, cats, iov, n);
-                    if (ec > 0)
-                        n = 0;
+        if (p->type == command_t::msg) {
+            // Leave the rest till the next pass when the credit runs out,
+            // unless the stream is being closed
+            if (a_si->quantum && status == SI_OK) {
+                size_t len = p->args.msg.data.iov_len;
+                if (len > a_si->m_deficit) {
+                    end = const_cast<command_t*>(p);
+                    break;
                 }
-            } else if (p->type == command_t::close) {
-                status |= p->args.close.immediate ? SI_CLOSE : SI_CLOSE_SCHEDULED;
-                UTXX_ASYNC_TRACE(("FD=%d, Command %lu address %p (close)\n", si->fd, n, p));
-                si->erase(const_cast<command_t*>(p));
-            } else if (p->type == command_t::destroy_stream) {
-                status |= SI_DESTROY;
-                si->erase(const_cast<command_t*>(p));
-            } else {
-                UTXX_ASYNC_TRACE(("Command %p has invalid message type: %s "
-                             "(stream=%p, prev=%p, next=%p)\n",
-                             p, p->type_str(), p->stream, p->prev, p->next));
-                si->erase(const_cast<command_t*>(p));
-                BOOST_ASSERT(false); // This should never happen!
+                a_si->m_deficit -= len;
             }
-        }
 
-        if (si->error) {
-            UTXX_ASYNC_TRACE(("Written total %lu bytes to %p (fd=%d) %s with error: %s\n",
-                              sz, si, si->fd, si->name.c_str(), si->error_msg.c_str()));
+            iov[n]  = ffmt(p->args.msg.category, p->args.msg.data);
+            cats[n] = p->args.msg.category.c_str();
+            sz     += iov[n].iov_len;
+            UTXX_ASYNC_TRACE(("FD=%d (stream %p) cmd %p (#%lu) next(%p), "
+                         "write(%p, %lu) free(%p, %lu)\n",
+                         a_si->fd, a_si, p, n, p->next, iov[n].iov_base, iov[n].iov_len,
+                         p->args.msg.data.iov_base, p->args.msg.data.iov_len));
+            assert(n < a_si->max_batch_sz);
+
+            if (++n == a_si->max_batch_sz) {
+                int ec = do_writev_and_free(a_si, end, cats, iov, n);
+                if (ec > 0)
+                    n = 0;
+            }
+        } else if (p->type == command_t::close) {
+            status |= p->args.close.immediate ? SI_CLOSE : SI_CLOSE_SCHEDULED;
+            UTXX_ASYNC_TRACE(("FD=%d, Command %lu address %p (close)\n", a_si->fd, n, p));
+            a_si->erase(const_cast<command_t*>(p));
+        } else if (p->type == command_t::destroy_stream) {
+            status |= SI_DESTROY;
+            a_si->erase(const_cast<command_t*>(p));
         } else {
-            if (n > 0)
-                do_writev_and_free(si, end, cats, iov, n);
+            UTXX_ASYNC_TRACE(("Command %p has invalid message type: %s "
+                         "(stream=%p, prev=%p, next=%p)\n",
+                         p, p->type_str(), p->stream, p->prev, p->next));
+            a_si->erase(const_cast<command_t*>(p));
+            BOOST_ASSERT(false); // This should never happen!
+        }
+    }
 
-            UTXX_ASYNC_TRACE(("Written total %lu bytes to (fd=%d) %s\n",
-                              sz, si->fd, si->name.c_str()));
+    if (a_si->error) {
+        UTXX_ASYNC_TRACE(("Written total %lu bytes to %p (fd=%d) %s with error: %s\n",
+                          sz, a_si, a_si->fd, a_si->name.c_str(), a_si->error_msg.c_str()));
+    } else {
+        if (n > 0)
+            do_writev_and_free(a_si, end, cats, iov, n);
+
+        UTXX_ASYNC_TRACE(("Written total %lu bytes to (fd=%d) %s\n",
+                          sz, a_si->fd, a_si->name.c_str()));
+    }
+
+    // Close associated file descriptor
+    if (a_si->error || status != SI_OK) {
+        bool destroy_si = (status & SI_DESTROY);
+
+        // Other shards may be walking m_files in internal_close(shard&)
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        internal_close(a_si, a_si->error);
+
+        if (destroy_si) {
+            UTXX_ASYNC_TRACE(("<<< Destroying %p stream\n", a_si));
+            delete a_si;
+            return;
         }
+    }
 
-        // Close associated file descriptor
-        if (si->error || status != SI_OK) {
-            bool destroy_si = (status & SI_DESTROY);
+    // Out of credit - continue on the next pass
+    if (a_si->pending_queue_empty())
+        a_si->m_deficit = 0;
+    else if (!a_si->error)
+        a_shard.defer(a_si);
 
-            if (destroy_si || si->fd < 0) {
-                UTXX_ASYNC_DEBUG_TRACE(("Removing %p stream from list of pending data streams\n", si));
-                m_pending_data_streams.erase(si);
-            }
+    // Keep retrying to reconnect a failed stream
+    if (a_si->error && a_si->on_reconnect)
+        a_shard.mark_dirty(a_si);
+}
+
+#ifdef UTXX_HAVE_IO_URING_H
+template<typename traits>
+int basic_multi_file_async_logger<traits>::
+use_io_uring(unsigned a_queue_depth) {
+    if (running())
+        return -EBUSY;
+#ifdef PERF_NO_WRITEV
+    return -ENOTSUP;
+#else
+    for (auto& sh : m_shards) {
+        int ec = sh->uring.init(a_queue_depth);
+        if (ec < 0) {
+            for (auto& x : m_shards) x->uring.close();
+            return ec;
+        }
+    }
+    return 0;
+#endif
+}
+
+template<typename traits>
+bool basic_multi_file_async_logger<traits>::
+uring_write::advance(size_t a_bytes) {
+    for (; first < iov.size() && a_bytes >= iov[first].iov_len; ++first)
+        a_bytes -= iov[first].iov_len;
+    if (first == iov.size())
+        return true;
+    iov[first].iov_base  = static_cast<char*>(iov[first].iov_base) + a_bytes;
+    iov[first].iov_len  -= a_bytes;
+    return false;
+}
+
+template<typename traits>
+bool basic_multi_file_async_logger<traits>::
+uring_submit(shard& a_shard, stream_info* a_si) {
+    typedef int (*writer_fun)(stream_info&, const char**, const iovec*, size_t);
+
+    command_t* p = a_si->pending_writes_head();
+
+    // Streams with custom writers, O_DIRECT files, and close/destroy
+    // commands are handled by the writev(2) path
+    if (!p || p->type != command_t::msg || a_si->error || a_si->fd < 0)
+        return false;
+    auto fun = a_si->on_write.template target<writer_fun>();
+    if (!fun || *fun != &writev || a_si->m_direct)
+        return false;
+
+    // Out of the byte credit for this pass
+    if (a_si->quantum && p->args.msg.data.iov_len > a_si->m_deficit)
+        return true;
 
-            internal_close(si, si->error);
+    io_uring_sqe* sqe = a_shard.uring.get_sqe();
+    if (!sqe)
+        return false;
+
+    auto* w = new uring_write{a_si, p, {}, 0};
+    w->iov.reserve(std::min<size_t>(a_si->max_batch_sz, 64));
+
+    command_t* last = p;
+    for (; p && p->type == command_t::msg && w->iov.size() < a_si->max_batch_sz;
+           last = p, p = p->next) {
+        if (a_si->quantum) {
+            if (p->args.msg.data.iov_len > a_si->m_deficit)
+                break;
+            a_si->m_deficit -= p->args.msg.data.iov_len;
+        }
+        w->iov.push_back(a_si->on_format(p->args.msg.category, p->args.msg.data));
+    }
+
+    // Detach the batch from the stream's pending queue
+    last->next = NULL;
+    a_si->pending_writes_head(p);
+    if (p)
+        p->prev = NULL;
+    else
+        a_si->pending_writes_tail(NULL);
 
-            if (destroy_si) {
-                UTXX_ASYNC_TRACE(("<<< Destroying %p stream\n", si));
-                delete si;
+    UTXX_ASYNC_TRACE(("FD=%d submitting %lu messages to io_uring\n",
+                      a_si->fd, w->iov.size()));
+
+    io_uring_queue::prep_writev(sqe, a_si->fd, w->iov.data(), w->iov.size(), w);
+    a_si->m_in_flight = true;
+    return true;
+}
+
+template<typename traits>
+int basic_multi_file_async_logger<traits>::
+uring_reap(shard& a_shard) {
+    int n = a_shard.uring.reap([this, &a_shard](uint64_t a_user_data, int a_res) {
+        auto* w  = reinterpret_cast<uring_write*>(a_user_data);
+        auto* si = w->stream;
+
+        if (a_res == -EINTR || a_res == -EAGAIN)
+            a_res = 0;
+
+        // Short write - write the remainder
+        if (a_res >= 0 && !w->advance(a_res)) {
+            if (io_uring_sqe* sqe = a_shard.uring.get_sqe()) {
+                io_uring_queue::prep_writev(sqe, si->fd, &w->iov[w->first],
+                                            w->iov.size() - w->first, w);
+                return;
             }
+            // The submission queue is full - finish the write synchronously
+            do a_res = ::writev(si->fd, &w->iov[w->first], w->iov.size() - w->first);
+            while (a_res >= 0 ? !w->advance(a_res) : errno == EINTR);
+            if (a_res < 0)
+                a_res = -errno;
         }
+
+        if (a_res < 0 && !si->error) {
+            si->set_error(-a_res);
+            if (m_err_handler)
+                m_err_handler(*si, si->error, si->error_msg);
+            else
+                LOG_ERROR("Error writing %lu messages to stream '%s': %s\n",
+                           w->iov.size(), si->name.c_str(), si->error_msg.c_str());
+        }
+
+        UTXX_ASYNC_TRACE(("FD=%d io_uring write of %lu messages completed: %d\n",
+                          si->fd, w->iov.size(), a_res));
+
+        for (command_t* p = w->cmds, *next; p; p = next) {
+            next = p->next;
+            deallocate_command(p);
+        }
+        si->m_in_flight = false;
+        delete w;
+
+        // Write the rest of the stream's data or close it on error
+        if (si->error || !si->pending_queue_empty())
+            a_shard.defer(si);
+    });
+
+    if (n)
+        a_shard.uring.submit();
+    return n;
+}
+
+#else
+template<typename traits>
+int basic_multi_file_async_logger<traits>::
+use_io_uring(unsigned) {
+    return -ENOSYS;
+}
+#endif
+
+template<typename traits>
+void basic_multi_file_async_logger<traits>::
+drain(shard& a_shard) {
+#ifdef UTXX_HAVE_IO_URING_H
+    while (a_shard.uring.inflight() || a_shard.backlog) {
+        if (a_shard.uring.inflight()) {
+            a_shard.uring.submit(1);
+            uring_reap(a_shard);
+        }
+        write_pending_streams(a_shard);
     }
-    return count;
+#else
+    while (a_shard.backlog)
+        write_pending_streams(a_shard);
+#endif
 }
 
 } // namespace utxx
@@ -38,7 +38,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/math.hpp>
 #include <utxx/error.hpp>
 #include <utxx/compiler_hints.hpp>
+#include <utxx/detail/span_pair.hpp>
+#include <algorithm>
 #include <cstddef>
+#include <iterator>
 #include <type_traits>
 #include <atomic>
 #include <cassert>
@@ -62,6 +65,11 @@ template<
     bool     Atomic         = true
 >
 struct ring_buffer {
+    /// Range of entries returned by claim() and peek(). The second span is
+    /// non-empty only if the range wraps around the end of the buffer
+    typedef detail::span_pair<T>       span_pair;
+    typedef detail::span_pair<T const> const_span_pair;
+
     /// Default constructor does not make much sense unless StaticCapacity > 0
     ring_buffer() : ring_buffer(0u) {}
 
@@ -178,6 +186,55 @@ struct ring_buffer {
         return at;
     }
 
+    /// \brief Reserve up to capacity() slots following the most recent entry
+    /// for in-place construction.
+    /// The caller must construct the entries in the first k of the returned
+    /// slots and call publish(k) to make them visible to the readers with a
+    /// single update of the entry counter. Note that claimed slots overwrite
+    /// the oldest entries.
+    span_pair claim(size_t n) {
+        size_t sz = load_size<Atomic>(std::memory_order_acquire);
+        return span_pair::make
+            (m_entries, m_capacity, sz & m_mask, std::min(n, m_capacity));
+    }
+
+    /// Make \a n entries constructed in the slots returned by claim() visible
+    /// to the readers
+    void publish(size_t n) {
+        assert(n <= m_capacity);
+        store_size<Atomic>(load_size<Atomic>(std::memory_order_acquire) + n);
+    }
+
+    /// \brief Insert \a n entries copied from \a a_first into the buffer.
+    /// If \a n exceeds capacity(), only the last capacity() entries are
+    /// stored, but total_count() is still advanced by \a n.
+    template <class InputIt>
+    void add_n(InputIt a_first, size_t n) {
+        size_t skip = n > m_capacity ? n - m_capacity : 0;
+        std::advance(a_first, skip);
+
+        size_t    sz = load_size<Atomic>(std::memory_order_acquire);
+        span_pair r  = span_pair::make
+                        (m_entries, m_capacity, (sz + skip) & m_mask, n - skip);
+        for (T& e : r.first)
+            construct<T>(&e, *a_first++);
+        for (T& e : r.second)
+            construct<T>(&e, *a_first++);
+
+        store_size<Atomic>(sz + n);
+    }
+
+    /// \brief The most recent (up to \a n) entries ordered from the oldest to
+    /// the newest.
+    /// Since readers are passive, there is no matching "release" call: the
+    /// entries remain valid until the writer overwrites them.
+    const_span_pair peek(size_t n) const {
+        size_t sz  = load_size<Atomic>(std::memory_order_acquire);
+        size_t cnt = std::min(std::min(n, sz), m_capacity);
+        return const_span_pair::make
+            (m_entries, m_capacity, (sz - cnt) & m_mask, cnt);
+    }
+
     /// Index of the most recent entry in range [0 ... capacity()-1]
     size_t last() const {
         size_t sz =  load_size<Atomic>();
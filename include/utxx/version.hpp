@@ -0,0 +1,10 @@
+//------------------------------------------------------------------------------
+// Version.hpp
+//------------------------------------------------------------------------------
+// This file is auto-generated!  DON'T MODIFY!
+//------------------------------------------------------------------------------
+#pragma once
+
+constexpr const char* VERSION() {
+    return "Version: 20261017-04:27:09 +0000 (356f403-dirty)";
+}
@@ -32,6 +32,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <climits>
 #include <mutex>
 #include <utxx/error.hpp>
 #include <utxx/meta.hpp>
@@ -40,6 +41,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/compiler_hints.hpp>
 #include <utxx/synch.hpp>
 #include <utxx/bits.hpp>
+#include <utxx/atomic.hpp>
+#include <utxx/convert.hpp>
 #include <utxx/logger/logger.hpp>
 #include <utxx/logger/logger_util.hpp>
 #include <utxx/logger/logger_crash_handler.hpp>
@@ -52,6 +55,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <boost/thread/locks.hpp>
 #include <stdio.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 
 #if DEBUG_ASYNC_LOGGER == 2
 #   define ASYNC_DEBUG_TRACE(x) do { printf x; fflush(stdout); } while(0)
@@ -71,6 +78,25 @@ void finalize_logger_at_exit()
     try { logger::instance().finalize(); } catch(...) {}
 }
 
+/// Logger whose run() loop executes in the current thread
+static thread_local const logger* t_logger_thread = nullptr;
+
+bool logger::in_logger_thread() const
+{
+    return t_logger_thread == this;
+}
+
+static const char* to_string(logger::wait_strategy a_strategy)
+{
+    switch (a_strategy) {
+        case logger::wait_strategy::PARK:     return "park";
+        case logger::wait_strategy::SPIN:     return "spin";
+        case logger::wait_strategy::BACKOFF:  return "backoff";
+        case logger::wait_strategy::ADAPTIVE: return "adaptive";
+    }
+    return "undefined";
+}
+
 
 int logger::level_to_signal_slot(log_level level) noexcept
 {
@@ -115,6 +141,7 @@ log_level logger::signal_slot_to_level(int slot) noexcept
 
 const char* logger::default_log_levels = "INFO|NOTICE|WARNING|ERROR|ALERT|FATAL";
 std::atomic<sigset_t*> logger::m_crash_sigset;
+std::atomic<bool>      logger::s_dump_stats;
 
 void logger::add_macro(const std::string& a_macro, const std::string& a_value)
 {
@@ -174,12 +201,73 @@ void logger::init(const config_tree& a_cfg, const sigset_t* a_ignore_signals,
         long timeout_ms  = a_cfg.get<int>        ("logger.wait-timeout-ms", 1000);
         m_wait_timeout   = timespec{timeout_ms / 1000, timeout_ms % 1000 *  1000000L};
         m_sched_yield_us = a_cfg.get<long>       ("logger.sched-yield-us",  -1);
+        auto wait        = a_cfg.get<std::string>("logger.wait-strategy",  "park");
+        if      (wait == "park")     m_wait_strategy = wait_strategy::PARK;
+        else if (wait == "spin")     m_wait_strategy = wait_strategy::SPIN;
+        else if (wait == "backoff")  m_wait_strategy = wait_strategy::BACKOFF;
+        else if (wait == "adaptive") m_wait_strategy = wait_strategy::ADAPTIVE;
+        else
+            throw std::runtime_error("Invalid logger.wait-strategy value: " + wait);
+        m_spin_ns        = a_cfg.get<long>       ("logger.spin-max-us",     50) * 1000;
+        m_arrival_gap_ns = 0;
+        m_last_arrival.clear();
+        m_parked.store(false, std::memory_order_relaxed);
         m_silent_finish  = a_cfg.get<bool>       ("logger.silent-finish",   false);
         m_block_signals  = a_cfg.get<bool>       ("logger.block-signals",   true);
+        m_deferred_format= a_cfg.get<bool>       ("logger.deferred-format", false);
+        m_thread_queue_capacity = a_cfg.get<int> ("logger.thread-queue-capacity", 0);
+        m_queue_capacity = a_cfg.get<long>       ("logger.queue-capacity",  0);
+        m_queue_size.store(0, std::memory_order_relaxed);
+        for (auto& n : m_dropped)
+            n.store(0, std::memory_order_relaxed);
+
+        auto overflow    = a_cfg.get<std::string>("logger.queue-overflow", "block");
+        if      (overflow == "block")         m_queue_overflow = overflow_policy::BLOCK;
+        else if (overflow == "drop-newest")   m_queue_overflow = overflow_policy::DROP_NEWEST;
+        else if (overflow == "drop-by-level") m_queue_overflow = overflow_policy::DROP_BY_LEVEL;
+        else if (overflow == "spill")         m_queue_overflow = overflow_policy::SPILL;
+        else
+            throw std::runtime_error("Invalid logger.queue-overflow value: " + overflow);
+
+        m_queue_overflow_level = parse_log_level
+            (a_cfg.get<std::string>("logger.queue-overflow-level", "warning"));
+
+        // Under the 'block' policy the spill file is optional and only takes
+        // messages logged by the logger's own thread, which can't wait
+        if (m_queue_capacity && (m_queue_overflow == overflow_policy::SPILL ||
+                                 m_queue_overflow == overflow_policy::BLOCK)) {
+            auto file = replace_macros
+                (a_cfg.get<std::string>("logger.queue-spill-file", ""));
+            if (file.empty() && m_queue_overflow == overflow_policy::SPILL)
+                throw std::runtime_error
+                    ("logger.queue-spill-file is required by the 'spill' overflow policy");
+            if (!file.empty()) {
+                m_spill_fd = open(file.c_str(), O_CREAT|O_WRONLY|O_APPEND|O_LARGEFILE, 0644);
+                if (m_spill_fd < 0)
+                    UTXX_THROW_IO_ERROR(errno, "Error opening spill file ", file);
+            }
+        }
 
         if ((int)m_timestamp_type < 0)
             throw std::runtime_error("Invalid timestamp type: " + ts);
 
+        m_latency_stats  = a_cfg.get<bool>       ("logger.latency-stats",   false);
+        reset_stats();
+
+        // Install the signal handler that logs latency statistics
+        auto stats_sigs  = a_cfg.get<std::string>("logger.latency-stats.signal", "");
+        if (m_latency_stats && !stats_sigs.empty()) {
+            m_stats_sigset = sig_members_parse(stats_sigs, UTXX_SRC);
+            struct sigaction sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_handler = &logger::on_stats_signal;
+            sigemptyset(&sa.sa_mask);
+            sa.sa_flags   = SA_RESTART;
+            for (uint i=1; i < sig_names_count(); ++i)
+                if (sigismember(&m_stats_sigset, i) && sigaction(i, &sa, nullptr) < 0)
+                    UTXX_THROW_IO_ERROR(errno, "Cannot install handler of ", sig_name(i));
+        }
+
         // Install crash signal handlers
         // (SIGABRT, SIGFPE, SIGILL, SIGSEGV, SIGTERM)
         if (a_cfg.get("logger.handle-crash-signals", true)) {
@@ -197,7 +285,21 @@ void logger::init(const config_tree& a_cfg, const sigset_t* a_ignore_signals,
                 if (!old)
                     delete old;
             }
+
+            // Reserve the buffer used for writing pending messages on crash
+            m_crash_buf_size = std::max<long>(1024, a_cfg.get<long>
+                ("logger.handle-crash-signals.buffer-size", 64*1024));
+            m_crash_buf.reset(new char[m_crash_buf_size]);
+            m_crash_wait_ms  = a_cfg.get<int>
+                ("logger.handle-crash-signals.wait-ms", 100);
+
+            // localtime_r() isn't async-signal-safe, so the crash formatter
+            // applies the offset of the local time zone captured here
+            time_t    now = time(nullptr);
+            struct tm tm;
+            m_utc_offset = localtime_r(&now, &tm) ? tm.tm_gmtoff : 0;
         }
+        m_crash_flushed.store(false, std::memory_order_relaxed);
 
         //logger_impl::msg_info info(NULL, 0);
         //query_timestamp(info);
@@ -237,6 +339,11 @@ void logger::init(const config_tree& a_cfg, const sigset_t* a_ignore_signals,
                 auto& i = m_implementations.back();
                 i->set_log_mgr(this);
                 i->init(a_cfg);
+
+                int fd = i->crash_fd();
+                if (fd >= 0 && std::find(m_crash_fds.begin(), m_crash_fds.end(), fd)
+                            == m_crash_fds.end())
+                    m_crash_fds.push_back(fd);
             }
         }
 
@@ -261,99 +368,330 @@ void logger::run()
 {
     utxx::signal_block block_signals(m_block_signals);
 
+    t_logger_thread = this;
+    m_thread_tid.store(syscall(SYS_gettid), std::memory_order_release);
+
     if (m_on_before_run)
         m_on_before_run();
 
     if (!m_ident.empty())
-        pthread_setname_np(pthread_self(), m_ident.c_str());
+        log_threads::set_name(m_ident.c_str());
 
     int event_val;
     do
     {
-        event_val = m_event.value();
-        //wakeup_result rc = wakeup_result::TIMEDOUT;
-
-        while (!m_abort && m_queue.empty()) {
-            m_event.wait(&m_wait_timeout, &event_val);
-
-            ASYNC_DEBUG_TRACE(
-                ("  %s LOGGER awakened (res=%s, val=%d, futex=%d), abort=%d, head=%s\n",
-                 timestamp::to_string().c_str(), to_string(rc).c_str(),
-                 event_val, m_event.value(), m_abort,
-                 m_queue.empty() ? "empty" : "data")
-            );
-        }
-
-        // When running with maximum priority, occasionally excessive use of
-        // sched_yield may use to system slowdown, so this option is
-        // configurable by m_sched_yield_us:
-        if (m_queue.empty() && m_sched_yield_us >= 0) {
-            time_val deadline(rel_time(0, m_sched_yield_us));
-            while (m_queue.empty()) {
-                if (m_abort)
-                    goto DONE;
-                if (now_utc() > deadline)
-                    break;
-                sched_yield();
+        if (m_wait_strategy != wait_strategy::PARK)
+            spin_wait();
+        else {
+            event_val = m_event.value();
+            //wakeup_result rc = wakeup_result::TIMEDOUT;
+
+            while (!m_abort && queues_empty()) {
+                m_event.wait(&m_wait_timeout, &event_val);
+                dump_stats_on_signal();
+
+                ASYNC_DEBUG_TRACE(
+                    ("  %s LOGGER awakened (res=%s, val=%d, futex=%d), abort=%d, head=%s\n",
+                     timestamp::to_string().c_str(), to_string(rc).c_str(),
+                     event_val, m_event.value(), m_abort,
+                     queues_empty() ? "empty" : "data")
+                );
             }
-        }
-
-        // Get all pending items from the queue
-        for (auto* item = m_queue.pop_all(), *next=item; item; item = next) {
-            next = item->next();
-
-            try   { dolog_msg(item->data()); }
-            catch ( std::exception const& e  )
-            {
-                // Unhandled error writing data to some destination
-                // Print error report to stderr (can't do anything better --
-                // the error happened in the m_on_error callback!)
-                const msg msg(LEVEL_INFO, "",
-                              std::string("Fatal exception in logger"),
-                              UTXX_LOG_SRCINFO);
-                detail::basic_buffered_print<1024> buf;
-                char  pfx[256], sfx[256];
-                char* p = format_header(msg, pfx, pfx + sizeof(pfx));
-                char* q = format_footer(msg, sfx, sfx + sizeof(sfx));
-                auto ps = p - pfx;
-                auto qs = q - sfx;
-                buf.reserve(msg.m_fun.str.size() + ps + qs + 1);
-                buf.sprint(pfx, ps);
-                buf.print(msg.m_fun.str);
-                buf.sprint(sfx, qs);
-                std::cerr << buf.str() << std::endl;
-
-                m_abort = true;
 
-                // TODO: implement attempt to store transient messages to some
-                // other medium
-
-                // Free all pending messages
-                while (item) {
-                    m_queue.free(item);
-                    item = next;
-                    next = item->next();
+            // When running with maximum priority, occasionally excessive use of
+            // sched_yield may use to system slowdown, so this option is
+            // configurable by m_sched_yield_us:
+            if (queues_empty() && m_sched_yield_us >= 0) {
+                time_val deadline(rel_time(0, m_sched_yield_us));
+                while (queues_empty()) {
+                    if (m_abort)
+                        goto DONE;
+                    if (now_utc() > deadline)
+                        break;
+                    sched_yield();
                 }
-
-                goto DONE;
             }
+        }
 
-            m_queue.free(item);
-            item = next;
+        // Get all pending items from the queues
+        if (!drain_queues()) {
+            m_abort = true;
+            goto DONE;
         }
+
+        dump_stats_on_signal();
     } while (!m_abort);
 
 DONE:
+    // Write out messages enqueued while the last batch was being processed
+    if (!queues_empty())
+        drain_queues(true);
+
     if (!m_silent_finish) {
         const msg msg(LEVEL_INFO, "", std::string("Logger thread finished"),
                       UTXX_LOG_SRCINFO);
         try { dolog_msg(msg); } catch (...) {}
     }
 
+    try { flush_impls(); } catch (...) {}
+
+    m_thread_tid.store(0, std::memory_order_release);
+
     if (m_on_after_run)
         m_on_after_run();
 }
 
+void logger::spin_wait()
+{
+    static const int s_max_pauses = 1024;
+
+    long budget = m_spin_ns;
+
+    // Spinning only pays off when the next message is expected to arrive
+    // before the spin budget runs out
+    if (m_wait_strategy == wait_strategy::ADAPTIVE)
+        budget = m_arrival_gap_ns < m_spin_ns
+               ? std::min(m_spin_ns, 2 * m_arrival_gap_ns) : 0;
+
+    time_val deadline = now_utc() + nsecs(budget);
+    int      pauses   = 1;
+
+    while (!m_abort && queues_empty()) {
+        for (int i=0; i < pauses; ++i)
+            atomic::cpu_relax();
+
+        if (m_wait_strategy == wait_strategy::SPIN) {
+            dump_stats_on_signal();
+            continue;
+        }
+
+        if (pauses < s_max_pauses)
+            pauses <<= 1;
+
+        if (now_utc() < deadline)
+            continue;
+
+        // Park until a producer wakes us up. Producers only make the futex
+        // syscall while m_parked is set.
+        int val = m_event.value();
+        m_parked.store(true, std::memory_order_seq_cst);
+        if (!m_abort && queues_empty())
+            m_event.wait(&m_wait_timeout, &val);
+        m_parked.store(false, std::memory_order_relaxed);
+
+        dump_stats_on_signal();
+        pauses = 1;
+    }
+
+    if (m_wait_strategy == wait_strategy::ADAPTIVE) {
+        // Exponentially weighted average of the time between wakeups
+        auto now = now_utc();
+        if (!m_last_arrival.empty())
+            m_arrival_gap_ns += ((now - m_last_arrival).nanoseconds() - m_arrival_gap_ns) / 8;
+        m_last_arrival = now;
+    }
+}
+
+logger::~logger()
+{
+    finalize();
+
+    m_queue.free_all(m_held);
+    m_held = nullptr;
+
+    // Queues of running threads are freed by their owners on thread exit
+    for (auto* q = m_thread_queues.exchange(nullptr); q; ) {
+        auto* next = q->m_next;
+        if (q->m_state.exchange(thread_queue::ORPHANED) != thread_queue::OWNED)
+            delete q;
+        q = next;
+    }
+}
+
+logger::thread_queue* logger::register_thread_queue()
+{
+    long tid = syscall(SYS_gettid);
+
+    // Reuse a queue abandoned by an exited thread
+    for (auto* q = m_thread_queues.load(std::memory_order_acquire); q; q = q->m_next) {
+        int state = thread_queue::FREE;
+        if (q->m_state.compare_exchange_strong(state, thread_queue::OWNED)) {
+            q->m_owner.store(tid, std::memory_order_relaxed);
+            return q;
+        }
+    }
+
+    auto* q   = new thread_queue(m_thread_queue_capacity);
+    q->m_owner.store(tid, std::memory_order_relaxed);
+    q->m_next = m_thread_queues.load(std::memory_order_relaxed);
+    while (!m_thread_queues.compare_exchange_weak(q->m_next, q));
+    return q;
+}
+
+bool logger::queues_empty() const
+{
+    if (m_held || !m_queue.empty())
+        return false;
+    for (auto* q = m_thread_queues.load(std::memory_order_acquire); q; q = q->m_next)
+        if (!q->m_ring.empty())
+            return false;
+    return true;
+}
+
+bool logger::drain_queues(bool a_final)
+{
+    static const int s_max_busy_waits = 1000;
+
+    // A message stamped before the cutoff is either in a queue by now, or is
+    // being enqueued by a thread whose queue is marked busy.  Once the busy
+    // queues are done, no older message can arrive after the snapshot below.
+    // Indices of threads retired by now can be reused once their messages
+    // (all stamped before the cutoff) are written
+    auto& threads = log_threads::instance();
+    auto  retired = threads.retired();
+    long  cutoff  = a_final ? LONG_MAX : now_utc().nanoseconds();
+    m_draining.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Snapshot the rings before the shared queue: a thread only writes to
+    // the shared queue when its ring is full, so its ring holds older messages
+    m_drain_list.clear();
+    for (auto* q = m_thread_queues.load(std::memory_order_acquire); q; q = q->m_next) {
+        for (int i=0; q->m_busy.load(std::memory_order_acquire) && i < s_max_busy_waits; ++i)
+            sched_yield();
+        auto n = q->m_ring.peek(q->m_ring.capacity()).size();
+        if (n)
+            m_drain_list.push_back(drain_item{&q->m_ring, uint32_t(n)});
+    }
+
+    // The shared queue is in the order of enqueuing, which differs from the
+    // order of timestamps when several threads write to it, so it's sorted
+    // together with messages left by the previous call
+    auto* item = m_queue.pop_all();
+    if (m_held) {
+        auto* last = m_held;
+        while (last->next())
+            last = last->next();
+        last->next(item);
+        item   = m_held;
+        m_held = nullptr;
+    }
+    if (m_thread_queue_capacity && item && item->next()) {
+        m_sort_buf.clear();
+        for (auto* p = item; p; p = p->next())
+            m_sort_buf.push_back(p);
+        std::stable_sort(m_sort_buf.begin(), m_sort_buf.end(),
+            [](concurrent_queue::node* a, concurrent_queue::node* b) {
+                return a->data().timestamp() < b->data().timestamp();
+            });
+        for (size_t i = 1; i < m_sort_buf.size(); ++i)
+            m_sort_buf[i-1]->next(m_sort_buf[i]);
+        m_sort_buf.back()->next(nullptr);
+        item = m_sort_buf.front();
+    }
+
+    // Written messages stay linked to the remaining ones and are freed with
+    // a single update of the queue's free list
+    concurrent_queue::node* done      = item;
+    concurrent_queue::node* done_last = nullptr;
+    long                    done_cnt  = 0;
+
+    while (true) {
+        // Pick the oldest message at the front of all queues.  Each queue is
+        // ordered by time, so this yields a time-ordered stream of messages.
+        // Ties are resolved in favor of rings for the same reason as above.
+        const msg*  oldest = item ? &item->data() : nullptr;
+        drain_item* src    = nullptr;
+
+        for (auto& d : m_drain_list) {
+            auto* m = d.count ? d.ring->peek() : nullptr;
+            if (m && (!oldest || m->timestamp() <= oldest->timestamp())) {
+                oldest = m;
+                src    = &d;
+            }
+        }
+
+        if (!oldest || oldest->timestamp().nanoseconds() >= cutoff)
+            break;
+
+        try   { dolog_msg(*oldest); }
+        catch ( std::exception const& e  )
+        {
+            // Unhandled error writing data to some destination
+            // Print error report to stderr (can't do anything better --
+            // the error happened in the m_on_error callback!)
+            const msg msg(LEVEL_INFO, "",
+                          std::string("Fatal exception in logger"),
+                          UTXX_LOG_SRCINFO);
+            detail::basic_buffered_print<1024> buf;
+            char  pfx[256], sfx[256];
+            char* p = format_header(msg, pfx, pfx + sizeof(pfx), m_header_cache);
+            char* q = format_footer(msg, sfx, sfx + sizeof(sfx));
+            auto ps = p - pfx;
+            auto qs = q - sfx;
+            buf.reserve(msg.m_fun.str.size() + ps + qs + 1);
+            buf.sprint(pfx, ps);
+            buf.print(msg.m_fun.str);
+            buf.sprint(sfx, qs);
+            std::cerr << buf.str() << std::endl;
+
+            // TODO: implement attempt to store transient messages to some
+            // other medium
+
+            // Free all pending messages
+            for (; item; item = item->next())
+                ++done_cnt;
+            free_queue_items(done, done_cnt);
+            for (auto& d : m_drain_list)
+                d.ring->clear();
+
+            try { flush_impls(); } catch (...) {}
+
+            m_draining.store(false, std::memory_order_seq_cst);
+            return false;
+        }
+
+        if (src) {
+            src->ring->pop();
+            --src->count;
+        } else {
+            done_last = item;
+            item      = item->next();
+            ++done_cnt;
+        }
+    }
+
+    if (done_last) {
+        done_last->next(nullptr);
+        free_queue_items(done, done_cnt);
+    }
+    m_held = item;
+    threads.reclaim(retired);
+
+    try { flush_impls(); }
+    catch ( std::exception const& e ) {
+        std::cerr << "Fatal exception flushing logger: " << e.what() << std::endl;
+        m_draining.store(false, std::memory_order_seq_cst);
+        return false;
+    }
+
+    m_draining.store(false, std::memory_order_seq_cst);
+    return true;
+}
+
+void logger::flush_impls()
+{
+    try {
+        for (auto& impl : m_implementations)
+            impl->flush();
+    } catch (std::runtime_error& e) {
+        if (m_error)
+            m_error(e.what());
+        else
+            throw;
+    }
+}
+
 void logger::finalize()
 {
     if (!m_initialized)
@@ -364,6 +702,7 @@ void logger::finalize()
         return;
 
     m_abort = true;
+    wake_logger();
     if (m_thread)
         m_thread->join();
     m_thread.reset();
@@ -376,6 +715,8 @@ void logger::do_finalize()
 {
     m_abort = true;
 
+    m_crash_fds.clear();
+
     for(auto& impl : m_implementations)
         impl.reset();
     m_implementations.clear();
@@ -383,10 +724,22 @@ void logger::do_finalize()
     auto sset = m_crash_sigset.exchange(nullptr);
     if  (sset)
         delete sset;
+
+    for (uint i=1; i < sig_names_count(); ++i)
+        if (sigismember(&m_stats_sigset, i))
+            ::signal(i, SIG_DFL);
+    sigemptyset(&m_stats_sigset);
+
+    if (m_spill_fd > -1) {
+        std::lock_guard<std::mutex> g(m_spill_mutex);
+        close(m_spill_fd);
+        m_spill_fd = -1;
+    }
 }
 
 char* logger::
-format_header(const logger::msg& a_msg, char* a_buf, const char* a_end)
+format_header(const logger::msg& a_msg, char* a_buf, const char* a_end,
+              header_cache& a_cache)
 {
     // Message mormat: Timestamp|Level|Ident|Category|Message|File:Line FunName
     // Write everything up to Message to the m_data:
@@ -394,7 +747,33 @@ format_header(const logger::msg& a_msg, char* a_buf, const char* a_end)
 
     // Write Timestamp
     if (timestamp_type() != stamp_type::NO_TIMESTAMP) {
-        p   += timestamp::format(timestamp_type(), a_msg.m_timestamp, p, a_end - p);
+        auto  tv = a_msg.m_timestamp.split();
+        auto& c  = a_cache;
+
+        if (UNLIKELY(tv.first != c.sec || timestamp_type() != c.type)) {
+            c.sec    = tv.first;
+            c.type   = timestamp_type();
+            c.len    = timestamp::format(c.type, time_val(secs(c.sec)),
+                                         c.buf, sizeof(c.buf));
+            switch (c.type) {
+                case DATE_TIME_WITH_MSEC:
+                case TIME_WITH_MSEC:        c.digits = 3; break;
+                case DATE_TIME_WITH_USEC:
+                case TIME_WITH_USEC:        c.digits = 6; break;
+                case DATE_TIME_WITH_NSEC:
+                case TIME_WITH_NSEC:        c.digits = 9; break;
+                default:                    c.digits = 0; break;
+            }
+        }
+
+        memcpy(p, c.buf, c.len);
+        p += c.len;
+
+        switch (c.digits) {
+            case 3: itoa_right<long, 3>(p - 3, tv.second / 1000000, '0'); break;
+            case 6: itoa_right<long, 6>(p - 6, tv.second / 1000,    '0'); break;
+            case 9: itoa_right<long, 9>(p - 9, tv.second,           '0'); break;
+        }
         *p++ = '|';
     }
     // Write Level
@@ -405,22 +784,181 @@ format_header(const logger::msg& a_msg, char* a_buf, const char* a_end)
         *p++ = '|';
     }
     if (show_thread()) {
-        if (a_msg.m_thread_name[0] == '\0') {
-            char* q = const_cast<char*>(a_msg.m_thread_name);
-            itoa(a_msg.m_thread_id, q, 10);
-        }
-        p = stpcpy(p, a_msg.m_thread_name);
+        char name[log_threads::s_max_name_len];
+        p = stpcpy(p, a_msg.thread_name(name));
         *p++ = '|';
     }
     if (show_category()) {
-        if (!a_msg.m_category.empty())
-            p = stpncpy(p, a_msg.m_category.c_str(), a_msg.m_category.size());
+        if (!a_msg.m_category.empty()) {
+            auto& cat = a_msg.category();
+            p = stpncpy(p, cat.c_str(), cat.size());
+        }
         *p++ = '|';
     }
 
     return p;
 }
 
+char* logger::
+format_crash_msg(const logger::msg& a_msg, char* a_buf, const char* a_end) const
+{
+    // Format: YYYYmmdd-HH:MM:SS.uuuuuu|Level|Category|Message\n
+    // using only integer arithmetic and memcpy
+    static const size_t s_hdr_len = 27;
+
+    char* p = a_buf;
+    if (a_end - p < long(s_hdr_len + 2))
+        return p;
+
+    auto tv   = a_msg.m_timestamp.split();
+    long secs = tv.first + m_utc_offset;
+    long days = secs / 86400;
+    long tod  = secs % 86400;
+
+    // Convert days since epoch to a civil date (H. Hinnant's algorithm)
+    long     z   = days + 719468;
+    long     era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = unsigned(z - era * 146097);
+    unsigned yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+    unsigned doy = doe - (365*yoe + yoe/4 - yoe/100);
+    unsigned mp  = (5*doy + 2) / 153;
+    unsigned d   = doy - (153*mp + 2)/5 + 1;
+    unsigned m   = mp < 10 ? mp + 3 : mp - 9;
+    long     y   = long(yoe) + era * 400 + (m <= 2);
+
+    itoa_right<long, 4>(p,    y, '0');
+    itoa_right<long, 2>(p+4,  m, '0');
+    itoa_right<long, 2>(p+6,  d, '0');
+    p[8]  = '-';
+    itoa_right<long, 2>(p+9,  tod / 3600,      '0');
+    p[11] = ':';
+    itoa_right<long, 2>(p+12, tod % 3600 / 60, '0');
+    p[14] = ':';
+    itoa_right<long, 2>(p+15, tod % 60,        '0');
+    p[17] = '.';
+    itoa_right<long, 6>(p+18, tv.second / 1000, '0');
+    p[24] = '|';
+    p[25] = log_level_to_cstr(a_msg.m_level)[0];
+    p[26] = '|';
+    p    += s_hdr_len;
+
+    // Everything that follows is truncated to fit in the buffer
+    auto append = [&p, a_end](const char* a_str, size_t a_sz) {
+        size_t n = std::min<size_t>(a_sz, a_end - p - 1);
+        memcpy(p, a_str, n);
+        p += n;
+    };
+
+    if (show_category()) {
+        auto& cat = a_msg.category();
+        append(cat.c_str(), cat.size());
+        append("|", 1);
+    }
+
+    switch (a_msg.m_type) {
+        case payload_t::STR:
+            append(a_msg.m_fun.str.c_str(), a_msg.m_fun.str.size());
+            break;
+#ifdef UTXX_LOGGER_DEFERRED
+        case payload_t::BIN:
+            // Argument formatting may not be async-signal-safe
+            if (auto fmt = a_msg.m_fun.rec.fmt())
+                append(fmt, strlen(fmt));
+            else
+                append("<deferred message>", 18);
+            break;
+#endif
+        default:
+            // Calling user-provided formatters is not async-signal-safe
+            append("<unformatted message>", 21);
+            break;
+    }
+
+    while (p > a_buf + s_hdr_len && p[-1] == '\n')
+        --p;
+    *p++ = '\n';
+    return p;
+}
+
+int logger::flush_on_crash()
+{
+    if (!m_crash_buf || m_crash_flushed.exchange(true))
+        return 0;
+
+    char*       buf = m_crash_buf.get();
+    const char* end = buf + m_crash_buf_size;
+    char*       p   = buf;
+    int         n   = 0;
+
+    auto write_out = [this, buf, &p]() {
+        for (int fd : m_crash_fds)
+            for (const char* q = buf; q < p; ) {
+                auto n = ::write(fd, q, p - q);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    break;
+                q += n;
+            }
+        p = buf;
+    };
+
+    long self = syscall(SYS_gettid);
+    long tid  = m_thread_tid.load(std::memory_order_acquire);
+
+    auto add = [this, buf, end, self, tid, &p, &n, &write_out](const msg& a_msg) {
+        // Write out the buffer unless the message is likely to fit in it
+        auto len = 64 + a_msg.category().size() +
+                   (a_msg.m_type == payload_t::STR ? a_msg.m_fun.str.size() : 0);
+        if (p != buf && p + len > end)
+            write_out();
+        char* q = p;
+        p = format_crash_msg(a_msg, p, end);
+        for (auto& impl : m_implementations)
+            impl->crash_write(a_msg, q, p - q, self == tid);
+        ++n;
+    };
+
+    // Messages are not popped from the rings, and the items of the shared
+    // queue are not freed, since destroying them isn't async-signal-safe
+    if (self == tid) {
+        // The logger's thread is interrupted, so the data it owns can be
+        // read here. Messages already passed to the backends come first.
+        for (auto& impl : m_implementations)
+            impl->crash_flush();
+        for (auto* item = m_held; item; item = item->next())
+            add(item->data());
+        for (auto* q = m_thread_queues.load(std::memory_order_acquire); q; q = q->m_next) {
+            auto r = q->m_ring.peek(q->m_ring.capacity());
+            for (size_t i = 0; i < r.size(); ++i)
+                add(r[i]);
+        }
+    } else if (tid) {
+        // The logger's thread is the only consumer of the rings, so let it
+        // write out the ring of this thread (which may be left busy by the
+        // crash) and finish the current pass, which flushes the backends
+        thread_queue* own = nullptr;
+        for (auto* q = m_thread_queues.load(std::memory_order_acquire); q; q = q->m_next)
+            if (q->m_owner.load(std::memory_order_relaxed) == self)
+                own = q;
+
+        static const struct timespec s_ms = {0, 1000000};
+        for (int i = 0; i < m_crash_wait_ms; ++i) {
+            if ((!own || own->m_ring.empty()) &&
+                !m_draining.load(std::memory_order_seq_cst))
+                break;
+            m_event.signal();
+            nanosleep(&s_ms, nullptr);
+        }
+    }
+
+    for (auto* item = m_queue.pop_all(); item; item = item->next())
+        add(item->data());
+
+    write_out();
+    return n;
+}
+
 char* logger::
 format_footer(const logger::msg& a_msg, char* a_buf, const char* a_end)
 {
@@ -450,69 +988,92 @@ format_footer(const logger::msg& a_msg, char* a_buf, const char* a_end)
     return p;
 }
 
+template <typename Sink>
+void logger::format_msg(const logger::msg& a_msg, header_cache& a_cache,
+                        const Sink& a_sink)
+{
+    switch (a_msg.m_type) {
+        case payload_t::CHAR_FUN: {
+            assert(a_msg.m_fun.cf);
+            char  buf[4096];
+            auto* end = buf + sizeof(buf);
+            char*   p = format_header(a_msg, buf,  end, a_cache);
+            int     n = (a_msg.m_fun.cf)(p,  end - p);
+            if (p[n-1] == '\n') --p;
+            p = format_footer(a_msg, p+n,  end);
+            a_sink(buf, p - buf);
+            break;
+        }
+#ifdef UTXX_LOGGER_DEFERRED
+        case payload_t::BIN: {
+            char  buf[4096];
+            auto* end = buf + sizeof(buf);
+            char*   p = format_header(a_msg, buf,  end, a_cache);
+            // Leave enough space for the footer
+            auto* lim = std::max(p, end - 256);
+            int     n = a_msg.m_fun.rec.format(p, lim - p);
+            while (n && p[n-1] == '\n') --n;
+            p = format_footer(a_msg, p+n,  end);
+            a_sink(buf, p - buf);
+            break;
+        }
+#else
+        case payload_t::BIN:
+            break;
+#endif
+        case payload_t::STR_FUN: {
+            assert(a_msg.m_fun.cf);
+            char  pfx[256], sfx[256];
+            char*   p = format_header(a_msg, pfx, pfx + sizeof(pfx), a_cache);
+            char*   q = format_footer(a_msg, sfx, sfx + sizeof(sfx));
+            auto  res = (a_msg.m_fun.sf)(pfx, p - pfx, sfx, q - sfx);
+            a_sink(res.c_str(), res.size());
+            break;
+        }
+        case payload_t::STR: {
+            detail::basic_buffered_print<1024> buf;
+            char  pfx[256], sfx[256];
+            char* p = format_header(a_msg, pfx, pfx + sizeof(pfx), a_cache);
+            char* q = format_footer(a_msg, sfx, sfx + sizeof(sfx));
+            auto ps = p - pfx;
+            auto qs = q - sfx;
+            buf.reserve(a_msg.m_fun.str.size() + ps + qs + 1);
+            buf.sprint(pfx, ps);
+            auto& s = a_msg.m_fun.str;
+            // Remove trailing new lines
+            auto sz = int(s.size());
+            while (sz && s[sz-1] == '\n') --sz;
+            buf.sprint(s.c_str(), sz);
+            buf.sprint(sfx, qs);
+            a_sink(buf.str(), buf.size());
+            break;
+        }
+    }
+}
+
 void logger::dolog_msg(const logger::msg& a_msg) {
-    try {
-        switch (a_msg.m_type) {
-            case payload_t::CHAR_FUN: {
-                assert(a_msg.m_fun.cf);
-                char  buf[4096];
-                auto* end = buf + sizeof(buf);
-                char*   p = format_header(a_msg, buf,  end);
-                int     n = (a_msg.m_fun.cf)(p,  end - p);
-                if (p[n-1] == '\n') --p;
-                p = format_footer(a_msg, p+n,  end);
-                m_sig_slot[level_to_signal_slot(a_msg.level())](
-                    on_msg_delegate_t::invoker_type(a_msg, buf, p - buf));
-
-                if (fatal_kill_signal() && a_msg.level() == LEVEL_FATAL) {
-                    m_abort = true;
-                    dolog_fatal_msg(buf, p - buf);
-                }
+    time_val dequeued;
+    if (unlikely(m_latency_stats)) {
+        dequeued = now_utc();
+        m_queue_latency.add((dequeued - a_msg.m_timestamp).nanoseconds());
+    }
 
-                break;
-            }
-            case payload_t::STR_FUN: {
-                assert(a_msg.m_fun.cf);
-                char  pfx[256], sfx[256];
-                char*   p = format_header(a_msg, pfx, pfx + sizeof(pfx));
-                char*   q = format_footer(a_msg, sfx, sfx + sizeof(sfx));
-                auto  res = (a_msg.m_fun.sf)(pfx, p - pfx, sfx, q - sfx);
-                m_sig_slot[level_to_signal_slot(a_msg.level())](
-                    on_msg_delegate_t::invoker_type(a_msg, res.c_str(), res.size()));
-
-                if (fatal_kill_signal() && a_msg.level() == LEVEL_FATAL) {
-                    m_abort = true;
-                    dolog_fatal_msg(res.c_str(), res.size());
-                }
+    try {
+        format_msg(a_msg, m_header_cache,
+                   [this, &a_msg, dequeued](const char* a_buf, size_t a_sz) {
+            auto slot = level_to_signal_slot(a_msg.level());
+            on_msg_delegate_t::invoker_type inv(a_msg, a_buf, a_sz);
 
-                break;
-            }
-            case payload_t::STR: {
-                detail::basic_buffered_print<1024> buf;
-                char  pfx[256], sfx[256];
-                char* p = format_header(a_msg, pfx, pfx + sizeof(pfx));
-                char* q = format_footer(a_msg, sfx, sfx + sizeof(sfx));
-                auto ps = p - pfx;
-                auto qs = q - sfx;
-                buf.reserve(a_msg.m_fun.str.size() + ps + qs + 1);
-                buf.sprint(pfx, ps);
-                auto& s = a_msg.m_fun.str;
-                // Remove trailing new lines
-                auto sz = int(s.size());
-                while (sz && s[sz-1] == '\n') --sz;
-                buf.sprint(s.c_str(), sz);
-                buf.sprint(sfx, qs);
-                m_sig_slot[level_to_signal_slot(a_msg.level())](
-                    on_msg_delegate_t::invoker_type(a_msg, buf.str(), buf.size()));
-
-                if (fatal_kill_signal() && a_msg.level() == LEVEL_FATAL) {
-                    m_abort = true;
-                    dolog_fatal_msg(buf.c_str(), buf.size());
-                }
+            if (likely(!m_latency_stats))
+                m_sig_slot[slot](inv);
+            else
+                emit_timed(slot, inv, dequeued);
 
-                break;
+            if (fatal_kill_signal() && a_msg.level() == LEVEL_FATAL) {
+                m_abort = true;
+                dolog_fatal_msg(a_buf, a_sz);
             }
-        }
+        });
     } catch (std::runtime_error& e) {
         if (m_error)
             m_error(e.what());
@@ -521,12 +1082,124 @@ void logger::dolog_msg(const logger::msg& a_msg) {
     }
 }
 
+void logger::emit_timed(int a_slot, const on_msg_delegate_t::invoker_type& a_inv,
+                        time_val a_start)
+{
+    auto t = now_utc();
+    m_format_latency.add((t - a_start).nanoseconds());
+
+    m_sig_slot[a_slot].emit_with_id([&](int a_id, on_msg_delegate_t& a_sink) {
+        a_inv(a_sink);
+        auto now = now_utc();
+        for (auto& impl : m_implementations)
+            if (impl->m_msg_sink_id[a_slot] == a_id) {
+                impl->m_write_latency.add((now - t).nanoseconds());
+                break;
+            }
+        t = now;
+    });
+}
+
+void logger::on_stats_signal(int)
+{
+    s_dump_stats.store(true, std::memory_order_relaxed);
+}
+
+void logger::dump_stats_on_signal()
+{
+    if (likely(!s_dump_stats.load(std::memory_order_relaxed)) ||
+        !s_dump_stats.exchange(false))
+        return;
+
+    std::stringstream s;
+    stats().dump(s);
+
+    std::string line;
+    while (std::getline(s, line)) {
+        const msg msg(LEVEL_INFO, "", "Latency " + line, UTXX_LOG_SRCINFO);
+        try { dolog_msg(msg); } catch (...) {}
+    }
+    try { flush_impls(); } catch (...) {}
+}
+
+logger_stats logger::stats() const
+{
+    logger_stats res;
+    res.queue  = m_queue_latency;
+    res.format = m_format_latency;
+    for (auto& impl : m_implementations)
+        res.backends.push_back(logger_stats::backend{impl->name(), impl->m_write_latency});
+    return res;
+}
+
+void logger::reset_stats()
+{
+    m_queue_latency.reset();
+    m_format_latency.reset();
+    for (auto& impl : m_implementations)
+        impl->m_write_latency.reset();
+}
+
+bool logger::on_queue_full(log_level a_level)
+{
+    switch (m_queue_overflow) {
+        case overflow_policy::BLOCK:
+            // Nobody would free room for the logger's own thread (e.g. a
+            // message logged by a backend), so it drops or spills instead
+            if (in_logger_thread())
+                break;
+            // The counter includes this and other blocked producers, so
+            // wait until all of them fit in the queue
+            while (m_queue_size.load(std::memory_order_acquire) > m_queue_capacity &&
+                   !m_abort && m_initialized) {
+                wake_logger();
+                sched_yield();
+            }
+            return true;
+        case overflow_policy::DROP_BY_LEVEL:
+            // Important messages are queued past the capacity
+            if (a_level >= m_queue_overflow_level)
+                return true;
+            break;
+        default:
+            break;
+    }
+    m_queue_size.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool logger::spill_msg(const logger::msg& a_msg)
+{
+    std::lock_guard<std::mutex> g(m_spill_mutex);
+    if (m_spill_fd < 0)
+        return false;
+    bool res = true;
+    try {
+        format_msg(a_msg, m_spill_cache, [this, &res](const char* a_buf, size_t a_sz) {
+            res = write(m_spill_fd, a_buf, a_sz) == ssize_t(a_sz);
+        });
+    } catch (std::exception const&) {
+        return false;
+    }
+    return res;
+}
+
+long logger::dropped() const
+{
+    long n = 0;
+    for (auto& d : m_dropped)
+        n += d.load(std::memory_order_relaxed);
+    return n;
+}
+
 void logger::dolog_fatal_msg(const char* buf, size_t sz)
 {
     // Expecting a Rethrowing signal string of
     // this format
     // (signal number)
 
+    try { flush_impls(); } catch (...) {}
+
     int   signum    = fatal_kill_signal(); //DEFAULT SIGNAL SIGABRT
     char* signo_str = (char*)memchr(static_cast<const void*>(buf), '(', sz);
 
@@ -545,11 +1218,14 @@ void logger::dolog_fatal_msg(const char* buf, size_t sz)
 void logger::delete_impl(const std::string& a_name)
 {
     std::lock_guard<std::mutex> guard(logger_impl_mgr::instance().mutex());
+    // erase() invalidates the iterators, so the loop can't go on past it
     for (implementations_vector::iterator
             it = m_implementations.begin(), end = m_implementations.end();
             it != end; ++it)
-        if ((*it)->name() == a_name)
+        if ((*it)->name() == a_name) {
             m_implementations.erase(it);
+            break;
+        }
 }
 
 const logger_impl* logger::get_impl(const std::string& a_name) const
@@ -593,7 +1269,12 @@ std::ostream& logger::dump(std::ostream& out) const
         << "    show-ident          = " << val(m_show_ident)            << '\n'
         << "    show-thread         = " << val(m_show_thread)           << '\n'
         << "    ident               = " << m_ident                      << '\n'
-        << "    timestamp-type      = " << to_string(m_timestamp_type)  << '\n';
+        << "    timestamp-type      = " << to_string(m_timestamp_type)  << '\n'
+        << "    deferred-format     = " << val(m_deferred_format)       << '\n'
+        << "    thread-queue-capacity = " << m_thread_queue_capacity    << '\n'
+        << "    queue-capacity      = " << m_queue_capacity             << '\n'
+        << "    latency-stats       = " << val(m_latency_stats)         << '\n'
+        << "    wait-strategy       = " << to_string(m_wait_strategy)   << '\n';
 
     // Check the list of registered implementations. If corresponding
     // configuration section is found, initialize the implementation.
@@ -0,0 +1,123 @@
+//------------------------------------------------------------------------------
+/// \file   logger_category.cpp
+/// \author agent
+//------------------------------------------------------------------------------
+/// \brief Registry of interned log categories.
+//------------------------------------------------------------------------------
+// Copyright (C) 2026 agent <agent@local>
+// Created: 2026-10-17
+//------------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <utxx/logger/logger_category.hpp>
+
+namespace utxx {
+
+constexpr size_t log_categories::s_max_categories;
+
+//------------------------------------------------------------------------------
+log_categories::log_categories()
+    : m_count(1)
+    , m_overflows(0)
+{
+    for (auto& p : m_names) p.store(nullptr, std::memory_order_relaxed);
+    for (auto& p : m_table) p.store(nullptr, std::memory_order_relaxed);
+
+    // Category with ID 0 is the empty category
+    m_names[0].store(new entry{std::string(), hash("", 0), 0},
+                     std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+log_categories::~log_categories()
+{
+    for (auto& p : m_names)
+        delete p.load(std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+const log_categories::entry*
+log_categories::lookup(const char* a_name, size_t a_len, size_t a_hash,
+                       size_t& a_slot) const
+{
+    for (a_slot = a_hash % s_table_size;; a_slot = (a_slot + 1) % s_table_size) {
+        auto e = m_table[a_slot].load(std::memory_order_acquire);
+        if (!e)
+            return nullptr;
+        if (e->hash == a_hash && e->name.size() == a_len &&
+            memcmp(e->name.c_str(), a_name, a_len) == 0)
+            return e;
+    }
+}
+
+//------------------------------------------------------------------------------
+int log_categories::find(const char* a_name, size_t a_len) const
+{
+    if (!a_len)
+        return 0;
+    size_t slot;
+    auto   e = lookup(a_name, a_len, hash(a_name, a_len), slot);
+    return e ? e->id : -1;
+}
+
+//------------------------------------------------------------------------------
+uint16_t log_categories::intern(const char* a_name, size_t a_len)
+{
+    if (!a_len)
+        return 0;
+
+    size_t slot;
+    auto   h = hash(a_name, a_len);
+    auto   e = lookup(a_name, a_len, h, slot);
+
+    if (e)
+        return e->id;
+
+    // Categories made up at run time mustn't make logging calls throw, so
+    // the names that don't fit are logged with the empty category
+    if (unlikely(m_count.load(std::memory_order_acquire) >= s_max_categories)) {
+        m_overflows.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    // Repeat the lookup, since another thread could've added the same name
+    if ((e = lookup(a_name, a_len, h, slot)) != nullptr)
+        return e->id;
+
+    auto id = m_count.load(std::memory_order_relaxed);
+    if (id >= s_max_categories) {
+        m_overflows.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    e = new entry{std::string(a_name, a_len), h, uint16_t(id)};
+    m_names[id].store(e, std::memory_order_release);
+    m_table[slot].store(e, std::memory_order_release);
+    m_count.store(id+1, std::memory_order_release);
+    return e->id;
+}
+
+} // namespace utxx
@@ -75,6 +75,10 @@ namespace {
     // Ref: http://stackoverflow.com/questions/77005/how-to-generate-a-stacktrace-when-my-gcc-c-app-crashes
     void crash_handler(int a_signo, siginfo_t* a_info, void* a_context)
     {
+        // Write out queued messages before doing anything that may not be
+        // async-signal-safe and could hang or crash again
+        logger::instance().flush_on_crash();
+
         std::ostringstream oss;
 
     #if !(defined(WIN33) || defined(_WIN32) || defined(__WIN32__))
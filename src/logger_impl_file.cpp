@@ -56,7 +56,9 @@ std::ostream& logger_impl_file::dump(std::ostream& out,
            a_prefix << "    symlink        = " << m_symlink << '\n';
     out << a_prefix << "    levels         = " << logger::log_levels_to_str(m_levels) << '\n'
         << a_prefix << "    use-mutex      = " << (m_use_mutex ? "true" : "false")    << '\n'
-        << a_prefix << "    no-header      = " << (m_no_header ? "true" : "false")    << '\n';
+        << a_prefix << "    no-header      = " << (m_no_header ? "true" : "false")    << '\n'
+        << a_prefix << "    batch-size     = " << m_batch_size       << '\n'
+        << a_prefix << "    sync-interval-ms = " << m_sync_interval_ms << '\n';
     return out;
 }
 
@@ -82,6 +84,13 @@ bool logger_impl_file::init(const variant_tree& a_config)
     m_no_header     = a_config.get("logger.file.no-header", false);
     m_mode          = a_config.get("logger.file.mode",       0644);
     m_symlink       = a_config.get("logger.file.symlink",      "");
+    m_batch_size    = a_config.get("logger.file.batch-size",    0);
+    m_sync_interval_ms = a_config.get("logger.file.sync-interval-ms", 0);
+    m_next_sync     = now_utc() + msecs(m_sync_interval_ms);
+
+    m_batch.clear();
+    if (m_batch_size)
+        m_batch.reserve(m_batch_size);
     auto levels     = a_config.get("logger.file.levels",       "");
 
     m_levels = levels.empty()
@@ -174,9 +183,70 @@ public:
     }
 };
 
+void logger_impl_file::write_all(const char* a_buf, size_t a_size)
+    throw(io_error)
+{
+    while (a_size) {
+        auto n = write(m_fd, a_buf, a_size);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            throw io_error(errno, "Error writing to file: ", m_filename);
+        }
+        a_buf  += n;
+        a_size -= n;
+    }
+}
+
+void logger_impl_file::flush()
+{
+    if (m_batch.empty() || m_fd < 0)
+        return;
+
+    // The batch is discarded even if writing fails, so that it isn't retried
+    try   { write_all(m_batch.c_str(), m_batch.size()); }
+    catch (...) { m_batch.clear(); throw; }
+    m_batch.clear();
+
+    if (m_sync_interval_ms) {
+        auto now = now_utc();
+        if (now >= m_next_sync) {
+            fdatasync(m_fd);
+            m_next_sync = now + msecs(m_sync_interval_ms);
+        }
+    }
+}
+
+void logger_impl_file::crash_flush()
+{
+    // The batch isn't cleared, since that's not needed by a dying process
+    const char* p = m_batch.data();
+    const char* e = p + m_batch.size();
+    while (m_fd >= 0 && p < e) {
+        auto n = ::write(m_fd, p, e - p);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        p += n;
+    }
+}
+
 void logger_impl_file::log_msg(const logger::msg& a_msg, const char* a_buf, size_t a_size)
     throw(io_error)
 {
+    // In the batching mode this method is only called by the logger's
+    // thread, so no locking is needed
+    if (m_batch_size) {
+        if (m_batch.size() + a_size > m_batch_size)
+            flush();
+        if (a_size >= m_batch_size)
+            write_all(a_buf, a_size);
+        else
+            m_batch.append(a_buf, a_size);
+        return;
+    }
+
     // See begining-of-file comment on thread-safety of the concurrent write(2) call.
     // Note that since the use of mutex is conditional, we can't use the
     // boost::lock_guard<boost::mutex> guard and roll out our own.
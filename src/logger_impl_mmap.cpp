@@ -0,0 +1,114 @@
+//----------------------------------------------------------------------------
+/// \file  logger_impl_mmap.cpp
+//----------------------------------------------------------------------------
+/// \brief Back-end plugin writing log records to a memory-mapped ring file
+/// for the <tt>logger</tt> class.
+//----------------------------------------------------------------------------
+// Copyright (c) 2026 agent <agent@local>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <utxx/logger/logger_impl_mmap.hpp>
+#include <utxx/logger/logger_impl.hpp>
+
+namespace utxx {
+
+static logger_impl_mgr::impl_callback_t f = &logger_impl_mmap::create;
+static logger_impl_mgr::registrar reg("mmap", f);
+
+std::ostream& logger_impl_mmap::dump(std::ostream& out,
+    const std::string& a_prefix) const
+{
+    out << a_prefix << "logger." << name() << '\n'
+        << a_prefix << "    filename       = " << m_filename << '\n'
+        << a_prefix << "    size-mb        = " << m_size_mb  << '\n'
+        << a_prefix << "    append         = " << (m_append ? "true" : "false") << '\n'
+        << a_prefix << "    mode           = " << m_mode << '\n'
+        << a_prefix << "    levels         = " << logger::log_levels_to_str(m_levels) << '\n';
+    return out;
+}
+
+bool logger_impl_mmap::init(const variant_tree& a_config)
+    throw(badarg_error, io_error)
+{
+    BOOST_ASSERT(this->m_log_mgr);
+    finalize();
+
+    try {
+        m_filename = a_config.get<std::string>("logger.mmap.filename");
+        m_filename = m_log_mgr->replace_macros(m_filename);
+    } catch (boost::property_tree::ptree_bad_data&) {
+        throw badarg_error("logger.mmap.filename not specified");
+    }
+
+    m_size_mb = a_config.get("logger.mmap.size-mb", 16);
+    m_append  = a_config.get("logger.mmap.append",  true);
+    m_mode    = a_config.get("logger.mmap.mode",    0644);
+    auto levels = a_config.get("logger.mmap.levels",  "");
+
+    if (!m_size_mb)
+        throw badarg_error("logger.mmap.size-mb must be positive");
+
+    m_levels = levels.empty()
+             ? m_log_mgr->level_filter()
+             : logger::parse_log_levels(levels);
+
+    if (m_levels != NOLOGGING) {
+        if (m_ring.create(m_filename, m_size_mb << 20, !m_append, m_mode) < 0)
+            UTXX_THROW_IO_ERROR(errno, "Error opening ring file ", m_filename);
+
+        // Install log_msg callbacks from appropriate levels
+        for(int lvl = 0; lvl < logger::NLEVELS; ++lvl) {
+            log_level level = logger::signal_slot_to_level(lvl);
+            if ((m_levels & static_cast<int>(level)) != 0)
+                this->add(level,
+                    logger::on_msg_delegate_t::from_method
+                        <logger_impl_mmap, &logger_impl_mmap::log_msg>(this));
+        }
+    }
+    return true;
+}
+
+void logger_impl_mmap::log_msg(const logger::msg& a_msg, const char* a_buf, size_t a_size)
+    throw(io_error)
+{
+    // Backends are invoked by the logger's thread only, so the ring's lock
+    // is contended only by crash_write()
+    m_ring.write(a_buf, a_size);
+}
+
+void logger_impl_mmap::crash_write(const logger::msg& a_msg,
+    const char* a_buf, size_t a_size, bool a_logger_thread)
+{
+    if (!m_ring.is_open() || !(m_levels & static_cast<int>(a_msg.level())))
+        return;
+
+    // The interrupted logger's thread may hold the ring's lock, which it
+    // will never release, so don't wait for it. Otherwise let the logger's
+    // thread finish the record being written.
+    m_ring.write(a_buf, a_size, a_logger_thread ? 0 : 1 << 20);
+}
+
+} // namespace utxx
@@ -40,6 +40,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
 #include <boost/format.hpp>
 #include <utxx/url.hpp>
 
@@ -56,18 +58,53 @@ static logger_impl_mgr::registrar reg("scribe", f);
 logger_impl_scribe::logger_impl_scribe(const char* a_name)
     : m_name(a_name)
     , m_server_addr("uds:///var/run/scribed")
+    , m_server_timeout(DEFAULT_TIMEOUT)
     , m_levels(LEVEL_NO_DEBUG)
+    , m_batch_size(64)
+    , m_batch_age_ms(100)
+    , m_spool_size(100000)
+    , m_reconnect_min_ms(100)
+    , m_reconnect_max_ms(30000)
+    , m_spill_fd(-1)
+    , m_stop(true)
     , m_reconnecting(0)
-    , m_engine_ptr(new async_logger_engine())
-    , m_engine(m_engine_ptr.get())
+    , m_backoff_ms(0)
+    , m_sent(0)
+    , m_spilled(0)
+    , m_dropped(0)
 {}
 
 void logger_impl_scribe::finalize()
 {
-    if (m_engine && !m_engine->running()) {
-        m_engine->close_file(m_fd);
-        m_engine->stop();
+    // The logger's thread may still be calling log_msg(), which spills the
+    // messages once m_stop is set
+    {
+        std::lock_guard<std::mutex> g(m_mutex);
+        m_stop = true;
+    }
+
+    if (m_thread.joinable()) {
+        m_cond.notify_one();
+        m_thread.join();
+    }
+
+    // Whatever couldn't be delivered goes to the spill file
+    std::vector<log_item> rest;
+    {
+        std::lock_guard<std::mutex> g(m_mutex);
+        rest.assign(std::make_move_iterator(m_spool.begin()),
+                    std::make_move_iterator(m_spool.end()));
+        m_spool.clear();
     }
+    if (!rest.empty())
+        spill(rest.data(), rest.size());
+
+    std::lock_guard<std::mutex> g(m_spill_mutex);
+    if (m_spill_fd > -1) {
+        ::close(m_spill_fd);
+        m_spill_fd = -1;
+    }
+
     disconnect();
 }
 
@@ -77,7 +114,13 @@ std::ostream& logger_impl_scribe::dump(std::ostream& out,
     out << a_prefix << "logger." << name() << '\n'
         << a_prefix << "    address        = " << m_server_addr.to_string() << '\n'
         << a_prefix << "    timeout        = " << m_server_timeout << '\n'
-        << a_prefix << "    levels         = " << logger::log_levels_to_str(m_levels) << '\n';
+        << a_prefix << "    levels         = " << logger::log_levels_to_str(m_levels) << '\n'
+        << a_prefix << "    batch-size     = " << m_batch_size   << '\n'
+        << a_prefix << "    batch-age-ms   = " << m_batch_age_ms << '\n'
+        << a_prefix << "    spool-size     = " << m_spool_size   << '\n'
+        << a_prefix << "    spill-file     = " << m_spill_file   << '\n'
+        << a_prefix << "    reconnect-min-ms = " << m_reconnect_min_ms << '\n'
+        << a_prefix << "    reconnect-max-ms = " << m_reconnect_max_ms << '\n';
     return out;
 }
 
@@ -91,11 +134,6 @@ bool logger_impl_scribe::init(const variant_tree& a_config)
 {
     ::apache::thrift::GlobalOutput.setOutputFunction(&thrift_output);
 
-    if (!m_engine)
-        throw utxx::runtime_error
-            ("Scribe logging engine not initialized "
-             "(missing a call to utxx::logger_impl_scribe::set_engine())!");
-
     finalize();
 
     std::stringstream str;
@@ -109,55 +147,61 @@ bool logger_impl_scribe::init(const variant_tree& a_config)
         throw std::runtime_error(
             std::string("Invalid scribe server address [logger.scribe.address]: ") + url);
 
-    m_server_timeout= a_config.get<int>("logger.scribe.timeout", DEFAULT_TIMEOUT);
+    m_server_timeout  = a_config.get<int>("logger.scribe.timeout", DEFAULT_TIMEOUT);
+    m_batch_size      = a_config.get("logger.scribe.batch-size",       64);
+    m_batch_age_ms    = a_config.get("logger.scribe.batch-age-ms",     100);
+    m_spool_size      = a_config.get("logger.scribe.spool-size",       100000);
+    m_reconnect_min_ms= a_config.get("logger.scribe.reconnect-min-ms", 100);
+    m_reconnect_max_ms= a_config.get("logger.scribe.reconnect-max-ms", 30000);
+    m_spill_file      = a_config.get<std::string>("logger.scribe.spill-file", "");
+
+    if (!m_batch_size)
+        throw badarg_error("logger.scribe.batch-size must be positive");
+    if (m_spool_size < m_batch_size)
+        throw badarg_error("logger.scribe.spool-size must not be less than batch-size");
+    if (m_reconnect_min_ms <= 0 || m_reconnect_max_ms < m_reconnect_min_ms)
+        throw badarg_error("Invalid logger.scribe.reconnect-min-ms/reconnect-max-ms");
 
     // See comments in the beginning of the logger_impl_scribe.hpp on
     // thread safety.
     m_levels        = logger::parse_log_levels(a_config.get<std::string>(
                         "logger.scribe.levels", logger::default_log_levels));
 
-    if (m_levels != NOLOGGING) {
-        try {
-            connect();
-        } catch (const std::exception& e) {
-            throw utxx::runtime_error
-                ("Failed to open connection to scribe server ", m_server_addr,
-                 ':', e.what());
-        }
+    if (m_levels == NOLOGGING)
+        return true;
 
-        // If this implementation started as part of the logging framework,
-        // install it in the slots of the logger for use with LOG_* macros
-        if (m_log_mgr) {
-            // Install log_msg callbacks from appropriate levels
-            for(int lvl = 0; lvl < logger::NLEVELS; ++lvl) {
-                log_level level = logger::signal_slot_to_level(lvl);
-                if ((m_levels & static_cast<int>(level)) != 0)
-                    this->add(level,
-                        logger::on_msg_delegate_t::from_method<
-                            logger_impl_scribe, &logger_impl_scribe::log_msg>(this));
-            }
-        }
+    if (!m_spill_file.empty()) {
+        if (m_log_mgr)
+            m_spill_file = m_log_mgr->replace_macros(m_spill_file);
+        m_spill_fd = ::open(m_spill_file.c_str(),
+                            O_CREAT|O_WRONLY|O_APPEND|O_LARGEFILE, 0644);
+        if (m_spill_fd < 0)
+            UTXX_THROW_IO_ERROR(errno, "Error opening spill file ", m_spill_file);
     }
 
-    m_fd = m_engine->open_stream(m_name.c_str(),
-                                 [this](async_logger_engine::stream_info& a_si,
-                                         const char** a_categories,
-                                         const iovec* a_data, size_t a_size) {
-                                    return this->writev
-                                        (a_si, a_categories, a_data, a_size);
-                                 },
-                                 nullptr,
-                                 m_socket->getSocketFD()
-                                );
-    if (!m_fd)
-        throw std::runtime_error("Error opening scribe logging stream!");
-
-    m_engine->set_reconnect
-        (m_fd, [this](typename async_logger_engine::stream_info& a_si) {
-                    return this->on_reconnect(a_si);
-               });
-
-    m_engine->start();
+    m_stop         = false;
+    m_reconnecting = 0;
+    m_backoff_ms   = 0;
+    m_next_attempt = time_val();
+
+    // A server that is down at startup doesn't fail initialization:
+    // messages are spooled while the sender thread reconnects with backoff
+    reconnect(now_utc());
+
+    m_thread       = std::thread([this]() { run(); });
+
+    // If this implementation started as part of the logging framework,
+    // install it in the slots of the logger for use with LOG_* macros
+    if (m_log_mgr) {
+        // Install log_msg callbacks from appropriate levels
+        for(int lvl = 0; lvl < logger::NLEVELS; ++lvl) {
+            log_level level = logger::signal_slot_to_level(lvl);
+            if ((m_levels & static_cast<int>(level)) != 0)
+                this->add(level,
+                    logger::on_msg_delegate_t::from_method<
+                        logger_impl_scribe, &logger_impl_scribe::log_msg>(this));
+        }
+    }
 
     return true;
 }
@@ -209,19 +253,22 @@ void logger_impl_scribe::disconnect() {
         m_transport->close();
 }
 
-// Called by m_engine when writev() call resulted in an error
-int logger_impl_scribe::on_reconnect(typename async_logger_engine::stream_info& a_si)
+bool logger_impl_scribe::reconnect(time_val a_now)
 {
-    int res = -1;
+    if (connected())
+        return true;
+
+    if (a_now < m_next_attempt)
+        return false;
 
     try {
         int attempts = connect();
+        m_backoff_ms = 0;
 
-        if (m_reconnecting > 0)
+        if (attempts > 0)
             LOG_INFO("Successfully reconnected to scribe server at %s (attempts=%d)",
                      m_server_addr.to_string().c_str(), attempts);
-
-        res = m_socket->getSocketFD();
+        return true;
     } catch(std::exception& e) {
         if (!m_reconnecting++) {
             LOG_ERROR("Failed to reconnect to scribe server at %s: %s",
@@ -229,45 +276,143 @@ int logger_impl_scribe::on_reconnect(typename async_logger_engine::stream_info&
         }
     }
 
-    return res;
+    m_transport.reset();
+
+    // Exponential backoff between reconnection attempts
+    m_backoff_ms   = m_backoff_ms
+                   ? std::min(m_backoff_ms * 2, m_reconnect_max_ms)
+                   : m_reconnect_min_ms;
+    m_next_attempt = a_now + msecs(m_backoff_ms);
+    return false;
+}
+
+void logger_impl_scribe::run()
+{
+    std::vector<log_item> batch;
+    batch.reserve(m_batch_size);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        auto now   = now_utc();
+        bool ready = !m_spool.empty() &&
+                     (m_stop || m_spool.size() >= m_batch_size ||
+                      now >= m_spool.front().time + msecs(m_batch_age_ms));
+
+        // Until the server is back, messages stay in the spool
+        if (ready && !connected() && now < m_next_attempt) {
+            if (m_stop)
+                break;
+            m_cond.wait_for(lock, std::chrono::microseconds
+                            ((m_next_attempt - now).microseconds()));
+            continue;
+        }
+
+        if (!ready) {
+            if (m_stop)
+                break;
+            if (m_spool.empty())
+                m_cond.wait(lock);
+            else {
+                auto deadline = m_spool.front().time + msecs(m_batch_age_ms);
+                m_cond.wait_for(lock, std::chrono::microseconds
+                                ((deadline - now).microseconds()));
+            }
+            continue;
+        }
+
+        auto n = std::min(m_batch_size, m_spool.size());
+        for (size_t i=0; i < n; ++i) {
+            batch.push_back(std::move(m_spool.front()));
+            m_spool.pop_front();
+        }
+
+        // Network I/O is done without holding the lock, so that the
+        // logger's thread can keep adding messages to the spool
+        lock.unlock();
+        bool ok = reconnect(now) && send_batch(batch);
+        lock.lock();
+
+        if (ok)
+            m_sent.fetch_add(batch.size(), std::memory_order_relaxed);
+        else {
+            // Put the batch back preserving the order of messages
+            for (auto it = batch.rbegin(), e = batch.rend(); it != e; ++it)
+                m_spool.push_front(std::move(*it));
+
+            // On shutdown don't wait for the server to come back
+            if (m_stop && !connected())
+                break;
+        }
+        batch.clear();
+    }
 }
 
-int logger_impl_scribe::writev(typename async_logger_engine::stream_info& a_si,
-                               const char* a_categories[],
-                               const iovec* a_data, size_t a_size)
+bool logger_impl_scribe::send_batch(const std::vector<log_item>& a_batch)
 {
     namespace atp = ::apache::thrift::protocol;
-    int32_t xfer = 0;
 
     try {
         int32_t cseqid = 0;
-        xfer = m_protocol->writeMessageBegin("Log", atp::T_CALL, cseqid);
+        m_protocol->writeMessageBegin("Log", atp::T_CALL, cseqid);
 
         {
-            xfer += m_protocol->writeStructBegin("scribe_Log_pargs");
-            xfer += m_protocol->writeFieldBegin("messages", atp::T_LIST, 1);
+            m_protocol->writeStructBegin("scribe_Log_pargs");
+            m_protocol->writeFieldBegin("messages", atp::T_LIST, 1);
 
-            xfer += write_items(a_categories, a_data, a_size);
+            write_items(a_batch);
 
-            xfer += m_protocol->writeFieldEnd();
+            m_protocol->writeFieldEnd();
 
-            xfer += m_protocol->writeFieldStop();
-            xfer += m_protocol->writeStructEnd();
+            m_protocol->writeFieldStop();
+            m_protocol->writeStructEnd();
         }
 
-        xfer += m_protocol->writeMessageEnd();
-        xfer += m_protocol->getTransport()->writeEnd();
+        m_protocol->writeMessageEnd();
+        m_protocol->getTransport()->writeEnd();
         m_protocol->getTransport()->flush();
 
         // Wait for ack
-        recv_log_reply();
+        if (recv_log_reply() == OK)
+            return true;
+
+        // The server is overloaded - retry after a delay
+        m_backoff_ms   = m_reconnect_min_ms;
+        m_next_attempt = now_utc() + msecs(m_backoff_ms);
+        m_transport->close();
     } catch (std::exception& e) {
         LOG_ERROR("Error writing data to scribe: %s", e.what());
         m_transport.reset();
-        xfer = -1;
+        m_next_attempt = now_utc() + msecs(m_reconnect_min_ms);
     }
 
-    return xfer;
+    return false;
+}
+
+void logger_impl_scribe::spill(const log_item* a_items, size_t a_count)
+{
+    std::lock_guard<std::mutex> g(m_spill_mutex);
+
+    if (m_spill_fd < 0) {
+        m_dropped.fetch_add(a_count, std::memory_order_relaxed);
+        return;
+    }
+
+    // Each message is saved as a "Category|Message" line
+    for (auto p = a_items, e = a_items + a_count; p != e; ++p) {
+        auto& m = p->message;
+        bool  nl = m.empty() || m.back() != '\n';
+        iovec iov[4] = {
+            {(void*)p->category.c_str(), p->category.size()},
+            {(void*)"|",  1},
+            {(void*)m.c_str(), m.size()},
+            {(void*)"\n", nl ? 1ul : 0ul}
+        };
+        if (::writev(m_spill_fd, iov, 4) < 0)
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        else
+            m_spilled.fetch_add(1, std::memory_order_relaxed);
+    }
 }
 
 void logger_impl_scribe::log_msg(const logger::msg& a_msg, const char* a_buf, size_t a_size)
@@ -280,20 +425,27 @@ void logger_impl_scribe::send_data(
     log_level level, const std::string& a_category, const char* a_msg, size_t a_size)
     throw(runtime_error)
 {
-    if (!m_engine->running())
-        throw runtime_error("Logger terminated!");
+    log_item item{a_category, std::string(a_msg, a_size), now_utc()};
+    bool     queued = false, notify = false;
 
-    char* p = m_engine->allocate(a_size);
+    {
+        std::lock_guard<std::mutex> g(m_mutex);
 
-    if (!p) {
-        std::stringstream s("Out of memory allocating ");
-        s << a_size << " bytes!";
-        throw runtime_error(s.str());
+        // Messages arriving before init() or after finalize() are spilled
+        if (!m_stop && m_spool.size() < m_spool_size) {
+            m_spool.push_back(std::move(item));
+            queued = true;
+            notify = m_spool.size() == 1 || m_spool.size() == m_batch_size;
+        }
     }
 
-    memcpy(p, a_msg, a_size);
+    // The spool is full, because the server is unavailable or isn't
+    // keeping up, or the sender thread isn't running
+    if (!queued)
+        spill(&item, 1);
 
-    m_engine->write(m_fd, a_category, p, a_size);
+    if (notify)
+        m_cond.notify_one();
 }
 
 int logger_impl_scribe::write_string(const char* a_str, int a_size)
@@ -306,23 +458,20 @@ int logger_impl_scribe::write_string(const char* a_str, int a_size)
     return result;
 }
 
-int logger_impl_scribe::write_items(
-    const char* a_categories[], const iovec* a_data, size_t a_size)
+int logger_impl_scribe::write_items(const std::vector<log_item>& a_items)
 {
     namespace atp = ::apache::thrift::protocol;
 
-    uint32_t xfer = m_protocol->writeListBegin(atp::T_STRUCT, a_size);
-    for (uint32_t i=0; i < a_size; ++i) {
+    uint32_t xfer = m_protocol->writeListBegin(atp::T_STRUCT, a_items.size());
+    for (auto& item : a_items) {
         xfer += m_protocol->writeStructBegin("LogEntry");
 
         xfer += m_protocol->writeFieldBegin("category", atp::T_STRING, 1);
-        xfer += write_string(
-            a_categories[i], a_categories[i] ? strlen(a_categories[i]) : 0);
+        xfer += write_string(item.category.c_str(), item.category.size());
         xfer += m_protocol->writeFieldEnd();
 
         xfer += m_protocol->writeFieldBegin("message", atp::T_STRING, 2);
-        xfer += write_string(
-            static_cast<const char*>(a_data[i].iov_base), a_data[i].iov_len);
+        xfer += write_string(item.message.c_str(), item.message.size());
         xfer += m_protocol->writeFieldEnd();
 
         xfer += m_protocol->writeFieldStop();
@@ -48,7 +48,7 @@ namespace utxx {
 static logger_impl_mgr::impl_callback_t f = &logger_impl_syslog::create;
 static logger_impl_mgr::registrar reg("syslog", f);
 
-static int parse_syslog_facility(const std::string& facility) 
+int logger_impl_syslog::parse_facility(const std::string& facility)
     throw(std::runtime_error)
 {
     std::string s = facility;
@@ -66,7 +66,7 @@ static int parse_syslog_facility(const std::string& facility)
     else throw std::runtime_error("Unsupported syslog facility: " + s);
 }
 
-static int get_priority(log_level level) {
+int logger_impl_syslog::priority(log_level level) {
     switch (level) {
         case LEVEL_DEBUG:   return LOG_DEBUG;
         case LEVEL_INFO:    return LOG_INFO;
@@ -103,7 +103,7 @@ bool logger_impl_syslog::init(const variant_tree& a_config)
             LEVEL_TRACE3 | LEVEL_TRACE4 | LEVEL_TRACE5 | LEVEL_LOG);
     m_facility = 
         a_config.get<std::string>("logger.syslog.facility", "log_local6");
-    facility   = parse_syslog_facility(m_facility);
+    facility   = parse_facility(m_facility);
     m_show_pid = a_config.get<bool>("logger.syslog.show-pid", true);
 
     if (m_levels != NOLOGGING) {
@@ -123,9 +123,9 @@ bool logger_impl_syslog::init(const variant_tree& a_config)
 void logger_impl_syslog::log_msg
     (const logger::msg& a_msg, const char* a_buf, size_t a_size) throw(io_error)
 {
-    int priority = get_priority(a_msg.level());
-    if (priority)
-        ::syslog(priority, "%s", a_buf);
+    int pri = priority(a_msg.level());
+    if (pri)
+        ::syslog(pri, "%s", a_buf);
 }
 
 } // namespace utxx
@@ -0,0 +1,295 @@
+//----------------------------------------------------------------------------
+/// \file  logger_impl_syslog_dgram.cpp
+//----------------------------------------------------------------------------
+/// \brief Back-end plugin sending batches of RFC5424 syslog frames to a
+/// datagram socket for the <tt>logger</tt> class.
+//----------------------------------------------------------------------------
+// Copyright (c) 2026 agent <agent@local>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/un.h>
+#include <utxx/logger/logger_impl_syslog_dgram.hpp>
+#include <utxx/logger/logger_impl_syslog.hpp>
+#include <utxx/logger/logger_impl.hpp>
+#include <utxx/convert.hpp>
+#include <utxx/path.hpp>
+#include <utxx/url.hpp>
+
+namespace utxx {
+
+static logger_impl_mgr::impl_callback_t f = &logger_impl_syslog_dgram::create;
+static logger_impl_mgr::registrar reg("syslog-dgram", f);
+
+std::ostream& logger_impl_syslog_dgram::dump(std::ostream& out,
+    const std::string& a_prefix) const
+{
+    out << a_prefix << "logger." << name() << '\n'
+        << a_prefix << "    address        = " << m_address << '\n'
+        << a_prefix << "    levels         = " << logger::log_levels_to_str(m_levels) << '\n'
+        << a_prefix << "    facility       = " << m_facility << '\n'
+        << a_prefix << "    show-pid       = " << (m_show_pid ? "true" : "false") << '\n'
+        << a_prefix << "    batch-size     = " << m_batch_size << '\n'
+        << a_prefix << "    max-frame      = " << m_max_frame  << '\n'
+        << a_prefix << "    nonblock       = " << (m_nonblock ? "true" : "false") << '\n';
+    return out;
+}
+
+bool logger_impl_syslog_dgram::init(const variant_tree& a_config)
+    throw(badarg_error, io_error)
+{
+    BOOST_ASSERT(this->m_log_mgr);
+    finalize();
+
+    m_address    = a_config.get<std::string>
+                   ("logger.syslog-dgram.address", "uds:///dev/log");
+    m_levels     = logger::parse_log_levels(a_config.get<std::string>
+                   ("logger.syslog-dgram.levels", logger::default_log_levels))
+                 & ~(LEVEL_TRACE  | LEVEL_TRACE1 | LEVEL_TRACE2 |
+                     LEVEL_TRACE3 | LEVEL_TRACE4 | LEVEL_TRACE5 | LEVEL_LOG);
+    m_facility   = a_config.get<std::string>
+                   ("logger.syslog-dgram.facility", "log-local6");
+    m_show_pid   = a_config.get("logger.syslog-dgram.show-pid",   true);
+    m_nonblock   = a_config.get("logger.syslog-dgram.nonblock",   false);
+    m_batch_size = a_config.get("logger.syslog-dgram.batch-size", 64);
+    m_max_frame  = a_config.get("logger.syslog-dgram.max-frame",  2048);
+
+    try { m_facility_code = logger_impl_syslog::parse_facility(m_facility); }
+    catch (std::runtime_error& e) { throw badarg_error(e.what()); }
+
+    if (!m_batch_size)
+        throw badarg_error("logger.syslog-dgram.batch-size must be positive");
+    if (m_max_frame < 480)  // Minimum size that RFC5424 receivers must accept
+        throw badarg_error("logger.syslog-dgram.max-frame must be at least 480");
+
+    if (m_levels == NOLOGGING)
+        return true;
+
+    connect(m_address);
+
+    // HOSTNAME, APP-NAME and PROCID don't change, so format them once
+    char host[256];
+    if (::gethostname(host, sizeof(host)) < 0 || !host[0])
+        strcpy(host, "-");
+    host[sizeof(host)-1] = '\0';
+
+    std::string app = m_log_mgr->ident().empty()
+                    ? path::program::name() : m_log_mgr->ident();
+
+    m_host_app_pid = std::string(" ") + host + ' '
+                   + (app.empty() ? std::string("-") : app.substr(0, 48)) + ' '
+                   + (m_show_pid ? std::to_string(::getpid()) : std::string("-")) + ' ';
+    m_last_sec     = -1;
+
+    // Each frame of a batch has its own slot, so that sendmmsg(2) can send
+    // them without copying
+    m_frames.resize(m_batch_size * m_max_frame);
+    m_iov.resize(m_batch_size);
+    m_msgs.resize(m_batch_size);
+    for (size_t i=0; i < m_batch_size; ++i) {
+        m_iov[i].iov_base = &m_frames[i * m_max_frame];
+        m_iov[i].iov_len  = 0;
+        memset(&m_msgs[i], 0, sizeof(mmsghdr));
+        m_msgs[i].msg_hdr.msg_iov    = &m_iov[i];
+        m_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    m_count = 0;
+
+    // Install log_msg callbacks from appropriate levels
+    for(int lvl = 0; lvl < logger::NLEVELS; ++lvl) {
+        log_level level = logger::signal_slot_to_level(lvl);
+        if ((m_levels & static_cast<int>(level)) != 0)
+            this->add(level,
+                logger::on_msg_delegate_t::from_method
+                    <logger_impl_syslog_dgram, &logger_impl_syslog_dgram::log_msg>(this));
+    }
+    return true;
+}
+
+void logger_impl_syslog_dgram::connect(const std::string& a_url)
+    throw(badarg_error, io_error)
+{
+    addr_info addr;
+    if (!addr.parse(a_url) || (addr.proto != UDS && addr.proto != UDP))
+        throw badarg_error("Invalid address [logger.syslog-dgram.address]: ", a_url);
+
+    int type = SOCK_DGRAM | SOCK_CLOEXEC | (m_nonblock ? SOCK_NONBLOCK : 0);
+
+    if (addr.proto == UDS) {
+        sockaddr_un sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        if (addr.path.size() >= sizeof(sa.sun_path))
+            throw badarg_error("Socket path is too long: ", addr.path);
+        strcpy(sa.sun_path, addr.path.c_str());
+
+        m_fd = ::socket(AF_UNIX, type, 0);
+        if (m_fd < 0)
+            UTXX_THROW_IO_ERROR(errno, "Error creating socket");
+        if (::connect(m_fd, (const sockaddr*)&sa, sizeof(sa)) < 0) {
+            int e = errno;
+            ::close(m_fd);
+            m_fd  = -1;
+            UTXX_THROW_IO_ERROR(e, "Error connecting to ", a_url);
+        }
+        return;
+    }
+
+    addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    int rc = ::getaddrinfo(addr.addr.c_str(), addr.port.c_str(), &hints, &res);
+    if (rc)
+        throw badarg_error("Cannot resolve ", a_url, ": ", gai_strerror(rc));
+
+    int e = 0;
+    for (auto p = res; p; p = p->ai_next) {
+        m_fd = ::socket(p->ai_family, type, p->ai_protocol);
+        if (m_fd < 0) {
+            e = errno;
+            continue;
+        }
+        if (!::connect(m_fd, p->ai_addr, p->ai_addrlen))
+            break;
+        e = errno;
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    ::freeaddrinfo(res);
+
+    if (m_fd < 0)
+        UTXX_THROW_IO_ERROR(e, "Error connecting to ", a_url);
+}
+
+void logger_impl_syslog_dgram::format_time(time_val a_tv)
+{
+    auto sec = a_tv.sec();
+    if (sec == m_last_sec)
+        return;
+
+    time_t t = sec;
+    struct tm tm;
+    ::gmtime_r(&t, &tm);
+    ::strftime(m_time_str, sizeof(m_time_str), "%Y-%m-%dT%H:%M:%S", &tm);
+    m_last_sec = sec;
+}
+
+void logger_impl_syslog_dgram::log_msg
+    (const logger::msg& a_msg, const char* a_buf, size_t a_size) throw(io_error)
+{
+    int pri = logger_impl_syslog::priority(a_msg.level());
+    if (!pri)
+        return;
+
+    // Backends are invoked by the logger's thread only, so the batch is
+    // not shared
+    format_time(a_msg.timestamp());
+
+    // <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA MSG
+    char* begin = static_cast<char*>(m_iov[m_count].iov_base);
+    char* end   = begin + m_max_frame;
+    char* p     = begin;
+
+    *p++ = '<';
+    p    = stpcpy(p, std::to_string(m_facility_code | pri).c_str());
+    p    = stpcpy(p, ">1 ");
+    p    = stpcpy(p, m_time_str);
+    *p++ = '.';
+    itoa_right<long, 6>(p, a_msg.timestamp().usec(), '0');
+    p   += 6;
+    *p++ = 'Z';
+
+    auto append = [&p, end](const char* a_str, size_t a_sz) {
+        size_t n = std::min<size_t>(a_sz, end - p);
+        memcpy(p, a_str, n);
+        p += n;
+    };
+
+    append(m_host_app_pid.c_str(), m_host_app_pid.size());
+
+    auto& cat = a_msg.category();
+    if (cat.empty())
+        append("-", 1);
+    else
+        append(cat.c_str(), std::min<size_t>(cat.size(), 32));
+
+    append(" - ", 3);
+
+    if (a_size && a_buf[a_size-1] == '\n')
+        --a_size;
+    append(a_buf, a_size);
+
+    m_iov[m_count].iov_len = p - begin;
+
+    if (++m_count == m_batch_size)
+        flush();
+}
+
+void logger_impl_syslog_dgram::flush()
+{
+    if (!m_count || m_fd < 0)
+        return;
+
+    size_t n   = m_count;
+    size_t off = 0;
+    m_count    = 0;
+
+    while (off < n) {
+        int rc = ::sendmmsg(m_fd, &m_msgs[off], n - off, 0);
+        if (rc > 0) {
+            off += rc;
+            continue;
+        }
+        if (rc < 0 && errno == EINTR)
+            continue;
+
+        if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (m_nonblock) {
+                m_dropped.fetch_add(n - off, std::memory_order_relaxed);
+                return;
+            }
+            continue;
+        }
+
+        // The receiver refused the first frame (e.g. it's too long or there
+        // is no listener on a UDP port) - skip it and send the rest
+        if (rc < 0 && (errno == EMSGSIZE || errno == ECONNREFUSED)) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            ++off;
+            continue;
+        }
+
+        int e = rc < 0 ? errno : EIO;
+        m_dropped.fetch_add(n - off, std::memory_order_relaxed);
+        UTXX_THROW_IO_ERROR(e, "Error sending to syslog socket ", m_address);
+    }
+}
+
+} // namespace utxx
@@ -0,0 +1,153 @@
+//------------------------------------------------------------------------------
+/// \file   logger_thread.cpp
+/// \author agent
+//------------------------------------------------------------------------------
+/// \brief Registry of cached names of threads that write to the logger.
+//------------------------------------------------------------------------------
+// Copyright (C) 2026 agent <agent@local>
+// Created: 2026-10-17
+//------------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <utxx/logger/logger_thread.hpp>
+#include <utxx/convert.hpp>
+#include <pthread.h>
+#include <string.h>
+
+namespace utxx {
+
+constexpr size_t log_threads::s_max_threads;
+constexpr size_t log_threads::s_max_name_len;
+
+//------------------------------------------------------------------------------
+log_threads::log_threads()
+    : m_count(1), m_retired_count(0), m_reclaimed_count(0)
+{
+    for (auto& s : m_slots) {
+        s.version.store(0, std::memory_order_relaxed);
+        for (auto& w : s.name)
+            w.store(0, std::memory_order_relaxed);
+    }
+}
+
+//------------------------------------------------------------------------------
+uint16_t log_threads::attach()
+{
+    uint16_t idx;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if (!m_free.empty()) {
+            idx = m_free.back();
+            m_free.pop_back();
+        } else if (m_count.load(std::memory_order_relaxed) < s_max_threads) {
+            idx = uint16_t(m_count.load(std::memory_order_relaxed));
+            m_count.store(idx+1, std::memory_order_release);
+        } else if (!m_retired.empty()) {
+            // The registry is full and the logger hasn't reclaimed retired
+            // indices (e.g. it's not running), so reuse the oldest one
+            idx = m_retired.front();
+            m_retired.pop_front();
+            m_reclaimed_count.fetch_add(1, std::memory_order_relaxed);
+        } else
+            return 0;
+    }
+    update(idx);
+    return idx;
+}
+
+//------------------------------------------------------------------------------
+void log_threads::detach(uint16_t a_idx)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_retired.push_back(a_idx);
+    m_retired_count.fetch_add(1, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+void log_threads::do_reclaim(size_t a_retired)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto n = m_reclaimed_count.load(std::memory_order_relaxed);
+    for (; n < a_retired && !m_retired.empty(); ++n) {
+        m_free.push_back(m_retired.front());
+        m_retired.pop_front();
+    }
+    m_reclaimed_count.store(n, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+void log_threads::update(uint16_t a_idx)
+{
+    if (!a_idx)
+        return;
+
+    uint64_t buf[s_name_words] = {0};
+    auto     str = reinterpret_cast<char*>(buf);
+    auto     id  = pthread_self();
+    if (pthread_getname_np(id, str, s_max_name_len) != 0 || str[0] == '\0') {
+        char* q = str;
+        itoa(id, q, 10);
+    }
+    str[s_max_name_len-1] = '\0';
+
+    auto& s = m_slots[a_idx];
+    auto  v = s.version.load(std::memory_order_relaxed);
+    s.version.store(v+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < s_name_words; ++i)
+        s.name[i].store(buf[i], std::memory_order_relaxed);
+    s.version.store(v+2, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+const char* log_threads::name(uint16_t a_idx, char (&a_buf)[s_max_name_len]) const
+{
+    uint64_t buf[s_name_words] = {0};
+
+    if (a_idx && a_idx < s_max_threads) {
+        auto& s = m_slots[a_idx];
+        uint32_t v1, v2;
+        do {
+            v1 = s.version.load(std::memory_order_acquire);
+            for (size_t i = 0; i < s_name_words; ++i)
+                buf[i] = s.name[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            v2 = s.version.load(std::memory_order_relaxed);
+        } while ((v1 & 1) || v1 != v2);
+    }
+
+    memcpy(a_buf, buf, s_max_name_len);
+    a_buf[s_max_name_len-1] = '\0';
+    return a_buf;
+}
+
+//------------------------------------------------------------------------------
+void log_threads::set_name(const char* a_name)
+{
+    pthread_setname_np(pthread_self(), a_name);
+    refresh();
+}
+
+} // namespace utxx
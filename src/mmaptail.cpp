@@ -0,0 +1,124 @@
+// vim:ts=2 et sw=2
+//----------------------------------------------------------------------------
+/// \file mmaptail.cpp
+//----------------------------------------------------------------------------
+/// \brief Print records of a memory-mapped log ring written by the "mmap"
+/// logger backend.
+//----------------------------------------------------------------------------
+// Copyright (c) 2026 agent <agent@local>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utxx/path.hpp>
+#include <utxx/mmap_log_ring.hpp>
+
+using namespace std;
+
+void usage(std::string const& a_err = "")
+{
+  if (!a_err.empty())
+    std::cerr << "Error: " << a_err << endl << endl;
+
+  std::cerr << utxx::path::program::name()
+    << " [-f] [-n N] [-s MS] Filename\n"
+    << "Print records of a memory-mapped log ring file starting with\n"
+    << "the oldest record that wasn't overwritten\n\n"
+    << "    -f, --follow             - wait for new records to be appended\n"
+    << "    -n N                     - start from last N records\n"
+    << "    -s, --sleep-interval=MS  - poll interval in milliseconds when\n"
+    << "                               following the ring (default 100)\n"
+    << "    -h, --help               - help\n"
+    << endl;
+
+  exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+  bool   follow   = false;
+  long   last     = -1;
+  int    interval = 100;
+  string filename;
+
+  auto matchopt = [&](int i, const char* sv, const char* lv)
+                  { return !strcmp(argv[i], sv) || (lv && !strcmp(argv[i], lv)); };
+  auto hasarg   = [&](int i)
+                  { return i < argc-1 && argv[i+1][0] != '-'; };
+
+  for (int i=1; i < argc; ++i) {
+    if (matchopt(i, "-f", "--follow"))
+      follow = true;
+    else if (matchopt(i, "-n", nullptr) && hasarg(i))
+      last = atol(argv[++i]);
+    else if (matchopt(i, "-s", "--sleep-interval") && hasarg(i))
+      interval = atoi(argv[++i]);
+    else if (matchopt(i, "-h", "--help"))
+      usage();
+    else if (argv[i][0] != '-' && filename.empty())
+      filename = argv[i];
+    else
+      usage(string("Invalid option: ") + argv[i]);
+  }
+
+  if (filename.empty())
+    usage("Missing filename");
+
+  utxx::mmap_log_ring ring;
+  if (ring.open(filename) < 0) {
+    cerr << "Failed to open ring file " << filename << ": "
+         << strerror(errno) << endl;
+    exit(1);
+  }
+
+  if (last >= 0)
+    ring.seek_last(last);
+
+  string   rec;
+  uint64_t lost = 0;
+
+  while (true) {
+    while (ring.read(rec)) {
+      if (ring.lost() != lost) {
+        cerr << "*** " << (ring.lost() - lost)
+             << " bytes overwritten before they were read" << endl;
+        lost = ring.lost();
+      }
+      cout.write(rec.data(), rec.size());
+    }
+    cout.flush();
+
+    if (!follow)
+      break;
+
+    usleep(interval * 1000);
+  }
+
+  return 0;
+}
@@ -145,6 +145,196 @@ BOOST_AUTO_TEST_CASE( test_async_file_logger_append )
     }
 }
 
+//-----------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( test_async_file_logger_direct )
+{
+    enum { ITERATIONS = 1000 };
+
+    unlink(s_filename);
+
+    text_file_logger<async_direct_logger_traits> logger;
+
+    for (int k=0; k < 2; k++) {
+        int ok = logger.start(s_filename);
+        BOOST_REQUIRE_EQUAL(0, ok);
+
+        for (int i = 0; i < ITERATIONS; i++) {
+            int n = logger.fwrite(s_str1, i);
+            BOOST_CHECK(n > 0);
+        }
+
+        logger.stop();
+    }
+
+    std::ifstream file(s_filename, std::ios::in);
+    for (int k = 0; k < 2; k++)
+        for (int i = 0; i < ITERATIONS; i++) {
+            std::string s;
+            std::getline(file, s);
+            BOOST_REQUIRE(!file.fail());
+
+            char buf[256];
+            sprintf(buf, s_str1, i);
+            s += '\n';
+            BOOST_REQUIRE_EQUAL(s, buf);
+        }
+
+    std::string s;
+    std::getline(file, s);
+    BOOST_CHECK(file.fail());
+    BOOST_CHECK(file.eof());
+    file.close();
+
+    ::unlink(s_filename);
+}
+
+//-----------------------------------------------------------------------------
+struct small_pool_traits : public async_file_logger_traits {
+    static const size_t msg_pool_slots   = 16;
+    static const size_t msg_pool_slot_sz = 64;
+};
+
+BOOST_AUTO_TEST_CASE( test_async_file_logger_pool )
+{
+    enum { ITERATIONS = 10000, THREADS = 2 };
+
+    unlink(s_filename);
+
+    text_file_logger<small_pool_traits> logger;
+
+    // Small messages come from the pool, large ones from the allocator
+    auto m = logger.allocate(16);
+    BOOST_CHECK(m->pool());
+    logger.deallocate(m);
+    m = logger.allocate(1024);
+    BOOST_CHECK(!m->pool());
+    logger.deallocate(m);
+
+    // Exhaust the pool and check the overflow policies
+    std::vector<decltype(m)> held;
+    for (size_t i = 0; i < small_pool_traits::msg_pool_slots; i++) {
+        held.push_back(logger.allocate(16));
+        BOOST_REQUIRE(held.back()->pool());
+    }
+    BOOST_CHECK(logger.msg_pool_overflow() == pool_overflow::ALLOCATE);
+    m = logger.allocate(16);
+    BOOST_CHECK(!m->pool());
+    logger.deallocate(m);
+
+    logger.msg_pool_overflow(pool_overflow::FAIL);
+    BOOST_CHECK(!logger.allocate(16));
+    // The writer thread isn't running, so nobody would return a slot
+    logger.msg_pool_overflow(pool_overflow::BLOCK);
+    BOOST_CHECK(!logger.allocate(16));
+
+    for (auto p : held)
+        logger.deallocate(p);
+    BOOST_REQUIRE_EQUAL(1u, logger.msg_pools());
+
+    BOOST_REQUIRE_EQUAL(0, logger.start(s_filename));
+
+    // Every 10th message doesn't fit in a pool slot. Exhausting the
+    // pool of 16 slots makes the producer wait for the writer thread.
+    std::atomic<int>         errors(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++)
+        threads.emplace_back([&logger, &errors, t]() {
+            for (int i = 0; i < ITERATIONS; i++) {
+                std::string s = std::to_string(t) + ':' + std::to_string(i);
+                if (i % 10 == 0)
+                    s += std::string(100, 'x');
+                if (logger.write(s + '\n') <= 0)
+                    ++errors;
+            }
+        });
+
+    for (auto& t : threads)
+        t.join();
+
+    // A new thread adopts the pool of one that has exited
+    auto pools = logger.msg_pools();
+    BOOST_CHECK_EQUAL(size_t(THREADS+1), pools);
+    std::thread([&logger]() { logger.deallocate(logger.allocate(16)); }).join();
+    BOOST_CHECK_EQUAL(pools, logger.msg_pools());
+
+    logger.stop();
+    BOOST_REQUIRE_EQUAL(0, errors);
+
+    int cur_count[THREADS] = {0};
+
+    std::ifstream file(s_filename, std::ios::in);
+    for (int i = 0; i < ITERATIONS*THREADS; i++) {
+        std::string s;
+        std::getline(file, s);
+        BOOST_REQUIRE(!file.fail());
+
+        int t = s[0] - '0';
+        BOOST_REQUIRE(t >= 0 && t < THREADS);
+        std::string exp = std::to_string(t) + ':' + std::to_string(cur_count[t]);
+        if (cur_count[t] % 10 == 0)
+            exp += std::string(100, 'x');
+        BOOST_REQUIRE_EQUAL(exp, s);
+        cur_count[t]++;
+    }
+
+    std::string s;
+    std::getline(file, s);
+    BOOST_CHECK(file.fail());
+    BOOST_CHECK(file.eof());
+    file.close();
+
+    ::unlink(s_filename);
+}
+
+//-----------------------------------------------------------------------------
+struct failing_pool_traits : public small_pool_traits {
+    static std::atomic<bool> s_fail;
+
+    static int file_write(file_type a_fd, const char* a_data, size_t a_sz) {
+        return s_fail ? -1 : small_pool_traits::file_write(a_fd, a_data, a_sz);
+    }
+};
+
+std::atomic<bool> failing_pool_traits::s_fail(false);
+
+BOOST_AUTO_TEST_CASE( test_async_file_logger_pool_write_error )
+{
+    unlink(s_filename);
+
+    text_file_logger<failing_pool_traits> logger;
+    logger.msg_pool_overflow(pool_overflow::FAIL);
+
+    // Queue the whole pool. The writer fails to write it and exits, after
+    // which writes return -1.
+    failing_pool_traits::s_fail = true;
+    BOOST_REQUIRE_EQUAL(0, logger.start(s_filename, false));
+
+    for (size_t i = 0; i < failing_pool_traits::msg_pool_slots; i++)
+        logger.write(std::string("x\n"));
+
+    logger.stop();
+    failing_pool_traits::s_fail = false;
+
+    // All slots of the dropped messages are back in the pool
+    std::vector<decltype(logger.allocate(0))> held;
+    held.reserve(failing_pool_traits::msg_pool_slots);
+    for (size_t i = 0; i < failing_pool_traits::msg_pool_slots; i++) {
+        held.push_back(logger.allocate(16));
+        BOOST_REQUIRE(held.back() && held.back()->pool());
+    }
+    for (auto p : held)
+        logger.deallocate(p);
+
+    // The logger can be restarted after the writer has exited on error
+    BOOST_REQUIRE_EQUAL(0, logger.start(s_filename));
+    for (size_t i = 0; i < failing_pool_traits::msg_pool_slots; i++)
+        BOOST_CHECK_EQUAL(2, logger.write(std::string("y\n")));
+    logger.stop();
+
+    BOOST_CHECK_EQUAL(1u, logger.msg_pools());
+    ::unlink(s_filename);
+}
+
 class producer {
     int m_instance;
     int m_iterations;
@@ -0,0 +1,187 @@
+#include <boost/test/unit_test.hpp>
+#include <utxx/concurrent_mpmc_queue.hpp>
+#include <utxx/container/concurrent_fifo.hpp>
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace utxx {
+
+BOOST_AUTO_TEST_CASE( test_concurrent_mpmc_queue ) {
+    concurrent_mpmc_queue<std::string> queue(3);
+
+    BOOST_REQUIRE_EQUAL(4u, queue.capacity());
+    BOOST_REQUIRE(queue.empty());
+
+    for (int i = 0; i < 4; ++i)
+        BOOST_REQUIRE(queue.try_push(std::to_string(i)));
+    BOOST_REQUIRE(!queue.try_push("x"));
+    BOOST_REQUIRE_EQUAL(4u, queue.size());
+
+    std::string s;
+    for (int lap = 0; lap < 3; ++lap)
+        for (int i = 0; i < 4; ++i) {
+            BOOST_REQUIRE(queue.try_pop(s));
+            BOOST_REQUIRE_EQUAL(std::to_string(i), s);
+            BOOST_REQUIRE(queue.try_push(std::to_string(i)));
+        }
+
+    for (int i = 0; i < 2; ++i)
+        BOOST_REQUIRE(queue.try_pop(s));
+    BOOST_REQUIRE_EQUAL(2u, queue.size());
+    // The remaining items are destroyed with the queue
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_mpmc_blocking ) {
+    blocking_mpmc_queue<long> queue(2);
+    long n;
+
+    struct timespec ts = {0, 10000000};
+    BOOST_REQUIRE_EQUAL(-1, queue.pop(n, &ts));
+    BOOST_REQUIRE_EQUAL(0,  queue.push(1));
+    BOOST_REQUIRE_EQUAL(0,  queue.push(2));
+    BOOST_REQUIRE_EQUAL(-1, queue.push(3, &ts));
+
+    // A blocked producer is woken up by a consumer
+    std::thread thr([&] { BOOST_REQUIRE_EQUAL(0, queue.push(3)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    BOOST_REQUIRE_EQUAL(0, queue.pop(n));
+    BOOST_REQUIRE_EQUAL(1, n);
+    thr.join();
+
+    BOOST_REQUIRE(queue.try_pop(n));
+    BOOST_REQUIRE_EQUAL(2, n);
+    BOOST_REQUIRE_EQUAL(0, queue.pop(n));
+    BOOST_REQUIRE_EQUAL(3, n);
+
+    // A blocked consumer is woken up by terminate()
+    thr = std::thread([&] { BOOST_REQUIRE_EQUAL(-2, queue.pop(n)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    queue.terminate();
+    thr.join();
+    BOOST_REQUIRE_EQUAL(-2, queue.push(4));
+
+    // Wake-ups that don't leave an item to a waiting consumer don't extend
+    // its timeout
+    blocking_mpmc_queue<long> q(2, 0);
+    std::atomic<bool>         done(false);
+    int                       rc = 0;
+    std::chrono::steady_clock::duration elapsed;
+    thr = std::thread([&] {
+        struct timespec ts = {0, 50000000};
+        auto start = std::chrono::steady_clock::now();
+        long m;
+        rc      = q.pop(m, &ts);
+        elapsed = std::chrono::steady_clock::now() - start;
+        done    = true;
+    });
+    for (int i = 0; i < 100 && !done; ++i) {
+        q.try_push(i);
+        q.try_pop(n);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    thr.join();
+    BOOST_REQUIRE(rc == 0 || elapsed < std::chrono::milliseconds(300));
+}
+
+namespace {
+    // Adapters giving the queues under test the same blocking interface
+    template <class Q>
+    struct mpmc_adapter {
+        Q q{1024};
+        void push(long n) { q.push(n); }
+        void pop(long& n) { q.pop(n);  }
+    };
+
+    template <class Q>
+    struct spin_adapter {
+        Q q;
+        void push(long n) { while (!q.try_push(n)) std::this_thread::yield(); }
+        void pop(long& n) { while (!q.try_pop(n))  std::this_thread::yield(); }
+    };
+
+    template <class Q>
+    struct fifo_adapter {
+        Q q;
+        void push(long n) { while (q.enqueue(n)); }
+        void pop(long& n) { while (q.dequeue(n)); }
+    };
+
+    template <class Q>
+    struct fifo_spin_adapter {
+        Q q;
+        void push(long n) { while (!q.enqueue(n)) std::this_thread::yield(); }
+        void pop(long& n) { while (!q.dequeue(n)) std::this_thread::yield(); }
+    };
+
+    struct mpmc_spin_queue : concurrent_mpmc_queue<long> {
+        mpmc_spin_queue() : concurrent_mpmc_queue<long>(1024) {}
+    };
+
+    template <class Adapter>
+    void mpmc_bench(const char* a_name, int a_producers, int a_consumers)
+    {
+        const long iterations = ::getenv("ITERATIONS")
+                              ? atol(::getenv("ITERATIONS")) : 200000;
+        Adapter queue;
+        std::vector<std::thread> threads;
+        std::atomic<long>        sum(0);
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < a_producers; ++i)
+            threads.emplace_back([&] {
+                for (long n = 1; n <= iterations; ++n)
+                    queue.push(n);
+            });
+
+        long per_consumer = iterations * a_producers / a_consumers;
+        for (int i = 0; i < a_consumers; ++i)
+            threads.emplace_back([&] {
+                long s = 0, n;
+                for (long j = 0; j < per_consumer; ++j) {
+                    queue.pop(n);
+                    s += n;
+                }
+                sum += s;
+            });
+
+        for (auto& t : threads)
+            t.join();
+
+        auto   elapsed = std::chrono::steady_clock::now() - start;
+        double secs    = std::chrono::duration<double>(elapsed).count();
+        BOOST_TEST_MESSAGE(a_name << " " << a_producers << "P/" << a_consumers
+                           << "C: " << long(iterations*a_producers / secs)
+                           << " ops/s");
+        BOOST_REQUIRE_EQUAL(a_producers * (iterations * (iterations+1) / 2),
+                            sum.load());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_mpmc_perf ) {
+    typedef container::bound_lock_free_queue<long, 1024>   bound_fifo;
+    typedef container::unbound_lock_free_queue<long>       unbound_fifo;
+    typedef container::blocking_bound_fifo<long, 1024>     blocking_fifo;
+
+    for (auto pc : {std::make_pair(1, 1), std::make_pair(2, 2),
+                    std::make_pair(4, 2)}) {
+        int p = pc.first, c = pc.second;
+        mpmc_bench<spin_adapter<mpmc_spin_queue>>
+            ("concurrent_mpmc_queue  ", p, c);
+        mpmc_bench<fifo_spin_adapter<bound_fifo>>
+            ("bound_lock_free_queue  ", p, c);
+        mpmc_bench<fifo_spin_adapter<unbound_fifo>>
+            ("unbound_lock_free_queue", p, c);
+        mpmc_bench<mpmc_adapter<blocking_mpmc_queue<long>>>
+            ("blocking_mpmc_queue    ", p, c);
+        mpmc_bench<fifo_adapter<blocking_fifo>>
+            ("blocking_bound_fifo    ", p, c);
+    }
+}
+
+} // namespace utxx
@@ -2,6 +2,7 @@
 #include <utxx/concurrent_mpsc_queue.hpp>
 
 #include <vector>
+#include <set>
 #include <atomic>
 #include <chrono>
 #include <memory>
@@ -76,4 +77,106 @@ BOOST_AUTO_TEST_CASE( test_concurrent_mpsc_queue ) {
     }
 }
 
+namespace {
+    std::atomic<long> s_mpsc_allocs(0);
+
+    // Allocator counting the number of allocations
+    template <class T>
+    struct counting_alloc : std::allocator<T> {
+        template <class U> struct rebind { typedef counting_alloc<U> other; };
+
+        counting_alloc() {}
+        template <class U> counting_alloc(counting_alloc<U> const&) {}
+
+        T* allocate(size_t n) {
+            ++s_mpsc_allocs;
+            return std::allocator<T>::allocate(n);
+        }
+    };
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_mpsc_queue_recycle ) {
+    typedef concurrent_mpsc_queue<long, counting_alloc<char>> queue_t;
+    typedef queue_t::node node;
+
+    s_mpsc_allocs = 0;
+    {
+        queue_t queue;
+        for (long i = 0; i < 3; ++i)
+            BOOST_REQUIRE(queue.push(i));
+        BOOST_REQUIRE_EQUAL(3, s_mpsc_allocs);
+
+        std::set<node*> nodes;
+        node* n = queue.pop_all();
+        for (node* p = n; p; p = p->next())
+            nodes.insert(p);
+        queue.free_all(n);
+
+        // Freed nodes are reused without calling the allocator
+        for (long i = 0; i < 3; ++i)
+            BOOST_REQUIRE(queue.emplace(i));
+        BOOST_REQUIRE_EQUAL(3, s_mpsc_allocs);
+
+        long i = 0;
+        for (n = queue.pop_all(); n; ++i) {
+            BOOST_REQUIRE(nodes.count(n));
+            BOOST_REQUIRE_EQUAL(i, n->data());
+            node* next = n->next();
+            queue.free(n);
+            n = next;
+        }
+        BOOST_REQUIRE_EQUAL(3, i);
+    }
+
+    // Producers running concurrently with the consumer recycle nodes
+    s_mpsc_allocs = 0;
+    {
+        queue_t queue;
+        const int  producers  = 4;
+        const long iterations = 100000;
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < producers; ++i)
+            threads.emplace_back([&] {
+                for (long n = 1; n <= iterations; ++n)
+                    while (!queue.push(n));
+            });
+
+        long sum = 0, count = 0;
+        while (count < producers * iterations) {
+            node* n = queue.pop_all_reverse();
+            for (node* p = n; p; p = p->next(), ++count)
+                sum += p->data();
+            queue.free_all(n);
+        }
+
+        for (auto& t : threads)
+            t.join();
+
+        BOOST_REQUIRE_EQUAL(producers * (iterations * (iterations+1) / 2), sum);
+        BOOST_TEST_MESSAGE("Allocations: " << s_mpsc_allocs << " for "
+                           << count << " messages");
+        BOOST_REQUIRE(s_mpsc_allocs < count);
+    }
+
+    // A producer takes at most two nodes from the free list, and its
+    // magazine is adopted by a new producer after it exits
+    s_mpsc_allocs = 0;
+    {
+        queue_t queue(queue_t::Alloc(), 2);
+        for (long i = 0; i < 4; ++i)
+            BOOST_REQUIRE(queue.push(i));
+        queue.free_all(queue.pop_all());
+        BOOST_REQUIRE_EQUAL(4, s_mpsc_allocs);
+
+        std::thread([&] { BOOST_REQUIRE(queue.push(4)); }).join();
+        for (long i = 5; i < 7; ++i)
+            BOOST_REQUIRE(queue.push(i));
+        std::thread([&] { BOOST_REQUIRE(queue.push(7)); }).join();
+        BOOST_REQUIRE_EQUAL(4, s_mpsc_allocs);
+
+        queue.clear();
+    }
+}
+
 } // namespace utxx
@@ -0,0 +1,141 @@
+#include <boost/test/unit_test.hpp>
+#include <utxx/concurrent_spmc_queue.hpp>
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace utxx {
+
+BOOST_AUTO_TEST_CASE( test_concurrent_spmc_backpressure ) {
+    typedef concurrent_spmc_queue<std::string, 2> ring_t;
+
+    std::unique_ptr<ring_t, void(*)(ring_t*)>
+        ring(ring_t::create(4), [](ring_t* p) { ring_t::destroy(p); });
+
+    BOOST_REQUIRE_EQUAL(4u, ring->capacity());
+
+    // Nobody is subscribed: the producer is never blocked
+    for (int i = 0; i < 6; ++i)
+        BOOST_REQUIRE(ring->push(std::to_string(i)));
+
+    std::string s;
+    {
+        ring_t::consumer c1(*ring);
+        ring_t::consumer c2(*ring);
+        BOOST_REQUIRE_EQUAL(2u, ring->consumers());
+        BOOST_CHECK_THROW({ ring_t::consumer c3(*ring); }, utxx::runtime_error);
+        BOOST_REQUIRE(!c1.pop(s));
+
+        for (int i = 0; i < 4; ++i)
+            BOOST_REQUIRE(ring->push(std::to_string(i)));
+        BOOST_REQUIRE(!ring->push("x"));
+
+        // Both consumers see every message
+        for (int i = 0; i < 4; ++i) {
+            BOOST_REQUIRE(c1.pop(s));
+            BOOST_REQUIRE_EQUAL(std::to_string(i), s);
+        }
+        BOOST_REQUIRE(!c1.pop(s));
+
+        // The slowest consumer holds the producer back
+        BOOST_REQUIRE(!ring->push("x"));
+        BOOST_REQUIRE(c2.pop(s));
+        BOOST_REQUIRE_EQUAL("0", s);
+        BOOST_REQUIRE(ring->push("4"));
+        BOOST_REQUIRE(!ring->push("x"));
+        BOOST_REQUIRE_EQUAL(4u, c2.count());
+        BOOST_REQUIRE_EQUAL(1u, c1.count());
+        BOOST_REQUIRE_EQUAL(0u, c2.lost());
+    }
+    BOOST_REQUIRE_EQUAL(0u, ring->consumers());
+    BOOST_REQUIRE(ring->push("5"));
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_spmc_overwrite ) {
+    typedef concurrent_spmc_queue<long, 4, true> ring_t;
+
+    // Producer and consumer attached to the same (eg shared) memory
+    std::vector<char> buf(ring_t::memory_size(8));
+    auto wr = ring_t::create(8, buf.data(), buf.size(), true);
+    auto rd = ring_t::create(8, buf.data(), buf.size());
+    BOOST_REQUIRE(wr->is_externally_allocated());
+    BOOST_CHECK_THROW(ring_t::create(16, buf.data(), buf.size()),
+                      utxx::badarg_error);
+
+    ring_t::consumer c(*rd);
+    long n;
+    for (long i = 0; i < 20; ++i)
+        BOOST_REQUIRE(wr->push(i));
+    BOOST_REQUIRE_EQUAL(20u, rd->published());
+
+    // The oldest 12 messages were overwritten
+    for (long i = 12; i < 20; ++i) {
+        BOOST_REQUIRE(c.pop(n));
+        BOOST_REQUIRE_EQUAL(i, n);
+    }
+    BOOST_REQUIRE(!c.pop(n));
+    BOOST_REQUIRE_EQUAL(12u, c.lost());
+    BOOST_REQUIRE_EQUAL(20u, c.seq());
+
+    ring_t::destroy(rd);
+    ring_t::destroy(wr);
+    BOOST_REQUIRE(!wr);
+}
+
+template <bool Overwrite>
+void spmc_fanout(const char* a_name)
+{
+    typedef concurrent_spmc_queue<long, 8, Overwrite> ring_t;
+    static const int s_consumers = 6;
+    static const long s_count    = 1000000;
+
+    std::unique_ptr<ring_t, void(*)(ring_t*)>
+        ring(ring_t::create(1024), [](ring_t* p) { ring_t::destroy(p); });
+
+    std::atomic<int> ready(0);
+    std::vector<std::thread> threads;
+    std::vector<long> received(s_consumers), lost(s_consumers);
+
+    for (int i = 0; i < s_consumers; ++i)
+        threads.emplace_back([&, i] {
+            typename ring_t::consumer c(*ring);
+            ++ready;
+            long n, next = 0, cnt = 0;
+            while (next < s_count) {
+                if (!c.pop(n))
+                    continue;
+                // Messages arrive in order, possibly with gaps if lossy
+                BOOST_REQUIRE(n >= next);
+                BOOST_REQUIRE(Overwrite || n == next);
+                next = n + 1;
+                ++cnt;
+            }
+            received[i] = cnt;
+            lost[i]     = c.lost();
+        });
+
+    while (ready < s_consumers);
+
+    for (long i = 0; i < s_count; )
+        if (ring->push(i))
+            ++i;
+
+    for (auto& t : threads)
+        t.join();
+
+    for (int i = 0; i < s_consumers; ++i) {
+        BOOST_TEST_MESSAGE(a_name << " consumer " << i << ": received="
+                           << received[i] << ", lost=" << lost[i]);
+        BOOST_REQUIRE_EQUAL(s_count, received[i] + lost[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_spmc_fanout ) {
+    spmc_fanout<false>("backpressure");
+    spmc_fanout<true> ("overwrite");
+}
+
+} // namespace utxx
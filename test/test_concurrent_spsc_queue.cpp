@@ -2,6 +2,8 @@
 #include <utxx/concurrent_spsc_queue.hpp>
 
 #include <vector>
+#include <algorithm>
+#include <iterator>
 #include <atomic>
 #include <chrono>
 #include <memory>
@@ -81,6 +83,8 @@ void perfTestType(const char* type) {
 
     BOOST_TEST_MESSAGE("Type: " << type);
     doTest<PerfTest<concurrent_spsc_queue<T>,size,Pop>>("ProducerConsumerQueue");
+    doTest<PerfTest<concurrent_spsc_queue<T,0,true>,size,Pop>>
+        ("ProducerConsumerQueue (padded)");
 }
 
 template<class QueueType, size_t Size, bool Pop>
@@ -169,6 +173,8 @@ void correctnessTestType(const std::string& type) {
     BOOST_TEST_MESSAGE("Type: " << type);
     doTest<CorrectnessTest<concurrent_spsc_queue<T>,Size,Pop> >(
         "ProducerConsumerQueue");
+    doTest<CorrectnessTest<concurrent_spsc_queue<T,0,true>,Size,Pop> >(
+        "ProducerConsumerQueue (padded)");
 }
 
 struct DtorChecker {
@@ -203,6 +209,110 @@ BOOST_AUTO_TEST_CASE( test_concurrent_spsc_empty ) {
     BOOST_REQUIRE_EQUAL(queue.count(), 3u);
 }
 
+BOOST_AUTO_TEST_CASE( test_concurrent_spsc_padded ) {
+    typedef concurrent_spsc_queue<int, 0, true> queue_t;
+
+    // Head and tail are on different cache lines
+    BOOST_REQUIRE(queue_t::memory_size(0) > 2 * UTXX_CL_SIZE);
+
+    // Attaching to a non-empty queue in shared memory picks up its indices
+    std::vector<char> buf(queue_t::memory_size(8));
+    queue_t producer(buf.data(), buf.size(), queue_t::side_t::producer);
+    for (int i = 0; i < 7; ++i)
+        BOOST_REQUIRE(producer.push(i));
+    BOOST_REQUIRE(!producer.push(7));
+
+    queue_t consumer(buf.data(), buf.size(), queue_t::side_t::consumer);
+    int n;
+    for (int i = 0; i < 5; ++i) {
+        BOOST_REQUIRE(consumer.pop(n));
+        BOOST_REQUIRE_EQUAL(i, n);
+    }
+
+    // The producer refreshes its stale copy of the head when it looks full
+    for (int i = 7; i < 12; ++i)
+        BOOST_REQUIRE(producer.push(i));
+    BOOST_REQUIRE(!producer.push(12));
+
+    for (int i = 5; i < 12; ++i) {
+        BOOST_REQUIRE(consumer.pop(n));
+        BOOST_REQUIRE_EQUAL(i, n);
+    }
+    BOOST_REQUIRE(!consumer.pop(n));
+    BOOST_REQUIRE(consumer.empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_spsc_batch ) {
+    concurrent_spsc_queue<std::string> queue(8);
+    std::vector<std::string> in{"a", "b", "c", "d", "e", "f", "g", "h"};
+    std::vector<std::string> out;
+
+    // Only capacity-1 slots are usable
+    BOOST_REQUIRE_EQUAL(7u, queue.push_n(in.begin(), in.size()));
+    BOOST_REQUIRE_EQUAL(0u, queue.push_n(in.begin(), 1));
+    BOOST_REQUIRE_EQUAL(5u, queue.pop_n(std::back_inserter(out), 5));
+    BOOST_REQUIRE_EQUAL(5u, out.size());
+    BOOST_REQUIRE_EQUAL("e", out.back());
+
+    // The range wraps around the end of the storage
+    auto r = queue.claim(10);
+    BOOST_REQUIRE_EQUAL(5u, r.size());
+    BOOST_REQUIRE_EQUAL(1u, r.first.size);
+    BOOST_REQUIRE_EQUAL(4u, r.second.size);
+    for (size_t i = 0; i < 3; ++i)
+        new (&r[i]) std::string(1, char('x' + i));
+    queue.publish(3);
+    BOOST_REQUIRE_EQUAL(5u, queue.count());
+
+    auto p = queue.peek(10);
+    BOOST_REQUIRE_EQUAL(5u, p.size());
+    BOOST_REQUIRE_EQUAL(3u, p.first.size);
+    BOOST_REQUIRE_EQUAL("f", p[0]);
+    BOOST_REQUIRE_EQUAL("g", p[1]);
+    BOOST_REQUIRE_EQUAL("x", p[2]);
+    BOOST_REQUIRE_EQUAL("z", p[4]);
+    queue.release(2);
+    BOOST_REQUIRE_EQUAL("x", *queue.peek());
+
+    out.clear();
+    BOOST_REQUIRE_EQUAL(3u, queue.pop_n(std::back_inserter(out), 10));
+    BOOST_REQUIRE_EQUAL("xyz", out[0] + out[1] + out[2]);
+    BOOST_REQUIRE(queue.empty());
+    BOOST_REQUIRE(queue.peek(1).empty());
+
+    // Batched producer and consumer running concurrently
+    typedef concurrent_spsc_queue<int, 0, true> queue_t;
+    std::vector<char> buf(queue_t::memory_size(256));
+    queue_t producer(buf.data(), buf.size(), queue_t::side_t::producer);
+    queue_t consumer(buf.data(), buf.size(), queue_t::side_t::consumer);
+    const int count = 1000000;
+
+    std::thread thr([&] {
+        int batch[64];
+        for (int i = 0; i < count; ) {
+            int n = std::min<int>(count - i, 1 + i % 64);
+            for (int j = 0; j < n; ++j)
+                batch[j] = i + j;
+            int k = 0;
+            while (k < n)
+                k += producer.push_n(batch + k, n - k);
+            i += n;
+        }
+    });
+
+    int expected = 0;
+    while (expected < count) {
+        auto v = consumer.peek(64);
+        for (size_t j = 0; j < v.size(); ++j)
+            if (v[j] != expected++)
+                BOOST_REQUIRE_EQUAL(expected-1, v[j]);
+        if (!v.empty())
+            consumer.release(v.size());
+    }
+    thr.join();
+    BOOST_REQUIRE(consumer.empty());
+}
+
 BOOST_AUTO_TEST_CASE( test_concurrent_spsc_correctness ) {
     correctnessTestType<std::string,0xfffe,true>("string (front+pop)");
     correctnessTestType<std::string,0xffff>("string");
@@ -34,8 +34,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #endif
 
 #include <iostream>
+#include <fstream>
 #include <utxx/logger.hpp>
 #include <utxx/logger/logger_impl_console.hpp>
+#include <utxx/mmap_log_ring.hpp>
 #include <utxx/verbosity.hpp>
 #include <utxx/variant_tree.hpp>
 #include <signal.h>
@@ -293,7 +295,815 @@ BOOST_AUTO_TEST_CASE( test_logger2 )
 
     log.finalize();
 }
+
+BOOST_AUTO_TEST_CASE( test_logger_deferred )
+{
+    // Check binary encoding/decoding of the log record
+    {
+        utxx::detail::log_record rec;
+        char buf[256];
+        rec.encode("%d|%s|%.2f|%c|%s", 10, "abc", 1.5, 'x', std::string("str"));
+        int n = rec.format(buf, sizeof(buf));
+        BOOST_CHECK_EQUAL("10|abc|1.50|x|str", std::string(buf, n));
+
+        rec.encode(nullptr, "a=", 1, ", b=", true, ", c=", 2.5);
+        n = rec.format(buf, sizeof(buf));
+        BOOST_CHECK_EQUAL("a=1, b=true, c=2.5", std::string(buf, n));
+
+        n = rec.format(buf, 5);
+        BOOST_CHECK_EQUAL("a=1,", std::string(buf, n));
+
+        // Long strings get truncated to fit in the record
+        std::string s(2*UTXX_LOGGER_RECORD_SIZE, 'a');
+        rec.encode("%s|%d", s, 5);
+        n = rec.format(buf, sizeof(buf));
+        BOOST_CHECK(n < UTXX_LOGGER_RECORD_SIZE);
+        BOOST_CHECK_EQUAL("|5", std::string(buf+n-2, 2));
+
+        // A format without arguments is unescaped as by snprintf()
+        rec.encode("100%% done");
+        n = rec.format(buf, sizeof(buf));
+        BOOST_CHECK_EQUAL("100% done", std::string(buf, n));
+
+        // time_val is stored by value and printed as by logs()
+        time_val tv(1476748800, 123456);
+        rec.encode(nullptr, "at ", tv);
+        n = rec.format(buf, sizeof(buf));
+        BOOST_CHECK_EQUAL(utxx::print("at ", tv), std::string(buf, n));
+
+        static_assert( utxx::detail::log_record::can_defer<int, const char*, double>::value, "");
+        static_assert(!utxx::detail::log_record::can_defer<int, utxx::fixed>::value,              "");
+        static_assert( utxx::detail::log_record::can_defer<int, time_val>::value,                 "");
+        static_assert(!utxx::detail::log_record::can_defer_fmt<int, time_val>::value,             "");
+    }
+
+#ifdef UTXX_LOGGER_DEFERRED
+
+    auto filename = "/tmp/test_logger_deferred." + std::to_string(getpid());
+
+    variant_tree pt;
+    pt.put("logger.timestamp",             variant("none"));
+    pt.put("logger.show-location",         false);
+    pt.put("logger.show-thread",           false);
+    pt.put("logger.show-ident",            false);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.deferred-format",       true);
+    pt.put("logger.min-level-filter",      variant("info"));
+    pt.put("logger.file.filename",         variant(filename));
+    pt.put("logger.file.append",           false);
+    pt.put("logger.file.no-header",        true);
+
+    logger& log = logger::instance();
+
+    if (log.initialized())
+        log.finalize();
+
+    log.init(pt, nullptr, false);
+
+    BOOST_REQUIRE(log.deferred_format());
+
+    char name[16] = "first";
+    LOG_INFO("Value %d: %s %.1f", 1, name, 2.5);
+    // The argument was copied, so modifying it shouldn't affect the output
+    strcpy(name, "second");
+    LOG_INFO("Value %d: %s", 2, name);
+    LOG_INFO("No arguments\n");
+    UTXX_LOG(INFO) << "Streamed " << 3;
+    log.logs(LEVEL_INFO, "", UTXX_LOG_SRCINFO, "Printed ", 4, ' ', std::string("str"));
+    log.logs(LEVEL_INFO, "", UTXX_LOG_SRCINFO, "Not deferred ", utxx::fixed(1.5, 1));
+
+    log.finalize();
+
+    std::ifstream in(filename);
+    std::string   line;
+    std::vector<std::string> lines;
+    while (std::getline(in, line))
+        lines.push_back(line);
+    ::unlink(filename.c_str());
+
+    BOOST_REQUIRE_EQUAL(6u, lines.size());
+    BOOST_CHECK_EQUAL("I|Value 1: first 2.5", lines[0]);
+    BOOST_CHECK_EQUAL("I|Value 2: second",    lines[1]);
+    BOOST_CHECK_EQUAL("I|No arguments",       lines[2]);
+    BOOST_CHECK_EQUAL("I|Streamed 3",         lines[3]);
+    BOOST_CHECK_EQUAL("I|Printed 4 str",      lines[4]);
+    BOOST_CHECK_EQUAL("I|Not deferred 1.5",   lines[5]);
 #endif
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_category )
+{
+    auto& cats = log_categories::instance();
+
+    BOOST_CHECK_EQUAL(0,  log_category("").id());
+    BOOST_CHECK_EQUAL(0,  log_category((const char*)nullptr).id());
+    BOOST_CHECK(log_category().empty());
+    BOOST_CHECK_EQUAL("", log_category().name());
+    BOOST_CHECK_EQUAL(-1, cats.find("SomeUnregisteredCategory", 24));
+
+    log_category c1("SomeLongCategoryName.One");
+    log_category c2(std::string("SomeLongCategoryName.Two"));
+    log_category c3("SomeLongCategoryName.One");
+
+    BOOST_CHECK(!c1.empty());
+    BOOST_CHECK(c1 == c3);
+    BOOST_CHECK(c1 != c2);
+    BOOST_CHECK_EQUAL(c1.id(), cats.find("SomeLongCategoryName.One", 24));
+    BOOST_CHECK_EQUAL("SomeLongCategoryName.One", c1.name());
+    BOOST_CHECK_EQUAL("SomeLongCategoryName.Two", c2.name());
+    BOOST_CHECK_EQUAL("SomeLongCategoryName.Two", cats.name(c2.id()));
+
+    auto filename = "/tmp/test_logger_category." + std::to_string(getpid());
+
+    variant_tree pt;
+    pt.put("logger.timestamp",             variant("none"));
+    pt.put("logger.show-location",         false);
+    pt.put("logger.show-category",         true);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.min-level-filter",      variant("info"));
+    pt.put("logger.file.filename",         variant(filename));
+    pt.put("logger.file.append",           false);
+    pt.put("logger.file.no-header",        true);
+
+    logger& log = logger::instance();
+
+    if (log.initialized())
+        log.finalize();
+
+    log.init(pt, nullptr, false);
+
+    CLOG_INFO("SomeLongCategoryName.One", "Test %d", 1);
+    CLOG_INFO(std::string("SomeLongCategoryName.Two"), "Test %d", 2);
+    LOG_INFO ("Test %d", 3);
+
+    // Only literal categories are cached at the call site
+    char cat[32];
+    for (auto s : {"Cat.A", "Cat.B"}) {
+        strcpy(cat, s);
+        CLOG_INFO(cat, "Test %d", 4);
+    }
+
+    // A constant array that changes between calls isn't cached either
+    struct { char cat[16]; } holder;
+    const auto& cholder = holder;
+    for (auto s : {"Cat.C", "Cat.D"}) {
+        strcpy(holder.cat, s);
+        CLOG_INFO(cholder.cat, "Test %d", 5);
+    }
+
+    log.finalize();
+
+    std::ifstream in(filename);
+    std::string   line;
+    std::vector<std::string> lines;
+    while (std::getline(in, line))
+        lines.push_back(line);
+    ::unlink(filename.c_str());
+
+    BOOST_REQUIRE_EQUAL(7u, lines.size());
+    BOOST_CHECK_EQUAL("I|SomeLongCategoryName.One|Test 1", lines[0]);
+    BOOST_CHECK_EQUAL("I|SomeLongCategoryName.Two|Test 2", lines[1]);
+    BOOST_CHECK_EQUAL("I||Test 3",                         lines[2]);
+    BOOST_CHECK_EQUAL("I|Cat.A|Test 4",                    lines[3]);
+    BOOST_CHECK_EQUAL("I|Cat.B|Test 4",                    lines[4]);
+    BOOST_CHECK_EQUAL("I|Cat.C|Test 5",                    lines[5]);
+    BOOST_CHECK_EQUAL("I|Cat.D|Test 5",                    lines[6]);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_header_cache )
+{
+    auto filename = "/tmp/test_logger_header_cache." + std::to_string(getpid());
+
+    variant_tree pt;
+    pt.put("logger.timestamp",             variant("date-time-usec"));
+    pt.put("logger.show-location",         false);
+    pt.put("logger.show-category",         false);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.min-level-filter",      variant("info"));
+    pt.put("logger.file.filename",         variant(filename));
+    pt.put("logger.file.append",           false);
+    pt.put("logger.file.no-header",        true);
+
+    logger& log = logger::instance();
+
+    if (log.initialized())
+        log.finalize();
+
+    log.init(pt, nullptr, false);
+
+    auto start = now_utc();
+    const int iterations = 1000;
+
+    for (int i=0; i < iterations; ++i) {
+        LOG_INFO("Test %d", i);
+        if (i % 100 == 0)
+            usleep(2000);
+    }
+
+    log.finalize();
+
+    auto end = now_utc();
+
+    std::ifstream in(filename);
+    std::string   line, last;
+    int n = 0;
+    while (std::getline(in, line)) {
+        // YYYYMMDD-HH:MM:SS.uuuuuu|I|Test N
+        BOOST_REQUIRE(line.size() > 27);
+        BOOST_CHECK_EQUAL("|I|Test " + std::to_string(n++), line.substr(24));
+        auto ts = line.substr(0, 24);
+        auto tv = timestamp::from_string(ts.c_str(), ts.size(), false);
+        BOOST_CHECK(tv >= time_val(start.sec(), 0));
+        BOOST_CHECK(tv <= end);
+        BOOST_CHECK(last <= ts);
+        last = ts;
+    }
+    ::unlink(filename.c_str());
+
+    BOOST_CHECK_EQUAL(iterations, n);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_file_batch )
+{
+    auto filename = "/tmp/test_logger_file_batch." + std::to_string(getpid());
+
+    variant_tree pt;
+    pt.put("logger.timestamp",             variant("none"));
+    pt.put("logger.show-location",         false);
+    pt.put("logger.show-category",         false);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.min-level-filter",      variant("info"));
+    pt.put("logger.file.filename",         variant(filename));
+    pt.put("logger.file.append",           false);
+    pt.put("logger.file.no-header",        true);
+    // Small batch to exercise writes on batch overflow
+    pt.put("logger.file.batch-size",       256);
+    pt.put("logger.file.sync-interval-ms", 1);
+
+    logger& log = logger::instance();
+
+    if (log.initialized())
+        log.finalize();
+
+    log.init(pt, nullptr, false);
+
+    const int iterations = 10000;
+
+    for (int i=0; i < iterations; ++i)
+        LOG_INFO("Test %d", i);
+
+    log.finalize();
+
+    std::ifstream in(filename);
+    std::string   line;
+    int n = 0;
+    while (std::getline(in, line))
+        BOOST_CHECK_EQUAL("I|Test " + std::to_string(n++), line);
+    ::unlink(filename.c_str());
+
+    BOOST_CHECK_EQUAL(iterations, n);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_thread_name )
+{
+    auto filename = "/tmp/test_logger_thread_name." + std::to_string(getpid());
+
+    variant_tree pt;
+    pt.put("logger.timestamp",             variant("none"));
+    pt.put("logger.show-location",         false);
+    pt.put("logger.show-category",         false);
+    pt.put("logger.show-thread",           true);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.min-level-filter",      variant("info"));
+    pt.put("logger.file.filename",         variant(filename));
+    pt.put("logger.file.append",           false);
+    pt.put("logger.file.no-header",        true);
+
+    logger& log = logger::instance();
+
+    if (log.initialized())
+        log.finalize();
+
+    log.init(pt, nullptr, false);
+
+    auto& threads = log_threads::instance();
+
+    std::thread([&]() {
+        char buf[log_threads::s_max_name_len];
+        log_threads::set_name("worker1");
+        LOG_INFO("Test %d", 1);
+        auto idx = log_threads::current();
+        BOOST_CHECK(idx != 0);
+        BOOST_CHECK_EQUAL("worker1", threads.name(idx, buf));
+        // Renaming without the hook leaves the cached name until refresh()
+        pthread_setname_np(pthread_self(), "worker2");
+        BOOST_CHECK_EQUAL("worker1", threads.name(idx, buf));
+        log_threads::refresh();
+        BOOST_CHECK_EQUAL("worker2", threads.name(idx, buf));
+        LOG_INFO("Test %d", 2);
+    }).join();
+
+    log.finalize();
+
+    // The index of an exited thread is only reused after reclaim(), which
+    // the logger calls once the messages of that thread are written
+    uint16_t idx1 = 0, idx2 = 0, idx3 = 0;
+    std::thread([&]() { idx1 = log_threads::current(); }).join();
+    std::thread([&]() { idx2 = log_threads::current(); }).join();
+    BOOST_CHECK_NE(idx1, idx2);
+
+    threads.reclaim(threads.retired());
+    auto n = threads.size();
+    std::thread([&]() { idx3 = log_threads::current(); }).join();
+    BOOST_CHECK(idx3 == idx1 || idx3 == idx2);
+    BOOST_CHECK_EQUAL(n, threads.size());
+
+    std::ifstream in(filename);
+    std::string   line;
+    std::vector<std::string> lines;
+    while (std::getline(in, line))
+        lines.push_back(line);
+    ::unlink(filename.c_str());
+
+    BOOST_REQUIRE_EQUAL(2u, lines.size());
+    BOOST_CHECK_EQUAL("I|worker2|Test 1", lines[0]);
+    BOOST_CHECK_EQUAL("I|worker2|Test 2", lines[1]);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_thread_queues )
+{
+    auto filename = "/tmp/test_logger_thread_queues." + std::to_string(getpid());
+
+    variant_tree pt;
+    pt.put("logger.timestamp",              variant("time-usec"));
+    pt.put("logger.show-location",          false);
+    pt.put("logger.show-category",          false);
+    pt.put("logger.show-thread",            false);
+    pt.put("logger.show-ident",             false);
+    pt.put("logger.silent-finish",          true);
+    // Small capacity to exercise fallback to the shared queue
+    pt.put("logger.thread-queue-capacity",  8);
+    pt.put("logger.min-level-filter",       variant("info"));
+    pt.put("logger.file.filename",          variant(filename));
+    pt.put("logger.file.append",            false);
+    pt.put("logger.file.no-header",         true);
+
+    logger& log = logger::instance();
+
+    if (log.initialized())
+        log.finalize();
+
+    log.init(pt, nullptr, false);
+
+    const int threads = 4, iterations = 1000;
+    {
+        std::vector<std::thread> thr;
+        for (int i=0; i < threads; ++i)
+            thr.emplace_back([i]() {
+                for (int j=0; j < iterations; ++j)
+                    LOG_INFO("Thread %d: %d", i, j);
+            });
+        for (auto& t : thr)
+            t.join();
+    }
+
+    // Queues of exited threads are reused
+    std::thread([]() { LOG_INFO("Last"); }).join();
+
+    log.finalize();
+
+    std::ifstream in(filename);
+    std::string   line, last;
+    std::vector<int> counts(threads, 0);
+    int n = 0;
+    bool ordered = true;
+    while (std::getline(in, line)) {
+        ++n;
+        // Timestamps (HH:MM:SS.uuuuuu) must be non-decreasing
+        auto ts = line.substr(0, 15);
+        ordered &= last <= ts;
+        last     = ts;
+        int t, j;
+        if (sscanf(line.c_str()+15, "|I|Thread %d: %d", &t, &j) == 2) {
+            BOOST_REQUIRE(t >= 0 && t < threads);
+            // Messages of each thread are in order
+            BOOST_CHECK_EQUAL(counts[t]++, j);
+        }
+    }
+    ::unlink(filename.c_str());
+
+    BOOST_CHECK(ordered);
+    BOOST_CHECK_EQUAL(threads*iterations+1, n);
+    for (auto c : counts)
+        BOOST_CHECK_EQUAL(iterations, c);
+}
+
+static int count_lines(const std::string& a_file)
+{
+    std::ifstream in(a_file);
+    std::string   line;
+    int n = 0;
+    while (std::getline(in, line)) ++n;
+    return n;
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_queue_overflow )
+{
+    auto filename = "/tmp/test_logger_queue_overflow." + std::to_string(getpid());
+    auto spillname = filename + ".spill";
+
+    variant_tree pt;
+    pt.put("logger.timestamp",             variant("none"));
+    pt.put("logger.show-location",         false);
+    pt.put("logger.show-category",         false);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.min-level-filter",      variant("info"));
+    pt.put("logger.queue-capacity",        8);
+    pt.put("logger.queue-overflow",        variant("drop-newest"));
+    pt.put("logger.file.filename",         variant(filename));
+    pt.put("logger.file.append",           false);
+    pt.put("logger.file.no-header",        true);
+
+    logger& log = logger::instance();
+
+    if (log.initialized())
+        log.finalize();
+
+    const int iterations = 10000;
+
+    log.init(pt, nullptr, false);
+    BOOST_CHECK_EQUAL(8, log.queue_capacity());
+    BOOST_CHECK(log.queue_overflow() == logger::overflow_policy::DROP_NEWEST);
+
+    for (int i=0; i < iterations; ++i)
+        LOG_INFO("Test %d", i);
+
+    log.finalize();
+
+    long dropped = log.dropped(LEVEL_INFO);
+    BOOST_CHECK_EQUAL(dropped, log.dropped());
+    BOOST_CHECK_EQUAL(iterations, count_lines(filename) + dropped);
+
+    // Messages that don't fit in the queue are written to the spill file
+    pt.put("logger.queue-overflow",        variant("spill"));
+    pt.put("logger.queue-spill-file",      variant(spillname));
+
+    ::unlink(filename.c_str());
+    log.init(pt, nullptr, false);
+
+    for (int i=0; i < iterations; ++i)
+        LOG_INFO("Test %d", i);
+
+    log.finalize();
+
+    BOOST_CHECK_EQUAL(0, log.dropped());
+    BOOST_CHECK_EQUAL(iterations, count_lines(filename) + count_lines(spillname));
+
+    ::unlink(filename.c_str());
+    ::unlink(spillname.c_str());
+
+    // The logger's own thread can't wait for room under the blocking policy,
+    // so it drops the messages that don't fit in the queue
+    pt.put("logger.queue-overflow",        variant("block"));
+    pt.put("logger.queue-spill-file",      variant(""));
+
+    log.set_on_before_run([]() {
+        for (int i=0; i < 20; ++i)
+            LOG_INFO("Test %d", i);
+    });
+    log.init(pt, nullptr, false);
+    log.finalize();
+    log.set_on_before_run(nullptr);
+
+    BOOST_CHECK_EQUAL(12, log.dropped());
+    BOOST_CHECK_EQUAL(8,  count_lines(filename));
+
+    ::unlink(filename.c_str());
+}
+#endif
+
+BOOST_AUTO_TEST_CASE( test_logger_latency_stats )
+{
+    // Bucket boundaries of the log-linear histogram
+    for (uint64_t v : {0ul, 7ul, 8ul, 9ul, 15ul, 16ul, 1000ul, 123456789ul}) {
+        int i = latency_histogram::to_bucket(v);
+        BOOST_CHECK(latency_histogram::from_bucket(i)   <= v);
+        BOOST_CHECK(latency_histogram::from_bucket(i+1) >  v);
+    }
+
+    auto filename = "/tmp/test_logger_latency_stats." + std::to_string(getpid());
+
+    variant_tree pt;
+    pt.put("logger.timestamp",             variant("none"));
+    pt.put("logger.show-location",         false);
+    pt.put("logger.show-category",         false);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.min-level-filter",      variant("info"));
+    pt.put("logger.latency-stats",         true);
+    pt.put("logger.latency-stats.signal",  variant("SIGUSR2"));
+    pt.put("logger.file.filename",         variant(filename));
+    pt.put("logger.file.append",           false);
+    pt.put("logger.file.no-header",        true);
+
+    logger& log = logger::instance();
+
+    if (log.initialized())
+        log.finalize();
+
+    log.init(pt, nullptr, false);
+    BOOST_CHECK(log.latency_stats());
+
+    const uint64_t iterations = 1000;
+
+    for (uint64_t i=0; i < iterations; ++i)
+        LOG_INFO("Test %d", i);
+
+    for (int i=0; i < 1000 && log.stats().queue.count() < iterations; ++i)
+        usleep(1000);
+
+    auto stats = log.stats();
+    BOOST_CHECK_EQUAL(iterations, stats.queue.count());
+    BOOST_CHECK_EQUAL(iterations, stats.format.count());
+    BOOST_REQUIRE_EQUAL(1u, stats.backends.size());
+    BOOST_CHECK_EQUAL("file", stats.backends[0].name);
+    BOOST_CHECK_EQUAL(iterations, stats.backends[0].write.count());
+    BOOST_CHECK(stats.queue.min() <= stats.queue.percentile(50));
+    BOOST_CHECK(stats.queue.percentile(50) <= stats.queue.percentile(99));
+    BOOST_CHECK(stats.queue.percentile(99) <= stats.queue.max());
+
+    // The statistics are written to the log on a signal
+    raise(SIGUSR2);
+    usleep(10000);
+    LOG_INFO("Done");
+
+    log.finalize();
+
+    std::ifstream in(filename);
+    std::string   line;
+    int found = 0;
+    while (std::getline(in, line))
+        if (line.find("Latency ") != std::string::npos)
+            ++found;
+    ::unlink(filename.c_str());
+
+    BOOST_CHECK_EQUAL(3, found);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_wait_strategy )
+{
+    auto filename = "/tmp/test_logger_wait_strategy." + std::to_string(getpid());
+
+    variant_tree pt;
+    pt.put("logger.timestamp",             variant("none"));
+    pt.put("logger.show-location",         false);
+    pt.put("logger.show-category",         false);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.min-level-filter",      variant("info"));
+    pt.put("logger.wait-timeout-ms",       10000);
+    pt.put("logger.spin-max-us",           20);
+    pt.put("logger.file.filename",         variant(filename));
+    pt.put("logger.file.append",           false);
+    pt.put("logger.file.no-header",        true);
+
+    logger& log = logger::instance();
+
+    for (auto s : {"spin", "backoff", "adaptive"}) {
+        if (log.initialized())
+            log.finalize();
+
+        pt.put("logger.wait-strategy", variant(s));
+        ::unlink(filename.c_str());
+        log.init(pt, nullptr, false);
+
+        const int iterations = 1000;
+        for (int i=0; i < iterations; ++i) {
+            LOG_INFO("Test %d", i);
+            if (i % 100 == 0)
+                usleep(1000);
+        }
+
+        // Let the logger's thread park, and check that a producer wakes it
+        // up well before wait-timeout-ms expires
+        usleep(10000);
+        auto start = now_utc();
+        LOG_INFO("Last");
+
+        int n = 0;
+        while (n < iterations+1 && (now_utc() - start).milliseconds() < 5000) {
+            usleep(1000);
+            n = count_lines(filename);
+        }
+        BOOST_CHECK_MESSAGE(n == iterations+1, s << ": " << n);
+        BOOST_CHECK_MESSAGE((now_utc() - start).milliseconds() < 1000, s);
+
+        start = now_utc();
+        log.finalize();
+        BOOST_CHECK_MESSAGE((now_utc() - start).milliseconds() < 1000, s);
+    }
+
+    ::unlink(filename.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_mmap )
+{
+    auto filename = "/tmp/test_logger_mmap." + std::to_string(getpid());
+
+    variant_tree pt;
+    pt.put("logger.timestamp",             variant("none"));
+    pt.put("logger.show-location",         false);
+    pt.put("logger.show-category",         false);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.min-level-filter",      variant("info"));
+    pt.put("logger.mmap.filename",         variant(filename));
+    pt.put("logger.mmap.size-mb",          1);
+    pt.put("logger.mmap.append",           false);
+
+    logger& log = logger::instance();
+
+    if (log.initialized())
+        log.finalize();
+
+    log.init(pt, nullptr, false);
+
+    // Overflow the ring several times over
+    const int iterations = 100000;
+
+    for (int i=0; i < iterations; ++i)
+        LOG_INFO("Test %d", i);
+
+    log.finalize();
+
+    // Read the ring post-mortem: it must hold the newest records in order
+    mmap_log_ring ring;
+    BOOST_REQUIRE_EQUAL(0, ring.open(filename));
+    BOOST_CHECK_EQUAL(1u << 20, ring.capacity());
+
+    std::string rec;
+    BOOST_REQUIRE(ring.read(rec));
+    BOOST_REQUIRE_EQUAL(0u, rec.compare(0, 7, "I|Test "));
+    int first = std::stoi(rec.substr(7));
+    BOOST_CHECK(first > 0);
+
+    int n = first + 1;
+    for (; ring.read(rec); ++n)
+        BOOST_REQUIRE_EQUAL("I|Test " + std::to_string(n) + "\n", rec);
+    BOOST_CHECK_EQUAL(iterations, n);
+    BOOST_CHECK_EQUAL(0u, ring.lost());
+
+    ring.seek_last(2);
+    BOOST_REQUIRE(ring.read(rec));
+    BOOST_CHECK_EQUAL("I|Test " + std::to_string(iterations-2) + "\n", rec);
+    ring.close();
+
+    // Records of the previous run are preserved in the append mode
+    pt.put("logger.mmap.append", true);
+    log.init(pt, nullptr, false);
+    LOG_INFO("Next run");
+    log.finalize();
+
+    BOOST_REQUIRE_EQUAL(0, ring.open(filename));
+    ring.seek_last(2);
+    BOOST_REQUIRE(ring.read(rec));
+    BOOST_CHECK_EQUAL("I|Test " + std::to_string(iterations-1) + "\n", rec);
+    BOOST_REQUIRE(ring.read(rec));
+    BOOST_CHECK_EQUAL("I|Next run\n", rec);
+    BOOST_CHECK(!ring.read(rec));
+    ring.close();
+
+    // Only one writer may have the ring open
+    {
+        mmap_log_ring w1, w2;
+        BOOST_REQUIRE_EQUAL(0, w1.create(filename, 1 << 20));
+        BOOST_CHECK_EQUAL(-1,  w2.create(filename, 1 << 20, true));
+        BOOST_CHECK_EQUAL(EWOULDBLOCK, errno);
+        w1.close();
+        BOOST_CHECK_EQUAL(0,   w2.create(filename, 1 << 20));
+    }
+
+    // Messages left in the logger's queues on a crash are written to the ring
+    pt.put("logger.mmap.append",           false);
+    pt.put("logger.handle-crash-signals",  true);
+
+    std::atomic<bool> hold{true};
+    log.set_on_before_run([&hold]() {
+        while (hold.load(std::memory_order_acquire))
+            usleep(1000);
+    });
+
+    log.init(pt, nullptr, false);
+
+    const int pending = 100;
+    for (int i=0; i < pending; ++i)
+        LOG_INFO("Test %d", i);
+
+    BOOST_CHECK_EQUAL(pending, log.flush_on_crash());
+
+    hold.store(false, std::memory_order_release);
+    log.finalize();
+    log.set_on_before_run(nullptr);
+
+    // YYYYmmdd-HH:MM:SS.uuuuuu|I|Test N
+    BOOST_REQUIRE_EQUAL(0, ring.open(filename));
+    int i = 0;
+    for (; ring.read(rec); ++i) {
+        auto exp = "|I|Test " + std::to_string(i) + "\n";
+        BOOST_REQUIRE(rec.size() > exp.size());
+        BOOST_CHECK_EQUAL(exp, rec.substr(rec.size() - exp.size()));
+    }
+    BOOST_CHECK_EQUAL(pending, i);
+    ring.close();
+
+    ::unlink(filename.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_crash_flush )
+{
+    auto filename = "/tmp/test_logger_crash_flush." + std::to_string(getpid());
+
+    variant_tree pt;
+    pt.put("logger.show-location",         false);
+    pt.put("logger.show-category",         false);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.min-level-filter",      variant("info"));
+    pt.put("logger.handle-crash-signals",  true);
+    pt.put("logger.file.filename",         variant(filename));
+    pt.put("logger.file.append",           false);
+    pt.put("logger.file.no-header",        true);
+
+    logger& log = logger::instance();
+
+    if (log.initialized())
+        log.finalize();
+
+    // Keep messages in the queue by holding the logger thread
+    std::atomic<bool> hold{true};
+    log.set_on_before_run([&hold]() {
+        while (hold.load(std::memory_order_acquire))
+            usleep(1000);
+    });
+
+    log.init(pt, nullptr, false);
+
+    const int iterations = 100;
+
+    for (int i=0; i < iterations; ++i)
+        LOG_INFO("Test %d", i);
+
+    BOOST_CHECK_EQUAL(iterations, log.flush_on_crash());
+    BOOST_CHECK_EQUAL(0,          log.flush_on_crash());
+
+    hold.store(false, std::memory_order_release);
+    log.finalize();
+    log.set_on_before_run(nullptr);
+
+    std::ifstream in(filename);
+    std::string   line;
+    int           i = 0;
+
+    // YYYYmmdd-HH:MM:SS.uuuuuu|I|Test N
+    for (; std::getline(in, line); ++i) {
+        auto exp = "|I|Test " + std::to_string(i);
+        BOOST_REQUIRE(line.size() > exp.size());
+        BOOST_CHECK_EQUAL(exp, line.substr(line.size() - exp.size()));
+        BOOST_CHECK_EQUAL('-', line[8]);
+        BOOST_CHECK_EQUAL('.', line[17]);
+    }
+
+    BOOST_CHECK_EQUAL(iterations, i);
+    ::unlink(filename.c_str());
+
+    // A crash of the logger's thread also writes out the per-thread queues,
+    // which only that thread consumes
+    pt.put("logger.thread-queue-capacity", 256);
+
+    std::atomic<bool> logged{false};
+    std::atomic<int>  flushed{-1};
+    log.set_on_before_run([&log, &logged, &flushed]() {
+        while (!logged.load(std::memory_order_acquire))
+            usleep(1000);
+        flushed = log.flush_on_crash();
+    });
+
+    log.init(pt, nullptr, false);
+
+    for (int i=0; i < iterations; ++i)
+        LOG_INFO("Test %d", i);
+    logged.store(true, std::memory_order_release);
+
+    log.finalize();
+    log.set_on_before_run(nullptr);
+
+    BOOST_CHECK_EQUAL(iterations, flushed);
+
+    // After the "crash" the logger's thread also wrote the messages left in
+    // its ring, while the ones stolen from the shared queue are gone
+    std::ifstream in2(filename);
+    for (i = 0; std::getline(in2, line); )
+        if (line.size() > 17 && line[8] == '-' && line[17] == '.')
+            ++i;
+    BOOST_CHECK_EQUAL(iterations, i);
+    ::unlink(filename.c_str());
+}
 
 #ifdef UTXX_STANDALONE
 
@@ -0,0 +1,81 @@
+//----------------------------------------------------------------------------
+/// \file  test_logger_min_level.cpp
+//----------------------------------------------------------------------------
+/// \brief Test compile-time elision of log levels (UTXX_LOG_MIN_LEVEL)
+//----------------------------------------------------------------------------
+// Copyright (c) 2026 agent <agent@local>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file may be included in different open-source projects
+
+Copyright (C) 2026 agent <agent@local>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <boost/test/unit_test.hpp>
+
+// Messages below INFO are compiled out in this translation unit
+#define UTXX_LOG_MIN_LEVEL LEVEL_INFO
+
+#include <utxx/logger.hpp>
+#include <utxx/variant_tree.hpp>
+
+using namespace utxx;
+
+static_assert(!UTXX_LOG_COMPILED(LEVEL_TRACE5), "TRACE5 must be compiled out");
+static_assert(!UTXX_LOG_COMPILED(LEVEL_TRACE),  "TRACE must be compiled out");
+static_assert(!UTXX_LOG_COMPILED(LEVEL_DEBUG),  "DEBUG must be compiled out");
+static_assert( UTXX_LOG_COMPILED(LEVEL_INFO),   "INFO must be compiled in");
+static_assert( UTXX_LOG_COMPILED(LEVEL_ALERT),  "ALERT must be compiled in");
+
+BOOST_AUTO_TEST_CASE( test_logger_min_level )
+{
+    BOOST_CHECK(is_at_least(LEVEL_TRACE,   LEVEL_TRACE1));
+    BOOST_CHECK(is_at_least(LEVEL_DEBUG,   LEVEL_TRACE));
+    BOOST_CHECK(is_at_least(LEVEL_WARNING, LEVEL_WARNING));
+    BOOST_CHECK(!is_at_least(LEVEL_TRACE5, LEVEL_TRACE4));
+    BOOST_CHECK(!is_at_least(LEVEL_INFO,   LEVEL_NOTICE));
+
+    variant_tree pt;
+    pt.put("logger.min-level-filter", variant("trace5"));
+    pt.put("logger.silent-finish",    true);
+
+    logger& log = logger::instance();
+
+    if (log.initialized())
+        log.finalize();
+
+    log.init(pt, nullptr, false);
+    BOOST_CHECK(log.is_enabled(LEVEL_TRACE));
+
+    // Arguments of compiled out calls are never evaluated, even though
+    // the levels are enabled at run-time
+    int n = 0;
+    LOG_TRACE("%d", ++n);
+    LOG_DEBUG("%d", ++n);
+    UTXX_LOG(DEBUG) << ++n;
+    BOOST_CHECK_EQUAL(0, n);
+
+    LOG_INFO("%d", ++n);
+    UTXX_LOG(INFO) << ++n;
+    BOOST_CHECK_EQUAL(2, n);
+
+    log.finalize();
+}
@@ -2,6 +2,11 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <utxx/logger.hpp>
+#include <utxx/logger/logger_impl_syslog_dgram.hpp>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <thread>
 
 using namespace boost::property_tree;
 using namespace utxx;
@@ -26,4 +31,113 @@ BOOST_AUTO_TEST_CASE( test_logger_syslog )
     }
 }
 
+BOOST_AUTO_TEST_CASE( test_logger_syslog_dgram )
+{
+    auto sock_path = "/tmp/test_logger_syslog_dgram." + std::to_string(getpid());
+
+    // Stand-in for the syslog daemon
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    BOOST_REQUIRE(fd >= 0);
+
+    sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, sock_path.c_str());
+    ::unlink(sock_path.c_str());
+    BOOST_REQUIRE_EQUAL(0, bind(fd, (const sockaddr*)&sa, sizeof(sa)));
+
+    variant_tree pt;
+    pt.put("logger.timestamp",               variant("none"));
+    pt.put("logger.show-location",           false);
+    pt.put("logger.silent-finish",           true);
+    pt.put("logger.min-level-filter",        variant("info"));
+    pt.put("logger.syslog-dgram.address",    variant("uds://" + sock_path));
+    pt.put("logger.syslog-dgram.levels",     variant("info|warning|error"));
+    pt.put("logger.syslog-dgram.facility",   variant("log-local3"));
+    pt.put("logger.syslog-dgram.batch-size", 8);
+
+    logger& log = logger::instance();
+
+    if (log.initialized())
+        log.finalize();
+
+    log.set_ident("test_logger");
+    log.init(pt, nullptr, false);
+
+    const int iterations = 100;
+    char      buf[2048];
+
+    // The socket's queue is short, so in the blocking mode the frames
+    // must be read while they are being sent
+    std::vector<std::string> frames;
+    std::thread reader([&]() {
+        auto deadline = now_utc() + secs(10);
+        while (frames.size() < size_t(iterations) && now_utc() < deadline) {
+            auto len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (len > 0)
+                frames.emplace_back(buf, len);
+            else
+                usleep(1000);
+        }
+    });
+
+    for (int i=0; i < iterations; ++i)
+        LOG_INFO("Test %d", i);
+
+    reader.join();
+    log.finalize();
+
+    // Frames: <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID - MSG
+    auto pid = " test_logger " + std::to_string(getpid()) + " - - ";
+    int  n   = 0;
+
+    for (auto& frame : frames) {
+        auto exp = "Test " + std::to_string(n++);
+
+        BOOST_CHECK_EQUAL("<158>1 ", frame.substr(0, 7)); // LOG_LOCAL3 | LOG_INFO
+        BOOST_CHECK_EQUAL('T', frame[17]);
+        BOOST_CHECK_EQUAL('Z', frame[33]);
+        BOOST_CHECK(frame.find(pid) != std::string::npos);
+        BOOST_REQUIRE(frame.size() > exp.size());
+        BOOST_CHECK_EQUAL(exp, frame.substr(frame.size() - exp.size()));
+    }
+
+    BOOST_CHECK_EQUAL(iterations, n);
+
+    // Without a reader the socket's queue fills up, and in the non-blocking
+    // mode frames that don't fit are dropped instead of blocking the logger
+    pt.put("logger.syslog-dgram.nonblock", true);
+    log.init(pt, nullptr, false);
+
+    auto impl = dynamic_cast<const logger_impl_syslog_dgram*>
+                (log.get_impl("syslog-dgram"));
+    BOOST_REQUIRE(impl);
+
+    const int many = 10000;
+
+    for (int i=0; i < many; ++i)
+        LOG_INFO("Test %d", i);
+
+    auto deadline = now_utc() + secs(10);
+    while (!impl->dropped() && now_utc() < deadline)
+        usleep(1000);
+
+    BOOST_CHECK(impl->dropped() > 0);
+
+    n = 0;
+    while (n + impl->dropped() < size_t(many) && now_utc() < deadline) {
+        if (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+            ++n;
+        else
+            usleep(1000);
+    }
+
+    BOOST_CHECK_EQUAL(size_t(many), n + impl->dropped());
+
+    log.finalize();
+
+    close(fd);
+    ::unlink(sock_path.c_str());
+}
+
 //BOOST_AUTO_TEST_SUITE_END()
@@ -380,6 +380,274 @@ BOOST_AUTO_TEST_CASE( test_multi_file_logger_formatter )
     }
 }
 
+BOOST_AUTO_TEST_CASE( test_multi_file_logger_io_uring )
+{
+    static const int32_t ITERATIONS =
+        getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 10000;
+
+    unlink();
+
+    logger_t l_logger;
+
+    // When io_uring is not available the logger falls back to writev(2)
+    int ec = l_logger.use_io_uring(64);
+    BOOST_TEST_MESSAGE("io_uring " << (ec ? errno_string(-ec) : "enabled"));
+
+    logger_t::file_id l_fd[s_file_num];
+    for (size_t i = 0; i < s_file_num; i++) {
+        l_fd[i] = l_logger.open_file(s_filename[i], false);
+        BOOST_REQUIRE(l_fd[i]);
+    }
+
+    BOOST_REQUIRE_EQUAL(0, l_logger.start());
+
+    for (int i = 0; i < ITERATIONS; i++)
+        for (size_t j = 0; j < s_file_num; j++) {
+            char buf[128];
+            int n = snprintf(buf, sizeof(buf), s_str1, i);
+            BOOST_REQUIRE_EQUAL(0, l_logger.write(l_fd[j], "", std::string(buf, n)));
+        }
+
+    // Pending writes of the first file must complete before it's closed
+    l_logger.close_file(l_fd[0], false);
+    BOOST_REQUIRE_EQUAL(1, l_logger.open_files_count());
+
+    l_logger.stop();
+
+    BOOST_REQUIRE_EQUAL(0, l_logger.open_files_count());
+
+    for (size_t j = 0; j < s_file_num; j++) {
+        std::ifstream file(s_filename[j], std::ios::in);
+        for (int i = 0; i < ITERATIONS; i++) {
+            std::string s;
+            std::getline(file, s);
+            BOOST_REQUIRE( !file.fail() );
+
+            char buf[128];
+            sprintf(buf, s_str1, i);
+            s += '\n';
+            BOOST_REQUIRE_EQUAL( buf, s );
+        }
+
+        std::string s;
+        std::getline(file, s);
+        BOOST_REQUIRE(file.fail());
+        BOOST_REQUIRE(file.eof());
+    }
+
+    unlink();
+}
+
+BOOST_AUTO_TEST_CASE( test_multi_file_logger_direct )
+{
+    static const int32_t ITERATIONS =
+        getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 10000;
+
+    ::unlink(s_filename[0]);
+
+    // The second pass appends to a file whose size is not block-aligned
+    for (int k = 0; k < 2; k++) {
+        logger_t l_logger;
+
+        logger_t::file_id l_fd =
+            l_logger.open_direct_file(s_filename[0], true, 0660, 8192, 1024*1024);
+        BOOST_REQUIRE(l_fd);
+
+        BOOST_REQUIRE_EQUAL(0, l_logger.start());
+
+        for (int i = 0; i < ITERATIONS; i++) {
+            char buf[128];
+            int n = snprintf(buf, sizeof(buf), s_str1, i);
+            BOOST_REQUIRE_EQUAL(0, l_logger.write(l_fd, "", std::string(buf, n)));
+        }
+
+        l_logger.stop();
+        BOOST_REQUIRE_EQUAL(0, l_logger.open_files_count());
+    }
+
+    std::ifstream file(s_filename[0], std::ios::in);
+    for (int k = 0; k < 2; k++)
+        for (int i = 0; i < ITERATIONS; i++) {
+            std::string s;
+            std::getline(file, s);
+            BOOST_REQUIRE( !file.fail() );
+
+            char buf[128];
+            sprintf(buf, s_str1, i);
+            s += '\n';
+            BOOST_REQUIRE_EQUAL( buf, s );
+        }
+
+    std::string s;
+    std::getline(file, s);
+    BOOST_REQUIRE(file.fail());
+    BOOST_REQUIRE(file.eof());
+
+    ::unlink(s_filename[0]);
+}
+
+BOOST_AUTO_TEST_CASE( test_multi_file_logger_shards )
+{
+    static const int32_t ITERATIONS =
+        getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 10000;
+    static const int FILES = 4;
+
+    logger_t l_logger;
+
+    BOOST_REQUIRE_EQUAL(1, l_logger.shards());
+    BOOST_REQUIRE_EQUAL(0, l_logger.set_shards(2));
+    BOOST_REQUIRE_EQUAL(2, l_logger.shards());
+    l_logger.set_shard_cpu(0, 0);
+
+    std::string       l_names[FILES];
+    logger_t::file_id l_fd[FILES];
+    for (int i = 0; i < FILES; i++) {
+        l_names[i] = "/tmp/test_multi_file_async_logger_shard" + std::to_string(i) + ".log";
+        ::unlink(l_names[i].c_str());
+        l_fd[i] = l_logger.open_file(l_names[i], false);
+        BOOST_REQUIRE(l_fd[i]);
+    }
+    // Explicit affinity (the last file would otherwise go to shard 1)
+    BOOST_REQUIRE_EQUAL(0, l_logger.set_shard(l_fd[FILES-1], 0));
+
+    // Shards can't be changed once files are open
+    BOOST_REQUIRE_EQUAL(-1, l_logger.set_shards(3));
+
+    BOOST_REQUIRE_EQUAL(0, l_logger.start());
+
+    for (int i = 0; i < ITERATIONS; i++)
+        for (int j = 0; j < FILES; j++) {
+            char buf[128];
+            int n = snprintf(buf, sizeof(buf), s_str1, i);
+            BOOST_REQUIRE_EQUAL(0, l_logger.write(l_fd[j], "", std::string(buf, n)));
+        }
+
+    // Queued commands aren't migrated, so a written stream can't move
+    BOOST_REQUIRE_EQUAL(-1, l_logger.set_shard(l_fd[0], 1));
+
+    l_logger.close_file(l_fd[1], false);
+    BOOST_REQUIRE_EQUAL(FILES-1, l_logger.open_files_count());
+
+    l_logger.stop();
+
+    BOOST_REQUIRE(!l_logger.running());
+    BOOST_REQUIRE_EQUAL(0, l_logger.open_files_count());
+    // Messages processed by all shards are counted
+    BOOST_REQUIRE(l_logger.total_msgs_processed() >= FILES * ITERATIONS);
+
+    for (int j = 0; j < FILES; j++) {
+        std::ifstream file(l_names[j], std::ios::in);
+        for (int i = 0; i < ITERATIONS; i++) {
+            std::string s;
+            std::getline(file, s);
+            BOOST_REQUIRE( !file.fail() );
+
+            char buf[128];
+            sprintf(buf, s_str1, i);
+            s += '\n';
+            BOOST_REQUIRE_EQUAL( buf, s );
+        }
+
+        std::string s;
+        std::getline(file, s);
+        BOOST_REQUIRE(file.fail());
+        BOOST_REQUIRE(file.eof());
+        ::unlink(l_names[j].c_str());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_multi_file_logger_priority )
+{
+    static const int32_t ITERATIONS =
+        getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 10000;
+    static const int FILES = 2;
+
+    // Run with the writev(2) path, and with io_uring where it's available
+    for (int mode = 0; mode < 2; mode++) {
+        logger_t l_logger;
+
+        if (mode && l_logger.use_io_uring() < 0)
+            break;
+
+        std::string       l_names[FILES];
+        logger_t::file_id l_fd[FILES];
+        for (int i = 0; i < FILES; i++) {
+            l_names[i] = "/tmp/test_multi_file_async_logger_prio" + std::to_string(i) + ".log";
+            ::unlink(l_names[i].c_str());
+            l_fd[i] = l_logger.open_file(l_names[i], false);
+            BOOST_REQUIRE(l_fd[i]);
+        }
+
+        // Budget smaller than a single message must still make progress
+        l_logger.set_priority(l_fd[0], logger_t::PRIORITY_HIGH);
+        l_logger.set_priority(l_fd[1], logger_t::PRIORITY_LOW, 16);
+
+        // Record how much of the high priority stream was written by the
+        // time the low priority stream gets its first write. Custom writers
+        // take the writev(2) path, so this is only checked in that mode.
+        size_t high_bytes = 0, high_bytes_at_low = 0, high_total = 0;
+        bool   low_written = false;
+        if (!mode) {
+            l_logger.set_writer(l_fd[0],
+                [&](logger_t::stream_info& a_si, const char**, const iovec* a_iov, size_t a_n) {
+                    int rc = ::writev(a_si.fd, a_iov, a_n);
+                    if (rc > 0) high_bytes += rc;
+                    return rc;
+                });
+            l_logger.set_writer(l_fd[1],
+                [&](logger_t::stream_info& a_si, const char**, const iovec* a_iov, size_t a_n) {
+                    if (!low_written) {
+                        low_written       = true;
+                        high_bytes_at_low = high_bytes;
+                    }
+                    return ::writev(a_si.fd, a_iov, a_n);
+                });
+        }
+
+        // Queue everything before starting, so that both streams are
+        // backlogged on the first pass of the writer thread
+        for (int i = 0; i < ITERATIONS; i++)
+            for (int j = 0; j < FILES; j++) {
+                char buf[128];
+                int n = snprintf(buf, sizeof(buf), s_str1, i);
+                BOOST_REQUIRE_EQUAL(0, l_logger.write(l_fd[j], "", std::string(buf, n)));
+                if (!j) high_total += n;
+            }
+
+        BOOST_REQUIRE_EQUAL(0, l_logger.start());
+
+        l_logger.stop();
+        BOOST_REQUIRE_EQUAL(0, l_logger.open_files_count());
+
+        // The high priority stream was serviced in full ahead of the
+        // quantum-limited low priority stream
+        if (!mode) {
+            BOOST_CHECK(low_written);
+            BOOST_CHECK_EQUAL(high_total, high_bytes_at_low);
+        }
+
+        for (int j = 0; j < FILES; j++) {
+            std::ifstream file(l_names[j], std::ios::in);
+            for (int i = 0; i < ITERATIONS; i++) {
+                std::string s;
+                std::getline(file, s);
+                BOOST_REQUIRE( !file.fail() );
+
+                char buf[128];
+                sprintf(buf, s_str1, i);
+                s += '\n';
+                BOOST_REQUIRE_EQUAL( buf, s );
+            }
+
+            std::string s;
+            std::getline(file, s);
+            BOOST_REQUIRE(file.fail());
+            BOOST_REQUIRE(file.eof());
+            ::unlink(l_names[j].c_str());
+        }
+    }
+}
+
 //-----------------------------------------------------------------------------
 /*
 BOOST_AUTO_TEST_CASE( 
@@ -42,10 +42,10 @@ void test(const char* a_desc, size_t a_exp_capacity, size_t a_capacity,
           void* a_memory, size_t a_mem_sz, bool a_construct = true) {
     BOOST_TEST_MESSAGE("Testing " << a_desc << " ring buffer");
 
-    std::unique_ptr<Buffer, void(*)(Buffer*&)>
+    std::unique_ptr<Buffer, void(*)(Buffer*)>
         buf(
             Buffer::create(a_capacity, a_memory, a_mem_sz, a_construct),
-            &Buffer::destroy
+            [](Buffer* p) { Buffer::destroy(p); }
         );
 
     BOOST_CHECK_EQUAL(a_exp_capacity, buf->capacity());
@@ -101,4 +101,46 @@ BOOST_AUTO_TEST_CASE( test_ring_buffer )
     delete [] p;
 }
 
+BOOST_AUTO_TEST_CASE( test_ring_buffer_batch )
+{
+    typedef ring_buffer<int> buffer_t;
+    std::unique_ptr<buffer_t, void(*)(buffer_t*)>
+        buf(buffer_t::create(4, NULL, 0, true), [](buffer_t* p) { buffer_t::destroy(p); });
+
+    int items[] = {1, 2, 3, 4, 5, 6, 7};
+
+    buf->add_n(items, 3);
+    BOOST_CHECK_EQUAL(3u, buf->total_count());
+    BOOST_CHECK_EQUAL(3,  *buf->back());
+
+    auto r = buf->peek(10);
+    BOOST_CHECK_EQUAL(3u, r.size());
+    BOOST_CHECK_EQUAL(1,  r[0]);
+    BOOST_CHECK_EQUAL(3,  r[2]);
+
+    // More entries than capacity: only the last 4 are kept
+    buf->add_n(items, 7);
+    BOOST_CHECK_EQUAL(10u, buf->total_count());
+    r = buf->peek(4);
+    BOOST_CHECK_EQUAL(2u, r.first.size);
+    BOOST_CHECK_EQUAL(2u, r.second.size);
+    for (int i = 0; i < 4; ++i)
+        BOOST_CHECK_EQUAL(4 + i, r[i]);
+
+    auto c = buf->claim(2);
+    BOOST_CHECK_EQUAL(2u, c.size());
+    c[0] = 10;
+    c[1] = 11;
+    BOOST_CHECK_EQUAL(10u, buf->total_count());
+    buf->publish(2);
+    BOOST_CHECK_EQUAL(12u, buf->total_count());
+    BOOST_CHECK_EQUAL(11, *buf->back());
+
+    r = buf->peek(3);
+    BOOST_CHECK_EQUAL(3u, r.size());
+    BOOST_CHECK_EQUAL(7,  r[0]);
+    BOOST_CHECK_EQUAL(10, r[1]);
+    BOOST_CHECK_EQUAL(11, r[2]);
+}
+
 } // namespace utxx